@@ -12,11 +12,62 @@
 #include <string>
 #include <utility>
 #include "XrdCl/XrdClUtils.hh"
+#include "XrdOpenLocalRouter.hh"
+#include "XrdOpenLocalHealth.hh"
+#include "XrdOpenLocalHedge.hh"
+#include "XrdOpenLocalReplica.hh"
+#include "XrdOpenLocalCache.hh"
+#include "XrdOpenLocalShmCache.hh"
+#include "XrdOpenLocalDiskCache.hh"
+#include "XrdOpenLocalPrepare.hh"
+#include "XrdOpenLocalBatch.hh"
+#include "XrdOpenLocalWriteBehind.hh"
+#include "XrdOpenLocalSync.hh"
+#include "XrdOpenLocalStripe.hh"
+#include "XrdOpenLocalLocate.hh"
+#include "XrdOpenLocalSpace.hh"
+#include "XrdOpenLocalFork.hh"
+#include "XrdOpenLocalSingleFlight.hh"
+#include "XrdOpenLocalUtils.hh"
 #include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <set>
 using namespace XrdCl;
 XrdVERSIONINFO(XrdClGetPlugIn, Locfile);
 
 namespace Locfile {
+//----------------------------------------------------------------------------
+// Results of local opens and stats, shared by concurrent callers
+//----------------------------------------------------------------------------
+struct OpenResult {
+	OpenResult():fd(-1),err(0) {}
+	~OpenResult() {
+		if(fd>=0) ::close(fd);
+	}
+	XRootDStatus st;
+	int fd;   // every caller gets a dup of it
+	int err;
+};
+struct StatResult {
+	StatResult():err(0) {}
+	XRootDStatus st;
+	struct stat sb;
+	int err;
+};
+static SingleFlight<OpenResult>& openFlight() {
+	static SingleFlight<OpenResult> flight("open");
+	return flight;
+}
+static SingleFlight<StatResult>& statFlight() {
+	static SingleFlight<StatResult> flight("stat");
+	return flight;
+}
 enum Mode {Local,Default,Undefined};
 class Locfile : public XrdCl::FilePlugIn {
 
@@ -25,15 +76,71 @@ private:
 
 	///@swapLocalMap a map for rewrite some server specific URL to using an local file
 	// e.g. root://xrd-manager.your.site to /your/filesystem/xrdmanager (specified in the xrootd plugin config file)
-	static std::map<std::string,std::string> swapLocalMap;
+	static std::map<std::string,std::vector<LocalRoot> > swapLocalMap;
+	///@balancePerRead pick the replica per read instead of per open ("replicabalance = read")
+	static bool balancePerRead;
+	///@lazyOpen defer local opens of read-only files to the first I/O ("lazyopen = true")
+	static bool lazyOpen;
+	///@readAdvice posix_fadvise advice for read-only opens without SeqIO ("readadvice = normal|random|sequential")
+	static int readAdvice;
+	///@sparseRead reads of at least this many bytes fill holes with zeros instead of reading them ("sparseread", KB, 0 = off)
+	static size_t sparseRead;
 	///@proxyPrefix The prefix that will be added to any root query that cannot use local available files
 	static std::string proxyPrefix;
 	std::string path;
 	Mode mode;
-	///@file file for local access
-	fstream* file;
-	//(@xfile Xrootd Client File to use the proxyfied URLs
-	XrdCl::File xfile;
+	///@fd descriptor for local access
+	int fd;
+	//(@xfile Xrootd Client File to use the proxyfied URLs, only built when needed
+	std::unique_ptr<XrdCl::File> xfile;
+	///@target the backend in use (local root or remote host), as known to the Router
+	std::string target;
+	///@routed the host is mapped by "redirectlocal", its operations feed the Router
+	bool routed;
+	///@origUrl the URL the file was opened with, hedged reads go there
+	std::string origUrl;
+	///@relPath the path below the local root
+	std::string relPath;
+	///@replicas the local roots of the host, in the order they were tried
+	std::vector<LocalRoot> replicas;
+	///@replicaIdx the replica fd is open on
+	size_t replicaIdx;
+	///@replicaFds descriptors on the other replicas, for per-read balancing
+	std::map<std::string,int> replicaFds;
+	///@retiredFds descriptors of replicas that failed a read, other reads may
+	///still use them so they are closed with the file
+	std::vector<int> retiredFds;
+	///@failedRoots replicas that failed a read, not balanced to again
+	std::set<std::string> failedRoots;
+	///@openFlags the flags the file was opened with
+	OpenFlags::Flags openFlags;
+	///@cacheId the file version in the block cache, invalid if not cached
+	FileId cacheId;
+	///@remoteId the remote file version in the disk cache, invalid if not cached
+	FileId remoteId;
+	///@remoteIdTried whether remoteId was already looked up
+	bool remoteIdTried;
+	///@hedgeTried whether xfile was already opened (or failed to) for hedged reads
+	bool hedgeTried;
+	///@hedgeOpening the open of xfile for hedged reads is in flight, hedgeOpened is posted at its end
+	bool hedgeOpening;
+	XrdSysSemaphore hedgeOpened;
+	///@deferred a lazy Open is still to be done, by the first I/O
+	std::atomic<bool> deferred;
+	///@openStatus the result of the deferred open
+	XRootDStatus openStatus;
+	///@openMode the access mode and timeout given to a lazy Open
+	Access::Mode openMode;
+	uint16_t openTimeout;
+	///@lazyStat the stat answered before a lazy open was done
+	std::shared_ptr<struct stat> lazyStat;
+	///@wbuf the write-behind buffer of a local file opened for writing ("writebehind = true")
+	std::unique_ptr<WriteBuffer> wbuf;
+	///@stripes the stripe layout of fd, null unless "stripeaware = true" and the file is striped
+	std::shared_ptr<const StripeLayout> stripes;
+	XrdSysMutex hedgeMtx;
+	XrdSysMutex replicaMtx;
+	XrdSysMutex openMtx;
 public:
 	static void setProxyPrefix(std::string toProxyPrefix) {
 		proxyPrefix=toProxyPrefix;
@@ -44,7 +151,9 @@ public:
 		log->Debug(1,"Swap to Local Map:");
 		for(auto i : swapLocalMap) {
 			stringstream msg ;
-			msg<<"\""<<i.first<<"\" to \""<<i.second<<"\""<<std::endl;
+			msg<<"\""<<i.first<<"\" to";
+			for(auto& r : i.second) msg<<" \""<<r.path<<"\" (weight "<<r.weight<<")";
+			msg<<std::endl;
 			log->Debug(1,msg.str().c_str());
 		}
 
@@ -57,9 +166,26 @@ public:
 		log->Debug(1,msg.str().c_str());
 
 	}
-	static void setSwapLocalMap(std::pair<std::string,std::string>toadd) {
-		swapLocalMap.insert(toadd);
+	static void setReplicaBalance(std::string balance) {
+		balancePerRead=(balance=="read");
+	}
+	static void setLazyOpen(bool lazy) {
+		lazyOpen=lazy;
+	}
+	static void setSparseRead(size_t kb) {
+		sparseRead=kb*1024;
+	}
+	static void setReadAdvice(std::string advice) {
+		if(advice=="random") readAdvice=POSIX_FADV_RANDOM;
+		else if(advice=="sequential") readAdvice=POSIX_FADV_SEQUENTIAL;
+		else readAdvice=POSIX_FADV_NORMAL;
 	}
+	static void setSwapLocalMap(std::pair<std::string,LocalRoot>toadd) {
+		swapLocalMap[toadd.first].push_back(toadd.second);
+	}
+	//------------------------------------------------------------------------
+	// "host|root[,weight]|root[,weight];host2|..."
+	//------------------------------------------------------------------------
 	static void parseIntoLocalMap(std::string configline) {
 		std::istringstream ss(configline);
 		std::string token;
@@ -69,45 +195,51 @@ public:
 			std::string lpath;
 			std::string rpath;
 			std::getline(sub,lpath,'|');
-			std::getline(sub,rpath,'|');
-			setSwapLocalMap(std::make_pair(lpath,rpath));
+			while(std::getline(sub,rpath,'|')) {
+				if(rpath.empty()) continue;
+				double weight=1;
+				size_t comma=rpath.rfind(',');
+				if(comma!=std::string::npos) {
+					weight=atof(rpath.c_str()+comma+1);
+					rpath.erase(comma);
+				}
+				setSwapLocalMap(std::make_pair(lpath,LocalRoot(rpath,weight)));
+				HealthMonitor::instance().addMount(rpath);
+			}
 		}
 	}
 
 	std::string  getLocalAdressMap( std::string servername) {
 		auto addr=swapLocalMap.find(servername);
-		if(addr==swapLocalMap.end()) {
+		if(addr==swapLocalMap.end() || addr->second.empty()) {
 			return "NotInside";
 		} else {
-			return addr->second;
+			return ReplicaSelector::instance().pick(addr->second);
 		}
 	}
-	std::string rewrite_path(std::string url) {
+	//------------------------------------------------------------------------
+	// The roots of a mapped host, best first, only those with a healthy mount
+	//------------------------------------------------------------------------
+	static std::vector<LocalRoot> getLocalRoots(std::string servername) {
+		std::vector<LocalRoot> roots;
+		auto addr=swapLocalMap.find(servername);
+		if(addr==swapLocalMap.end()) return roots;
+		for(auto& r : ReplicaSelector::instance().order(addr->second)) {
+			if(!HealthMonitor::instance().available(r)) continue;
+			for(auto& lr : addr->second) {
+				if(lr.path==r) {
+					roots.push_back(lr);
+					break;
+				}
+			}
+		}
+		return roots;
+	}
+	std::string proxify(std::string url) {
 		XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
-
-		XrdCl::URL xUrl(url);
-		string path=xUrl.GetPath();
-		string servername=xUrl.GetHostName();
 		std::stringstream out;
-
 		out << "Locfile::setting  url:\"" <<url<<"\"";
-		if(getLocalAdressMap(servername).compare("NotInside")!=0) {
-			mode=Local;
-			std::string   lpath=getLocalAdressMap(servername);
-			lpath.append(path);
-			this->path=lpath;
-
-			log->Debug(1,"Locfile::rewrite Setting plugIn to \"local\"- mode");
-			out<<" to: \""<<lpath<<"\""<<std::endl;
-			log->Debug(1,out.str().c_str());
-
-			return lpath;
-		}
-
-
-		mode=Default;
 		if(proxyPrefix.compare("UNSET")==0) {
-			this->path=url;
 			return url;
 		} else {
 
@@ -119,27 +251,556 @@ public:
 			log->Debug(1,"Locfile::rewrite Setting plugIn to \"proxy - prefix\"- mode");
 			out<<" to: "<<proxy<<"\""<<std::endl;
 			log->Debug(1,out.str().c_str());
+			return proxy;
+		}
+	}
+	std::string remoteTarget(std::string servername) {
+		if(proxyPrefix.compare("UNSET")==0) return "root://"+servername;
+		return "root://"+proxyPrefix;
+	}
+	std::string rewrite_path(std::string url) {
+		XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
 
-		this->path=proxy;
-		return proxy;
+		XrdCl::URL xUrl(url);
+		string path=xUrl.GetPath();
+		string servername=xUrl.GetHostName();
+		std::stringstream out;
+
+		out << "Locfile::setting  url:\"" <<url<<"\"";
+		if(swapLocalMap.count(servername)) {
+			routed=true;
+			replicas=getLocalRoots(servername);
+			std::string lroot=replicas.empty()?std::string():replicas.front().path;
+			if(replicas.empty()) {
+				log->Debug(1,"Locfile::rewrite all mounts of %s are tripped, using the remote path",servername.c_str());
+			} else if(Router::instance().preferLocal(servername,lroot,remoteTarget(servername))) {
+				mode=Local;
+				target=lroot;
+				relPath=path;
+				std::string   lpath=lroot;
+				lpath.append(path);
+				this->path=lpath;
+
+				log->Debug(1,"Locfile::rewrite Setting plugIn to \"local\"- mode");
+				out<<" to: \""<<lpath<<"\""<<std::endl;
+				log->Debug(1,out.str().c_str());
+
+				return lpath;
+			}
+			log->Debug(1,"Locfile::rewrite router prefers the remote path for %s",servername.c_str());
 		}
 
 
+		mode=Default;
+		target=remoteTarget(servername);
+		this->path=proxify(url);
+		return this->path;
+	}
+
+	//------------------------------------------------------------------------
+	// Wrap a handler to time a remote operation for the adaptive router
+	//------------------------------------------------------------------------
+	XrdCl::ResponseHandler* timed(XrdCl::ResponseHandler* handler,uint64_t bytes) {
+		if(!routed || !Router::instance().isAdaptive()) return handler;
+		return new TimedHandler(handler,target,bytes);
+	}
+	XRootDStatus untime(XRootDStatus st,XrdCl::ResponseHandler* handler,XrdCl::ResponseHandler* wrapped) {
+		if(!st.IsOK() && wrapped!=handler) delete static_cast<TimedHandler*>(wrapped);
+		return st;
+	}
+
+	//------------------------------------------------------------------------
+	// Answer a request synchronously, the way all local operations do
+	//------------------------------------------------------------------------
+	static XRootDStatus respond(ResponseHandler* handler,const XRootDStatus& st,AnyObject* obj=0) {
+		if(handler) handler->HandleResponse(new XRootDStatus(st),obj);
+		else delete obj;
+		return st;
+	}
+	static XRootDStatus osError(const std::string& what,int err) {
+		std::string msg=what;
+		msg.append(": ");
+		msg.append(strerror(err));
+		return XRootDStatus(XrdCl::stError,XrdCl::errOSError,err,msg);
+	}
+
+	//------------------------------------------------------------------------
+	// xfile is only built for Default mode and hedged reads
+	//------------------------------------------------------------------------
+	XrdCl::File& remoteFile() {
+		if(!xfile) xfile.reset(new XrdCl::File(false)); //declare that xfile shall not recursively use plugins
+		return *xfile;
+	}
+	bool remoteOpen() const {
+		return xfile && xfile->IsOpen();
 	}
 
 	//Constructor
-	Locfile():xfile(false) { //declare that xfile shall not recursively use plugins
+	Locfile():hedgeOpened(0),deferred(false) {
 		XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
 		log->Debug(1,"Locfile::Locfile");
-		file=new fstream();
+		fd=-1;
 		mode=Undefined;
+		routed=false;
+		hedgeTried=false;
+		hedgeOpening=false;
+		remoteIdTried=false;
+		replicaIdx=0;
+		openFlags=OpenFlags::None;
+		openMode=Access::None;
+		openTimeout=0;
 
 	}
 
 
 	//Destructor
 	~Locfile() {
-		if(this->mode==Local && file!=NULL) delete file;
+		waitHedgeOpen();
+		wbuf.reset();
+		if(fd>=0) ::close(fd);
+		for(auto& r : replicaFds) ::close(r.second);
+		for(auto r : retiredFds) ::close(r);
+	}
+
+	//------------------------------------------------------------------------
+	// The open(2) flags for OpenFlags. Read-only opens skip the atime update,
+	// which is much cheaper on Lustre than a read-write open.
+	//------------------------------------------------------------------------
+	static int localOpenFlags(OpenFlags::Flags flags) {
+		int oflags=O_CLOEXEC;
+		bool write=flags & (OpenFlags::Update|OpenFlags::Write|OpenFlags::New|
+		                    OpenFlags::Delete|OpenFlags::Append);
+		if(!write) return oflags|O_RDONLY|O_NOATIME;
+		if(flags & OpenFlags::Write && !(flags & OpenFlags::Update)) oflags|=O_WRONLY;
+		else oflags|=O_RDWR;
+		if(flags & OpenFlags::Append) oflags|=O_APPEND;
+		if(flags & OpenFlags::New) oflags|=O_CREAT|O_EXCL;
+		else if(flags & OpenFlags::Delete) oflags|=O_CREAT|O_TRUNC;
+		return oflags;
+	}
+	//------------------------------------------------------------------------
+	// The permissions of a created file, Access::Mode uses the POSIX bits
+	//------------------------------------------------------------------------
+	static mode_t localMode(Access::Mode mode) {
+		mode_t m=mode & 0777;
+		return m?m:0666;
+	}
+	//------------------------------------------------------------------------
+	// Create the missing parent directories of lpath below root
+	//------------------------------------------------------------------------
+	static int makePath(const std::string& root,const std::string& lpath) {
+		for(size_t pos=lpath.find('/',root.size()+1); pos!=std::string::npos; pos=lpath.find('/',pos+1)) {
+			std::string dir=lpath.substr(0,pos);
+			if(::mkdir(dir.c_str(),0755)<0 && errno!=EEXIST) return -1;
+		}
+		return 0;
+	}
+
+	//------------------------------------------------------------------------
+	// The posix_fadvise advice for the descriptors of the file
+	//------------------------------------------------------------------------
+	int advice() const {
+		if(openFlags & OpenFlags::SeqIO) return POSIX_FADV_SEQUENTIAL;
+		if(readOnly()) return readAdvice;
+		return POSIX_FADV_NORMAL;
+	}
+
+	//------------------------------------------------------------------------
+	// Open the file below one local root. The open runs on a helper thread
+	// with a deadline, so a hung mount trips its breaker instead of blocking.
+	// Exclusive creates are not shared with concurrent opens. Callers that
+	// share an open get dups of one open file description: the flags and
+	// the read advice are part of the key, and its file offset is not used
+	// (all I/O is positional, readSparse's lseek only asks for extents).
+	//------------------------------------------------------------------------
+	XRootDStatus openReplica(const std::string& root,int oflags,uint16_t timeout,int& newfd) {
+		std::string lpath=root+relPath;
+		int adv=advice();
+		std::ostringstream key;
+		key<<oflags<<":"<<adv<<":"<<lpath;
+		mode_t perm=localMode(openMode);
+		bool mkpath=(oflags & O_CREAT) && (openFlags & OpenFlags::MakePath);
+		bool joined=false;
+		SingleFlight<OpenResult>::Call call=[&]() {
+			std::shared_ptr<OpenResult> res(new OpenResult());
+			int rc=-1;
+			res->st=HealthMonitor::instance().run(root,
+			[root,lpath,oflags,perm,mkpath,adv]() {
+				if(mkpath && makePath(root,lpath)<0) return -1;
+				int lfd=::open(lpath.c_str(),oflags,perm);
+				//--------------------------------------------------------------
+				// O_NOATIME needs the caller to own the file
+				//--------------------------------------------------------------
+				if(lfd<0 && errno==EPERM && (oflags & O_NOATIME))
+					lfd=::open(lpath.c_str(),oflags & ~O_NOATIME,perm);
+				if(lfd>=0 && adv!=POSIX_FADV_NORMAL) posix_fadvise(lfd,0,0,adv);
+				return lfd;
+			},
+			[](int lateFd) {
+				::close(lateFd);
+			},rc,timeout);
+			if(res->st.IsOK() && rc<0) res->err=errno;
+			res->fd=rc;
+			return res;
+		};
+		std::shared_ptr<OpenResult> r=(oflags & O_EXCL)?call():openFlight().run(key.str(),call,joined);
+		if(!r->st.IsOK()) return r->st;
+		if(r->fd<0) return osError("file could not be opened",r->err);
+		int nfd=fcntl(r->fd,F_DUPFD_CLOEXEC,0);
+		if(nfd<0) return osError("file could not be opened",errno);
+		newfd=nfd;
+		return XRootDStatus();
+	}
+
+	//------------------------------------------------------------------------
+	// stat of a local path, or fstat of fd if it is open, through the health
+	// monitor. Concurrent stats of the same path share one system call, an
+	// fstat answers for its own descriptor only and is not shared.
+	//------------------------------------------------------------------------
+	static XRootDStatus statLocal(const std::string& root,const std::string& lpath,int lfd,
+	                              uint16_t timeout,struct stat& out) {
+		bool joined=false;
+		std::shared_ptr<StatResult> r;
+		if(lfd>=0) r=statCall(root,lpath,lfd,timeout);
+		else r=statFlight().run(lpath,[&]() {
+			return statCall(root,lpath,-1,timeout);
+		},joined);
+		if(!r->st.IsOK()) return r->st;
+		if(r->err) return osError("stat failed",r->err);
+		out=r->sb;
+		return XRootDStatus();
+	}
+	static std::shared_ptr<StatResult> statCall(const std::string& root,const std::string& lpath,
+	                                            int lfd,uint16_t timeout) {
+		std::shared_ptr<StatResult> res(new StatResult());
+		std::shared_ptr<struct stat> buf(new struct stat);
+		int rc=-1;
+		res->st=HealthMonitor::instance().run(root,[lpath,lfd,buf]() {
+			return lfd>=0?fstat(lfd,buf.get()) : ::stat(lpath.c_str(),buf.get());
+		},std::function<void(int)>(),rc,timeout);
+		if(res->st.IsOK()) {
+			if(rc<0) res->err=errno;
+			else res->sb=*buf;
+		}
+		return res;
+	}
+	static void printFlightStats() {
+		openFlight().printStats();
+		statFlight().printStats();
+	}
+
+	//------------------------------------------------------------------------
+	// Move the file to the next replica after an I/O error on failedFd of
+	// root, the file has to exist there already. The root is reported to
+	// the health monitor and no longer balanced to.
+	//------------------------------------------------------------------------
+	bool failover(int failedFd,const std::string& root) {
+		XrdSysMutexHelper lck(replicaMtx);
+		if(failedRoots.insert(root).second) HealthMonitor::instance().failed(root);
+		auto it=replicaFds.find(root);
+		if(it!=replicaFds.end() && it->second==failedFd) {
+			//----------------------------------------------------------------
+			// A balanced read failed, the next one goes elsewhere
+			//----------------------------------------------------------------
+			retiredFds.push_back(failedFd);
+			replicaFds.erase(it);
+			return true;
+		}
+		if(fd!=failedFd) return true; // another thread already moved on
+		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
+		for(size_t i=replicaIdx+1; i<replicas.size(); ++i) {
+			if(failedRoots.count(replicas[i].path)) continue;
+			int nfd=-1;
+			int oflags=localOpenFlags(openFlags) & ~(O_CREAT|O_EXCL|O_TRUNC);
+			if(!openReplica(replicas[i].path,oflags,0,nfd).IsOK()) continue;
+			log->Warning(1,"Locfile::failover %s: moving from %s to %s",relPath.c_str(),
+			             replicas[replicaIdx].path.c_str(),replicas[i].path.c_str());
+			if(wbuf) {
+				wbuf->barrier();
+				wbuf->setFd(nfd);
+			}
+			::close(fd);
+			fd=nfd;
+			replicaIdx=i;
+			target=replicas[i].path;
+			this->path=target+relPath;
+			stripes=StripeScheduler::instance().layout(fd);
+			return true;
+		}
+		return false;
+	}
+
+	//------------------------------------------------------------------------
+	// The descriptor a read should use: with "replicabalance = read" files
+	// opened for reading spread their reads over all healthy replicas
+	//------------------------------------------------------------------------
+	int readFd(std::string& root) {
+		XrdSysMutexHelper lck(replicaMtx);
+		root=target;
+		if(!balancePerRead || replicas.size()<2) return fd;
+		if(!readOnly()) return fd;
+		std::string best=ReplicaSelector::instance().pick(replicas);
+		if(best.empty() || best==target || failedRoots.count(best) ||
+		   !HealthMonitor::instance().available(best)) return fd;
+		auto it=replicaFds.find(best);
+		if(it!=replicaFds.end()) {
+			root=best;
+			return it->second;
+		}
+		int nfd=-1;
+		if(!openReplica(best,localOpenFlags(OpenFlags::Read),0,nfd).IsOK()) return fd;
+		replicaFds[best]=nfd;
+		root=best;
+		return nfd;
+	}
+
+	bool readOnly() const {
+		return !(openFlags & (OpenFlags::Update|OpenFlags::Write|OpenFlags::New|
+		                      OpenFlags::Delete|OpenFlags::Append));
+	}
+
+	//------------------------------------------------------------------------
+	// Only files opened read-only go through the block caches, nothing
+	// invalidates blocks on writes
+	//------------------------------------------------------------------------
+	static bool caching() {
+		return BlockCache::instance().enabled() || ShmCache::instance().enabled();
+	}
+	bool cached() const {
+		return cacheId.valid() && caching();
+	}
+
+	//------------------------------------------------------------------------
+	// Read len bytes at off from the local file, moving on to the next
+	// replica on errors, each replica is tried once. Returns the number of
+	// bytes read or -errno.
+	//------------------------------------------------------------------------
+	ssize_t readLocal(int& rfd,std::string& root,char* buf,size_t len,uint64_t off) {
+		size_t done=0;
+		size_t attempts=0;
+		while(done<len) {
+			ssize_t r=pread(rfd,buf+done,len-done,off+done);
+			if(r<0 && errno==EINTR) continue;
+			if(r<0) {
+				int err=errno;
+				if(++attempts>=std::max<size_t>(replicas.size(),1) || !failover(rfd,root)) return -err;
+				rfd=readFd(root);
+				continue;
+			}
+			if(r==0) break;
+			done+=r;
+		}
+		return done;
+	}
+
+	//------------------------------------------------------------------------
+	// readLocal for large reads of sparse files: the data extents are read,
+	// the holes between them are filled with zeros without touching the
+	// file system
+	//------------------------------------------------------------------------
+	ssize_t readSparse(int& rfd,std::string& root,char* buf,size_t len,uint64_t off) {
+		if(!sparseRead || len<sparseRead) return readLocal(rfd,root,buf,len,off);
+		size_t done=0;
+		while(done<len) {
+			uint64_t pos=off+done;
+			off_t data=lseek(rfd,pos,SEEK_DATA);
+			if(data<0 && errno==ENXIO) {
+				//------------------------------------------------------------
+				// A hole up to the end of the file
+				//------------------------------------------------------------
+				struct stat sb;
+				if(fstat(rfd,&sb)<0) return -errno;
+				if((uint64_t)sb.st_size>pos) {
+					size_t n=std::min<uint64_t>(len-done,sb.st_size-pos);
+					memset(buf+done,0,n);
+					done+=n;
+				}
+				break;
+			}
+			if(data<0) {
+				ssize_t r=readLocal(rfd,root,buf+done,len-done,pos); // no extent information
+				return r<0?r:done+r;
+			}
+			if((uint64_t)data>pos) {
+				size_t n=std::min<uint64_t>(len-done,data-pos);
+				memset(buf+done,0,n);
+				done+=n;
+				continue;
+			}
+			off_t hole=lseek(rfd,pos,SEEK_HOLE);
+			size_t n=len-done;
+			if(hole>0 && (uint64_t)hole-pos<n) n=hole-pos;
+			ssize_t r=readLocal(rfd,root,buf+done,n,pos);
+			if(r<0) return r;
+			done+=r;
+			if((size_t)r<n) break;
+		}
+		return done;
+	}
+
+	//------------------------------------------------------------------------
+	// readLocal, through the block caches if the file is cached: the
+	// process cache is filled from the node wide one, which is filled
+	// from the file
+	//------------------------------------------------------------------------
+	ssize_t readBlocks(int& rfd,std::string& root,char* buf,uint32_t len,uint64_t off) {
+		if(!cached()) return readSparse(rfd,root,buf,len,off);
+		BlockCache::Loader disk=[this,&rfd,&root](char* b,size_t l,uint64_t o) {
+			return readSparse(rfd,root,b,l,o);
+		};
+		BlockCache::Loader node=disk;
+		if(ShmCache::instance().enabled()) {
+			node=[this,&disk](char* b,size_t l,uint64_t o) {
+				return ShmCache::instance().read(cacheId,o,l,b,disk);
+			};
+		}
+		if(!BlockCache::instance().enabled()) return node(buf,len,off);
+		return BlockCache::instance().read(cacheId,off,len,buf,node);
+	}
+
+	//------------------------------------------------------------------------
+	// readBlocks for each chunk, got holds the bytes read per chunk. Chunks
+	// of a striped file covering more than one OST go to the stripe
+	// scheduler. Returns 0 or errno.
+	//------------------------------------------------------------------------
+	int readChunks(int& rfd,std::string& root,const ChunkList& chunks,std::vector<uint32_t>& got) {
+		std::shared_ptr<const StripeLayout> sl;
+		{
+			XrdSysMutexHelper lck(replicaMtx);
+			if(rfd==fd) sl=stripes;
+		}
+		if(sl && !cached() && StripeScheduler::spreads(*sl,chunks)) {
+			int sfd=rfd;
+			std::string sroot=root;
+			return StripeScheduler::instance().read(*sl,chunks,got,[this,sfd,sroot](char* b,size_t l,uint64_t o) {
+				int f=sfd;
+				std::string r=sroot;
+				return readSparse(f,r,b,l,o);
+			});
+		}
+		got.assign(chunks.size(),0);
+		for(size_t i=0; i<chunks.size(); ++i) {
+			ssize_t done=readBlocks(rfd,root,(char*)chunks[i].buffer,chunks[i].length,chunks[i].offset);
+			if(done<0) return -done;
+			got[i]=done;
+		}
+		return 0;
+	}
+
+	//------------------------------------------------------------------------
+	// Whether Default mode reads go through the disk cache. The remote file
+	// version comes from the StatInfo XrdCl keeps from the open.
+	//------------------------------------------------------------------------
+	bool diskCached() {
+		if(!DiskCache::instance().enabled() || !readOnly()) return false;
+		XrdSysMutexHelper lck(replicaMtx);
+		if(remoteIdTried) return remoteId.valid();
+		remoteIdTried=true;
+		StatInfo* sinfo=0;
+		XRootDStatus st=xfile->Stat(false,sinfo);
+		if(st.IsOK() && sinfo) {
+			XrdCl::URL u(origUrl);
+			remoteId=DiskCache::remoteId(u.GetHostId()+"/"+u.GetPath(),sinfo->GetSize(),sinfo->GetModTime());
+		} else {
+			XrdCl::DefaultEnv::GetLog()->Debug(1,"Locfile::diskCached no stat for %s, not caching",origUrl.c_str());
+		}
+		delete sinfo;
+		return remoteId.valid();
+	}
+
+	//------------------------------------------------------------------------
+	// A disk cached Read or VectorRead. The span of blocks a chunk misses is
+	// fetched from xfile with one asynchronous read, the last fetch to come
+	// back answers the caller. Holds no reference to the Locfile.
+	//------------------------------------------------------------------------
+	class CachedRead {
+		public:
+			CachedRead(const FileId& i,const ChunkList& c,bool v,ResponseHandler* h):id(i),
+				chunks(c),spans(c.size()),got(c.size(),0),vector(v),handler(h),refs(1) {}
+
+			//--------------------------------------------------------------------
+			// Fetch the span of chunk i, false if the read could not be sent
+			//--------------------------------------------------------------------
+			bool fetch(XrdCl::File& file,size_t i,uint16_t timeout) {
+				DiskCache::Span& s=spans[i];
+				refs++;
+				SpanHandler* h=new SpanHandler(this,i);
+				XRootDStatus st=file.Read(s.offset,s.length,&s.data[0],h,timeout);
+				if(st.IsOK()) return true;
+				delete h;
+				done(i,st,0);
+				return false;
+			}
+
+			//--------------------------------------------------------------------
+			// A fetch came back, or (i<0) all of them were sent
+			//--------------------------------------------------------------------
+			void done(ssize_t i,const XRootDStatus& st,uint32_t n) {
+				if(i>=0) {
+					if(st.IsOK()) {
+						got[i]=DiskCache::instance().complete(id,chunks[i].offset,chunks[i].length,
+						                                      (char*)chunks[i].buffer,spans[i],n);
+					} else {
+						XrdSysMutexHelper lck(mtx);
+						err=st;
+					}
+				}
+				if(--refs) return;
+				if(!err.IsOK()) respond(handler,err);
+				else if(vector) {
+					uint32_t total=0;
+					respond(handler,XRootDStatus(),vectorInfo(chunks,got,total));
+				} else {
+					AnyObject* obj=new AnyObject();
+					obj->Set(new ChunkInfo(chunks[0].offset,got[0],chunks[0].buffer));
+					respond(handler,XRootDStatus(),obj);
+				}
+				delete this;
+			}
+
+			FileId                         id;
+			ChunkList                      chunks;
+			std::vector<DiskCache::Span>   spans;
+			std::vector<uint32_t>          got;
+		private:
+			class SpanHandler: public ResponseHandler {
+				public:
+					SpanHandler(CachedRead* r,size_t i):read(r),index(i) {}
+					virtual void HandleResponse(XRootDStatus* status,AnyObject* response) {
+						uint32_t n=0;
+						ChunkInfo* chunk=0;
+						if(status->IsOK() && response) response->Get(chunk);
+						if(chunk) n=chunk->length;
+						read->done(index,*status,n);
+						delete status;
+						delete response;
+						delete this;
+					}
+				private:
+					CachedRead* read;
+					size_t      index;
+			};
+			bool                  vector;
+			ResponseHandler*      handler;
+			std::atomic<int>      refs;
+			XRootDStatus          err;
+			XrdSysMutex           mtx;
+	};
+
+	//------------------------------------------------------------------------
+	// Read the chunks through the disk cache, answered asynchronously when
+	// blocks are missing
+	//------------------------------------------------------------------------
+	XRootDStatus cachedRead(const ChunkList& chunks,bool vector,ResponseHandler* handler,uint16_t timeout) {
+		CachedRead* r=new CachedRead(remoteId,chunks,vector,handler);
+		for(size_t i=0; i<chunks.size(); ++i) {
+			ssize_t done=DiskCache::instance().begin(remoteId,chunks[i].offset,chunks[i].length,
+			                                         (char*)chunks[i].buffer,r->spans[i]);
+			if(done>=0) r->got[i]=done;
+			else if(!r->fetch(*xfile,i,timeout)) break;
+		}
+		r->done(-1,XRootDStatus(),0);
+		return XRootDStatus();
 	}
 
 	//Open()
@@ -149,77 +810,198 @@ public:
 	                           ResponseHandler   *handler,
 	                           uint16_t           timeout ) {
 		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
-		XRootDStatus* ret_st;
 
+		origUrl=url;
 		auto newurl= rewrite_path(url);
 		log->Debug(1,"Locfile::Open");
-		if(this->mode==Default) {
-			return xfile.Open(newurl,flags,mode,handler,timeout);
+		openFlags=flags;
+		openMode=mode;
+		if(this->mode==Local && lazyOpen && readOnly()) {
+			//--------------------------------------------------------------------
+			// The path is checked now, the open itself waits for the first I/O.
+			// A mount that does not answer is left to the full open.
+			//--------------------------------------------------------------------
+			XRootDStatus st=checkLocal(timeout);
+			if(st.code!=XrdCl::errOperationExpired) {
+				if(!st.IsOK()) return respond(handler,st);
+				openTimeout=timeout;
+				deferred.store(true,std::memory_order_release);
+				return respond(handler,XRootDStatus());
+			}
 		}
 		if(this->mode==Local) {
-			file->open(newurl.c_str(),std::ios::in  | std::ios::out| std::ios::app );
-			if(file->fail()) {
-				ret_st=new XRootDStatus( XrdCl::stError,XrdCl::errOSError, 1,"file could not be opened");
-				handler->HandleResponse(ret_st,0);
-				return *ret_st;
-			} else {
-				ret_st=new XRootDStatus(XrdCl::stOK,0,0,"");
-				handler->HandleResponse(ret_st,0);
-				return *ret_st;
+			bool fellBack=false;
+			XRootDStatus st=openLocal(timeout,fellBack);
+			if(!fellBack) return respond(handler,st);
+			newurl=this->path;
+		}
+		if(this->mode==Default) {
+			XrdCl::ResponseHandler* h=timed(handler,0);
+			return untime(remoteFile().Open(newurl,flags,mode,h,timeout),handler,h);
+		}
+		return XRootDStatus( XrdCl::stError,XrdCl::errInvalidOp,0,"undefined mode");
+	}
+
+	//------------------------------------------------------------------------
+	// Check that the local file of a lazy Open exists and is readable, with
+	// the errno the open would fail with. One lookup, the size is only taken
+	// if a Stat asks for it.
+	//------------------------------------------------------------------------
+	XRootDStatus checkLocal(uint16_t timeout) {
+		int rc=-1;
+		std::string lpath=this->path;
+		XRootDStatus st=HealthMonitor::instance().run(target,[lpath]() {
+			return faccessat(AT_FDCWD,lpath.c_str(),R_OK,AT_EACCESS);
+		},std::function<void(int)>(),rc,timeout);
+		if(!st.IsOK()) return st;
+		if(rc<0) return osError("file could not be opened",errno);
+		return XRootDStatus();
+	}
+
+	//------------------------------------------------------------------------
+	// Open the local file. The replicas are tried best first, if all of them
+	// time out their mounts are tripped, the file switches to Default mode
+	// and fellBack is set: the caller has to open xfile on path.
+	//------------------------------------------------------------------------
+	XRootDStatus openLocal(uint16_t timeout,bool& fellBack) {
+		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
+		XRootDStatus last;
+		bool expired=true;
+		for(size_t i=0; i<replicas.size(); ++i) {
+			double start=Utils::now();
+			int nfd=-1;
+			XRootDStatus st=openReplica(replicas[i].path,localOpenFlags(openFlags),timeout,nfd);
+			if(st.IsOK()) {
+				replicaIdx=i;
+				target=replicas[i].path;
+				this->path=target+relPath;
+				fd=nfd;
+				if(routed) Router::instance().record(target,0,Utils::now()-start);
+				struct stat sb;
+				if(caching() && readOnly() && fstat(fd,&sb)==0 && S_ISREG(sb.st_mode))
+					cacheId=FileId::of(sb);
+				if(!readOnly() && WriteBehind::instance().enabled())
+					wbuf.reset(WriteBehind::instance().create(fd));
+				stripes=StripeScheduler::instance().layout(fd);
+				if(localOpenFlags(openFlags) & O_CREAT)
+					LocateCache::instance().invalidate(this->path.substr(0,this->path.rfind('/')));
+				return XRootDStatus();
 			}
+			log->Debug(1,"Locfile::Open %s on %s: %s",relPath.c_str(),replicas[i].path.c_str(),st.ToStr().c_str());
+			if(st.code!=XrdCl::errOperationExpired) expired=false;
+			last=st;
 		}
+		if(!expired) return last;
+		log->Warning(1,"Locfile::Open %s, falling back to the remote path",last.ToStr().c_str());
+		this->mode=Default;
+		target=remoteTarget(XrdCl::URL(origUrl).GetHostName());
+		this->path=proxify(origUrl);
+		fellBack=true;
+		return XRootDStatus();
+	}
+
+	//------------------------------------------------------------------------
+	// Do the open deferred by a lazy Open, called by every I/O
+	//------------------------------------------------------------------------
+	XRootDStatus ensureOpen() {
+		if(!deferred.load(std::memory_order_acquire)) return openStatus;
+		XrdSysMutexHelper lck(openMtx);
+		if(!deferred.load(std::memory_order_relaxed)) return openStatus;
+		bool fellBack=false;
+		XRootDStatus st=openLocal(openTimeout,fellBack);
+		if(fellBack) st=remoteFile().Open(this->path,openFlags,openMode,openTimeout);
+		openStatus=st;
+		deferred.store(false,std::memory_order_release);
+		return st;
+	}
+
+	//------------------------------------------------------------------------
+	// Write out the write-behind buffer before an operation that has to see
+	// the data, returns the error of a failed flush
+	//------------------------------------------------------------------------
+	XRootDStatus writeBarrier() {
+		if(!wbuf) return XRootDStatus();
+		int e=wbuf->barrier();
+		if(e) return osError("write failed",e);
+		return XRootDStatus();
 	}
 
 	virtual XRootDStatus Close(ResponseHandler *handler,uint16_t timeout) {
-		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
+		if(deferred.exchange(false)) return respond(handler,XRootDStatus()); // never opened
 		if(mode==Default) {
-			return xfile.Close(handler,timeout);
+			return xfile->Close(handler,timeout);
 		}
 
 		if(mode==Local) {
-			file->close();
-			XRootDStatus* ret_st=new XRootDStatus(XrdCl::stOK,0,0,"");
-			handler->HandleResponse(ret_st,0);
-			return  XRootDStatus(XrdCl::stOK,0,0,"");
+			waitHedgeOpen();
+			if(remoteOpen()) {
+				XRootDStatus hst=xfile->Close();
+				if(!hst.IsOK()) XrdCl::DefaultEnv::GetLog()->Debug(1,"Locfile::Close hedge file: %s",hst.ToStr().c_str());
+			}
+			XRootDStatus wst=writeBarrier();
+			wbuf.reset();
+			if(wst.IsOK() && fd>=0 && !readOnly() && SyncEngine::instance().syncOnClose()) {
+				int e=SyncEngine::instance().sync(fd);
+				if(e) wst=osError("sync failed",e);
+			}
+			int res=(fd>=0)?::close(fd):0;
+			int err=errno;
+			fd=-1;
+			for(auto& r : replicaFds) ::close(r.second);
+			replicaFds.clear();
+			for(auto r : retiredFds) ::close(r);
+			retiredFds.clear();
+			if(!wst.IsOK()) return respond(handler,wst);
+			if(res<0) return respond(handler,osError("close failed",err));
+			return respond(handler,XRootDStatus());
 		}
-
-
+		return XRootDStatus( XrdCl::stError,XrdCl::errInvalidOp,0,"undefined mode");
 	}
 
 	virtual bool IsOpen()  const    {
-		if(this->mode==Default)             return xfile.IsOpen();
-		if(this->mode==Local && file!=NULL) return file->is_open();
+		if(deferred.load(std::memory_order_acquire)) return true;
+		if(this->mode==Default) return remoteOpen();
+		if(this->mode==Local)   return fd>=0;
 		return false;
 
 	}
+
+	//------------------------------------------------------------------------
+	// Turn a local stat into the server's "id size flags mtime" format
+	//------------------------------------------------------------------------
+	static StatInfo* toStatInfo(const struct stat& s) {
+		StatInfo* sinfo = new StatInfo();
+		if(!sinfo->ParseServerResponse(Utils::statLine(s).c_str())) {
+			delete sinfo;
+			return 0;
+		}
+		return sinfo;
+	}
+
 	virtual XRootDStatus Stat(bool force,ResponseHandler *handler,uint16_t timeout) {
 		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
 		log->Debug(1,"Locfile::Stat");
 
+		if(deferred.load(std::memory_order_acquire)) return lazyStatInfo(force,handler,timeout);
 		if(this->mode==Default) {
-			return xfile.Stat(force,handler,timeout);
+			return xfile->Stat(force,handler,timeout);
 		}
 		if(this->mode==Local) {
-			if(file->is_open() && file!=NULL) {
+			if(fd>=0) {
+				XRootDStatus wst=writeBarrier();
+				if(!wst.IsOK()) return respond(handler,wst);
 				struct stat s;
-				stat(path.c_str(),&s);
-				StatInfo* sinfo = new StatInfo();
-				std::ostringstream data;
-				data<<s.st_dev <<" "<< s.st_size <<" "<<s.st_mode<<" "<<s.st_mtime ;
-				std::string output ="Locfile::Stat, stats are: (_dev,_size,_mode,_mtime) ";
-				output.append(data.str().c_str());
-				log->Debug(1,output.c_str());
-
-				if(!sinfo->ParseServerResponse(data.str().c_str())) {
-					delete sinfo;
+				XRootDStatus st=statLocal(target,this->path,fd,timeout,s);
+				if(!st.IsOK()) return st;
+
+				StatInfo* sinfo = toStatInfo(s);
+				if(!sinfo) {
 					return XRootDStatus(XrdCl::stError, errDataError);
 				} else {
-					XRootDStatus* ret_st = new XRootDStatus(XrdCl::stOK, 0, 0, "");
 					AnyObject* obj = new AnyObject();
 					obj->Set(sinfo);
-					handler->HandleResponse(ret_st, obj);
 					log->Debug( 1, "Locfile::Stat returning stat structure");
-					return XRootDStatus( XrdCl::stOK,0,0,"");
+					return respond(handler,XRootDStatus(),obj);
 				}
 
 
@@ -231,26 +1013,226 @@ public:
 				return XRootDStatus( XrdCl::stError,XrdCl::errOSError,-1,"no file opened error");
 	}
 
+	//------------------------------------------------------------------------
+	// Stat of a file whose lazy open was not done yet: a stat of the path,
+	// taken by the first call and kept for later ones unless forced
+	//------------------------------------------------------------------------
+	XRootDStatus lazyStatInfo(bool force,ResponseHandler *handler,uint16_t timeout) {
+		std::shared_ptr<struct stat> s;
+		{
+			XrdSysMutexHelper lck(openMtx);
+			if(!force) s=lazyStat;
+		}
+		if(!s) {
+			s.reset(new struct stat);
+			XRootDStatus st=statLocal(target,this->path,-1,timeout,*s);
+			if(!st.IsOK()) return st;
+			XrdSysMutexHelper lck(openMtx);
+			lazyStat=s;
+		}
+		StatInfo* sinfo=toStatInfo(*s);
+		if(!sinfo) return XRootDStatus(XrdCl::stError,errDataError);
+		AnyObject* obj=new AnyObject();
+		obj->Set(sinfo);
+		return respond(handler,XRootDStatus(),obj);
+	}
+
 	virtual XRootDStatus Read(uint64_t offset,uint32_t length,
 	                          void  *buffer,XrdCl::ResponseHandler *handler,
 	                          uint16_t timeout ) {
 		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
 		log->Debug(1,"Locfile::Read");
+		XRootDStatus ost=ensureOpen();
+		if(!ost.IsOK()) return respond(handler,ost);
 		if(mode==Default) {
-			assert(xfile.IsOpen()==true);
-			return xfile.Read(offset,length,buffer,handler,timeout);
+			assert(remoteOpen());
+			if(diskCached()) {
+				ChunkList chunks;
+				chunks.push_back(ChunkInfo(offset,length,buffer));
+				return cachedRead(chunks,false,handler,timeout);
+			}
+			XrdCl::ResponseHandler* h=timed(handler,length);
+			return untime(xfile->Read(offset,length,buffer,h,timeout),handler,h);
 
 		}
 		if(mode==Local) {
-			file->seekp(offset);
-			file->read( (char*)buffer,length);
-			XRootDStatus* ret_st=new XRootDStatus(XrdCl::stOK,0,0,"");
-			ChunkInfo* chunkInfo=new ChunkInfo(offset,length,buffer );
+			XRootDStatus wst=writeBarrier();
+			if(!wst.IsOK()) return respond(handler,wst);
+		}
+		if(mode==Local && Hedger::instance().enabled() && !cached()) {
+			ChunkList chunks;
+			chunks.push_back(ChunkInfo(offset,length,buffer));
+			std::vector<uint32_t> got;
+			std::string root;
+			int rfd=readFd(root);
+			InFlight inflight(root);
+			XRootDStatus st=Hedger::instance().read(rfd,root,chunks,hedgeOpener(),timeout,got);
+			if(!st.IsOK() && failover(rfd,root)) {
+				rfd=readFd(root);
+				st=Hedger::instance().read(rfd,root,chunks,hedgeOpener(),timeout,got);
+			}
+			if(!st.IsOK()) return respond(handler,st);
+			ChunkInfo* chunkInfo=new ChunkInfo(offset,got[0],buffer );
 			AnyObject* obj=new AnyObject();
 			obj->Set(chunkInfo);
-			handler->HandleResponse(ret_st,obj);
-			return  XRootDStatus(XrdCl::stOK,0,0,"");
+			return respond(handler,XRootDStatus(),obj);
+		}
+		if(mode==Local) {
+			double start=Utils::now();
+			std::string root;
+			int rfd=readFd(root);
+			InFlight inflight(root);
+			ChunkList chunks;
+			chunks.push_back(ChunkInfo(offset,length,buffer));
+			std::vector<uint32_t> got;
+			int err=readChunks(rfd,root,chunks,got);
+			if(err) return respond(handler,osError("read failed",err));
+			if(routed) Router::instance().record(root,got[0],Utils::now()-start);
+			ChunkInfo* chunkInfo=new ChunkInfo(offset,got[0],buffer );
+			AnyObject* obj=new AnyObject();
+			obj->Set(chunkInfo);
+			return respond(handler,XRootDStatus(),obj);
+		}
+		return XRootDStatus( XrdCl::stError,XrdCl::errInvalidOp,0,"undefined mode");
+	}
+
+	//------------------------------------------------------------------------
+	// Reports a failed open of the file hedged reads go to
+	//------------------------------------------------------------------------
+	class HedgeOpenHandler: public ResponseHandler {
+		public:
+			HedgeOpenHandler(const std::string& u,XrdSysSemaphore& d):url(u),done(d) {}
+			virtual void HandleResponse(XRootDStatus* status,AnyObject* response) {
+				if(!status->IsOK()) {
+					XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
+					log->Warning(1,"Locfile::openHedge cannot open %s for hedged reads: %s",url.c_str(),status->ToStr().c_str());
+				}
+				delete status;
+				delete response;
+				XrdSysSemaphore& d=done;
+				delete this;
+				d.Post();
+			}
+		private:
+			std::string url;
+			XrdSysSemaphore& done;
+	};
+
+	//------------------------------------------------------------------------
+	// xfile cannot be closed or deleted while it is being opened
+	//------------------------------------------------------------------------
+	void waitHedgeOpen() {
+		{
+			XrdSysMutexHelper lck(hedgeMtx);
+			if(!hedgeOpening) return;
+			hedgeOpening=false;
 		}
+		hedgeOpened.Wait();
+	}
+
+	//------------------------------------------------------------------------
+	// The file hedged reads go to, xfile opened on the original URL by the
+	// first read that used half of its budget. The open is not waited for:
+	// the Hedger asks again until it is done.
+	//------------------------------------------------------------------------
+	XrdCl::File* openHedge() {
+		XrdSysMutexHelper lck(hedgeMtx);
+		if(remoteOpen()) return xfile.get();
+		if(hedgeTried) return 0;
+		hedgeTried=true;
+		std::string url=proxify(origUrl);
+		HedgeOpenHandler* h=new HedgeOpenHandler(url,hedgeOpened);
+		XRootDStatus st=remoteFile().Open(url,OpenFlags::Read,Access::None,h,0);
+		if(st.IsOK()) hedgeOpening=true;
+		else {
+			delete h;
+			XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
+			log->Warning(1,"Locfile::openHedge cannot open %s for hedged reads: %s",url.c_str(),st.ToStr().c_str());
+		}
+		return 0;
+	}
+	Hedger::RemoteOpener hedgeOpener() {
+		return [this]() {
+			return openHedge();
+		};
+	}
+
+	virtual XRootDStatus VectorRead(const ChunkList &chunks,
+	                                void            *buffer,
+	                                ResponseHandler *handler,
+	                                uint16_t         timeout ) {
+		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
+		log->Debug(1,"Locfile::VectorRead");
+		XRootDStatus ost=ensureOpen();
+		if(!ost.IsOK()) return respond(handler,ost);
+		if(mode==Default && !diskCached()) {
+			assert(remoteOpen());
+			uint64_t total=0;
+			for(auto& ch : chunks) total+=ch.length;
+			XrdCl::ResponseHandler* h=timed(handler,total);
+			return untime(xfile->VectorRead(chunks,buffer,h,timeout),handler,h);
+		}
+		if(mode!=Local && mode!=Default) return XRootDStatus( XrdCl::stError,XrdCl::errInvalidOp,0,"undefined mode");
+		if(mode==Local) {
+			XRootDStatus wst=writeBarrier();
+			if(!wst.IsOK()) return respond(handler,wst);
+		}
+
+		//--------------------------------------------------------------------
+		// Chunks without a buffer of their own are placed back to back into
+		// the buffer given by the caller
+		//--------------------------------------------------------------------
+		ChunkList local;
+		char* cursor=(char*)buffer;
+		for(auto& ch : chunks) {
+			void* dst=ch.buffer;
+			if(!dst) {
+				if(!cursor) return XRootDStatus(XrdCl::stError,XrdCl::errInvalidArgs,0,"no buffer for chunk");
+				dst=cursor;
+				cursor+=ch.length;
+			}
+			local.push_back(ChunkInfo(ch.offset,ch.length,dst));
+		}
+
+		if(mode==Default) return cachedRead(local,true,handler,timeout);
+		std::vector<uint32_t> got(local.size(),0);
+
+		double start=Utils::now();
+		std::string root;
+		int rfd=readFd(root);
+		InFlight inflight(root);
+		if(Hedger::instance().enabled() && !cached()) {
+			XRootDStatus st=Hedger::instance().read(rfd,root,local,hedgeOpener(),timeout,got);
+			if(!st.IsOK() && failover(rfd,root)) {
+				rfd=readFd(root);
+				st=Hedger::instance().read(rfd,root,local,hedgeOpener(),timeout,got);
+			}
+			if(!st.IsOK()) return respond(handler,st);
+		} else {
+			int err=readChunks(rfd,root,local,got);
+			if(err) return respond(handler,osError("vector read failed",err));
+		}
+
+		uint32_t total=0;
+		AnyObject* obj=vectorInfo(local,got,total);
+		if(routed) Router::instance().record(root,total,Utils::now()-start);
+		return respond(handler,XRootDStatus(),obj);
+	}
+
+	//------------------------------------------------------------------------
+	// The response of a vector read, got holds the bytes read per chunk
+	//------------------------------------------------------------------------
+	static AnyObject* vectorInfo(const ChunkList& chunks,const std::vector<uint32_t>& got,uint32_t& total) {
+		VectorReadInfo* info=new VectorReadInfo();
+		total=0;
+		for(size_t i=0; i<chunks.size(); ++i) {
+			info->GetChunks().push_back(ChunkInfo(chunks[i].offset,got[i],chunks[i].buffer));
+			total+=got[i];
+		}
+		info->SetSize(total);
+		AnyObject* obj=new AnyObject();
+		obj->Set(info);
+		return obj;
 	}
 
 	XRootDStatus Write( uint64_t         offset,
@@ -260,23 +1242,83 @@ public:
 	                    uint16_t         timeout = 0 ) {
 		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
 		log->Debug(1,"Locfile::Write");
+		XRootDStatus ost=ensureOpen();
+		if(!ost.IsOK()) return respond(handler,ost);
+		if(mode==Local && wbuf) {
+			int e=wbuf->write((const char*)buffer,size,offset);
+			if(e) return respond(handler,osError("write failed",e));
+			return respond(handler,XRootDStatus());
+		}
 		if(mode==Local) {
-			file->seekg(offset);
-			file->write((char*)buffer,size);
-			XRootDStatus* ret_st=new XRootDStatus(XrdCl::stOK,0,0,"");
-			handler->HandleResponse(ret_st,0);
-			return  XRootDStatus(XrdCl::stOK,0,0,"");
+			double start=Utils::now();
+			InFlight inflight(target);
+			uint32_t done=0;
+			while(done<size) {
+				ssize_t r=pwrite(fd,(const char*)buffer+done,size-done,offset+done);
+				if(r<0 && errno==EINTR) continue;
+				if(r<0) return respond(handler,osError("write failed",errno));
+				done+=r;
+			}
+			if(routed) Router::instance().record(target,size,Utils::now()-start);
+			return respond(handler,XRootDStatus());
 
 		}
 		if(mode==Default) {
-			assert(xfile.IsOpen()==true);
-			return xfile.Write(offset,size,buffer,handler,timeout);
+			assert(remoteOpen());
+			XrdCl::ResponseHandler* h=timed(handler,size);
+			return untime(xfile->Write(offset,size,buffer,h,timeout),handler,h);
 		}
 	    
 			throw std::runtime_error("Locfilesys:: undefined mode");
 	}
+
+	virtual XRootDStatus Sync(ResponseHandler *handler,uint16_t timeout) {
+		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
+		log->Debug(1,"Locfile::Sync");
+		XRootDStatus ost=ensureOpen();
+		if(!ost.IsOK()) return respond(handler,ost);
+		if(mode==Default) {
+			assert(remoteOpen());
+			return xfile->Sync(handler,timeout);
+		}
+		if(mode==Local) {
+			XRootDStatus wst=writeBarrier();
+			if(!wst.IsOK()) return respond(handler,wst);
+			int e=SyncEngine::instance().sync(fd);
+			if(e) return respond(handler,osError("sync failed",e));
+			return respond(handler,XRootDStatus());
+		}
+		return XRootDStatus( XrdCl::stError,XrdCl::errInvalidOp,0,"undefined mode");
+	}
+
+	virtual XRootDStatus Truncate(uint64_t size,ResponseHandler *handler,uint16_t timeout) {
+		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
+		log->Debug(1,"Locfile::Truncate");
+		XRootDStatus ost=ensureOpen();
+		if(!ost.IsOK()) return respond(handler,ost);
+		if(mode==Default) {
+			assert(remoteOpen());
+			return xfile->Truncate(size,handler,timeout);
+		}
+		if(mode==Local) {
+			XRootDStatus wst=writeBarrier();
+			if(!wst.IsOK()) return respond(handler,wst);
+			int lfd=fd,rc=-1;
+			XRootDStatus st=HealthMonitor::instance().run(target,[lfd,size]() {
+				return ftruncate(lfd,size);
+			},std::function<void(int)>(),rc,timeout);
+			if(!st.IsOK()) return respond(handler,st);
+			if(rc<0) return respond(handler,osError("truncate failed",errno));
+			return respond(handler,XRootDStatus());
+		}
+		return XRootDStatus( XrdCl::stError,XrdCl::errInvalidOp,0,"undefined mode");
+	}
 };
-std::map<std::string,std::string> Locfile::swapLocalMap ;
+std::map<std::string,std::vector<LocalRoot> > Locfile::swapLocalMap ;
+bool Locfile::balancePerRead=false;
+bool Locfile::lazyOpen=false;
+int Locfile::readAdvice=POSIX_FADV_NORMAL;
+size_t Locfile::sparseRead=0;
 std::string Locfile::proxyPrefix="UNSET";
 
 class Locfilesys : public XrdCl::FileSystemPlugIn {
@@ -337,13 +1379,97 @@ public:
 	}
 
 
+	//------------------------------------------------------------------------
+	// Locate of a redirected host's file is answered from the local mount,
+	// with this node as the server holding it. The file is looked up in
+	// the cached listing of its directory.
+	//------------------------------------------------------------------------
 	virtual XRootDStatus Locate( const std::string &path,
 	                             OpenFlags::Flags   flags,
 	                             ResponseHandler   *handler,
 	                             uint16_t           timeout ) {
 		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
 		log->Debug(1,"Locfilesys::Locate");
-		return fs.Locate(orig_url(path),flags,handler,timeout);
+		std::string root=localRoot();
+		if(root.empty() || !LocateCache::instance().enabled()) return fs.Locate(orig_url(path),flags,handler,timeout);
+		std::string lpath=localPath(path);
+		while(lpath.size()>1 && lpath[lpath.size()-1]=='/') lpath.erase(lpath.size()-1);
+		size_t slash=lpath.rfind('/');
+		std::string dir=root+lpath.substr(0,slash==std::string::npos?0:slash);
+		std::string name=slash==std::string::npos?lpath:lpath.substr(slash+1);
+		if(!name.empty()) {
+			bool found=false;
+			if(!LocateCache::instance().lookup(dir,name,found)) {
+				std::shared_ptr<std::vector<LocalEntry> > entries(new std::vector<LocalEntry>());
+				int rc=-1;
+				XRootDStatus st=HealthMonitor::instance().run(root,[dir,entries]() {
+					return listLocal(dir,false,*entries);
+				},std::function<void(int)>(),rc,timeout);
+				if(!st.IsOK()) return Locfile::respond(handler,st);
+				if(rc<0 && errno!=ENOENT && errno!=ENOTDIR)
+					return Locfile::respond(handler,Locfile::osError("locate failed",errno));
+				std::vector<std::string> names;
+				for(auto& e : *entries) {
+					names.push_back(e.name);
+					if(e.name==name) found=true;
+				}
+				LocateCache::instance().store(dir,names);
+			}
+			if(!found) return Locfile::respond(handler,Locfile::osError("locate failed",ENOENT));
+		}
+
+		std::string address=nodeAddress();
+		if(LocateCache::instance().stripeHints() && !name.empty()) {
+			std::string hint;
+			if(!LocateCache::instance().hint(dir,name,hint)) {
+				hint=stripeHint(root,root+lpath,timeout);
+				LocateCache::instance().storeHint(dir,name,hint);
+			}
+			if(!hint.empty()) address+="?"+hint;
+		}
+		bool write=flags & (OpenFlags::Update|OpenFlags::Write|OpenFlags::New|
+		                    OpenFlags::Delete|OpenFlags::Append);
+		LocationInfo* info=new LocationInfo();
+		info->Add(LocationInfo::Location(address,LocationInfo::ServerOnline,
+		                                 write?LocationInfo::ReadWrite:LocationInfo::Read));
+		AnyObject* obj=new AnyObject();
+		obj->Set(info);
+		return Locfile::respond(handler,XRootDStatus(),obj);
+	}
+
+	//------------------------------------------------------------------------
+	// This node as a Locate answer, with the port of the redirected host
+	//------------------------------------------------------------------------
+	std::string nodeAddress() const {
+		static const std::string host=[]() {
+			char name[256];
+			if(gethostname(name,sizeof(name))!=0) return std::string("localhost");
+			name[sizeof(name)-1]=0;
+			return std::string(name);
+		}();
+		std::ostringstream address;
+		address<<host<<":"<<XrdCl::URL(origURL).GetPort();
+		return address.str();
+	}
+
+	//------------------------------------------------------------------------
+	// The stripe layout of a local file as Locate opaque, empty if it has
+	// none
+	//------------------------------------------------------------------------
+	static std::string stripeHint(const std::string& root,const std::string& lpath,uint16_t timeout) {
+		std::shared_ptr<std::string> hint(new std::string());
+		int rc=-1;
+		XRootDStatus st=HealthMonitor::instance().run(root,[lpath,hint]() {
+			int lfd=::open(lpath.c_str(),O_RDONLY|O_CLOEXEC|O_NOATIME);
+			if(lfd<0 && errno==EPERM) lfd=::open(lpath.c_str(),O_RDONLY|O_CLOEXEC);
+			if(lfd<0) return -1;
+			std::shared_ptr<const StripeLayout> l=StripeScheduler::instance().probe(lfd);
+			if(l) *hint=LocateCache::layoutHint(*l);
+			::close(lfd);
+			return 0;
+		},std::function<void(int)>(),rc,timeout);
+		if(!st.IsOK() || rc<0) return std::string();
+		return *hint;
 	}
 
 
@@ -354,7 +1480,251 @@ public:
 
 		XrdCl::Log *log = DefaultEnv::GetLog();
 		log->Debug(1,"Locfilesys::Stat");
-		return fs.Stat(orig_url(path),handler,timeout);
+		std::string root=localRoot();
+		if(root.empty()) return fs.Stat(orig_url(path),handler,timeout);
+		struct stat s;
+		XRootDStatus st=Locfile::statLocal(root,root+localPath(path),-1,timeout,s);
+		if(!st.IsOK()) return Locfile::respond(handler,st);
+		StatInfo* sinfo=Locfile::toStatInfo(s);
+		if(!sinfo) return XRootDStatus(XrdCl::stError,errDataError);
+		AnyObject* obj=new AnyObject();
+		obj->Set(sinfo);
+		return Locfile::respond(handler,XRootDStatus(),obj);
+	}
+
+	//------------------------------------------------------------------------
+	// StatVFS of a redirected host is the space of its local mount
+	//------------------------------------------------------------------------
+	virtual XRootDStatus StatVFS( const std::string &path,
+	                              ResponseHandler   *handler,
+	                              uint16_t           timeout ) {
+		XrdCl::Log *log = DefaultEnv::GetLog();
+		log->Debug(1,"Locfilesys::StatVFS");
+		std::string root=localRoot();
+		if(root.empty()) return fs.StatVFS(orig_url(path),handler,timeout);
+		SpaceUsage usage;
+		XRootDStatus st=SpaceCache::instance().get(root,timeout,usage);
+		if(!st.IsOK()) return Locfile::respond(handler,st);
+		StatInfoVFS* info=new StatInfoVFS();
+		if(!info->ParseServerResponse(SpaceCache::vfsLine(usage).c_str())) {
+			delete info;
+			return Locfile::respond(handler,XRootDStatus(XrdCl::stError,errDataError));
+		}
+		AnyObject* obj=new AnyObject();
+		obj->Set(info);
+		return Locfile::respond(handler,XRootDStatus(),obj);
+	}
+
+	//------------------------------------------------------------------------
+	// Truncate of a redirected host's file is done on the local path
+	//------------------------------------------------------------------------
+	virtual XRootDStatus Truncate( const std::string &path,
+	                               uint64_t           size,
+	                               ResponseHandler   *handler,
+	                               uint16_t           timeout ) {
+		XrdCl::Log *log = DefaultEnv::GetLog();
+		log->Debug(1,"Locfilesys::Truncate");
+		std::string root=localRoot();
+		if(root.empty()) return fs.Truncate(orig_url(path),size,handler,timeout);
+		std::string lpath=root+localPath(path);
+		int rc=-1;
+		XRootDStatus st=HealthMonitor::instance().run(root,[lpath,size]() {
+			return ::truncate(lpath.c_str(),size);
+		},std::function<void(int)>(),rc,timeout);
+		if(!st.IsOK()) return Locfile::respond(handler,st);
+		if(rc<0) return Locfile::respond(handler,Locfile::osError("truncate failed",errno));
+		return Locfile::respond(handler,XRootDStatus());
+	}
+
+	//------------------------------------------------------------------------
+	// Directory listings of a redirected host are read from the local
+	// mount, with Stat the entries are stat'ed relative to the open
+	// directory. Entries that vanish while listing are left out.
+	//------------------------------------------------------------------------
+	struct LocalEntry {
+		std::string name;
+		struct stat sb;
+	};
+	static int listLocal(const std::string& lpath,bool withStat,std::vector<LocalEntry>& out) {
+		DIR* d=opendir(lpath.c_str());
+		if(!d) return -1;
+		int dfd=dirfd(d);
+		errno=0;
+		while(struct dirent* e=readdir(d)) {
+			if(!strcmp(e->d_name,".") || !strcmp(e->d_name,"..")) continue;
+			LocalEntry le;
+			le.name=e->d_name;
+			if(withStat && fstatat(dfd,e->d_name,&le.sb,0)<0) {
+				if(errno==ENOENT) {
+					errno=0;
+					continue;
+				}
+				int err=errno;
+				closedir(d);
+				errno=err;
+				return -1;
+			}
+			out.push_back(le);
+			errno=0;
+		}
+		int err=errno;
+		closedir(d);
+		errno=err;
+		return err?-1:0;
+	}
+
+	virtual XRootDStatus DirList( const std::string   &path,
+	                              DirListFlags::Flags  flags,
+	                              ResponseHandler     *handler,
+	                              uint16_t             timeout ) {
+		XrdCl::Log *log = DefaultEnv::GetLog();
+		log->Debug(1,"Locfilesys::DirList");
+		std::string root=localRoot();
+		if(root.empty()) return fs.DirList(orig_url(path),flags,handler,timeout);
+		std::string lpath=root+localPath(path);
+		bool withStat=flags&DirListFlags::Stat;
+		std::shared_ptr<std::vector<LocalEntry> > entries(new std::vector<LocalEntry>());
+		int rc=-1;
+		XRootDStatus st=HealthMonitor::instance().run(root,[lpath,withStat,entries]() {
+			return listLocal(lpath,withStat,*entries);
+		},std::function<void(int)>(),rc,timeout);
+		if(!st.IsOK()) return Locfile::respond(handler,st);
+		if(rc<0) return Locfile::respond(handler,Locfile::osError("dirlist failed",errno));
+		std::vector<std::string> names;
+		for(auto& e : *entries) names.push_back(e.name);
+		std::string dir=lpath;
+		while(dir.size()>root.size() && dir[dir.size()-1]=='/') dir.erase(dir.size()-1);
+		LocateCache::instance().store(dir,names);
+
+		DirectoryList* list=new DirectoryList();
+		list->SetParentName(localPath(path));
+		std::string host=XrdCl::URL(origURL).GetHostId();
+		for(auto& e : *entries) {
+			StatInfo* sinfo=0;
+			if(withStat && !(sinfo=Locfile::toStatInfo(e.sb))) {
+				delete list;
+				return Locfile::respond(handler,XRootDStatus(XrdCl::stError,errDataError));
+			}
+			list->Add(new DirectoryList::ListEntry(host,e.name,sinfo));
+		}
+		AnyObject* obj=new AnyObject();
+		obj->Set(list);
+		return Locfile::respond(handler,XRootDStatus(),obj);
+	}
+
+	//------------------------------------------------------------------------
+	// "LocalPath" is the path of the file system's URL on the local mount
+	// of a redirected host, copies between two such URLs are done on the
+	// client
+	//------------------------------------------------------------------------
+	virtual bool GetProperty(const std::string &name,std::string &value) const {
+		if(name!="LocalPath") return fs.GetProperty(name,value);
+		std::string root=localRoot();
+		if(root.empty()) return false;
+		std::string path=XrdCl::URL(origURL).GetPath();
+		if(path.empty() || path[0]!='/') path="/"+path;
+		value=root+path;
+		return true;
+	}
+
+	//------------------------------------------------------------------------
+	// The path part of a file system request, which may be a full URL
+	//------------------------------------------------------------------------
+	static std::string localPath(const std::string& f) {
+		if(f.empty() || f[0]=='/') return f;
+		return "/"+XrdCl::URL(f).GetPath();
+	}
+
+	//------------------------------------------------------------------------
+	// The local root of the host this file system talks to, empty if the
+	// host is not redirected or all its mounts are tripped
+	//------------------------------------------------------------------------
+	std::string localRoot() const {
+		std::vector<LocalRoot> roots=Locfile::getLocalRoots(XrdCl::URL(origURL).GetHostName());
+		return roots.empty()?std::string():roots.front().path;
+	}
+
+	//------------------------------------------------------------------------
+	// Staging requests of redirected hosts warm the local page cache
+	//------------------------------------------------------------------------
+	virtual XRootDStatus Prepare( const std::vector<std::string> &fileList,
+	                              PrepareFlags::Flags             flags,
+	                              uint8_t                         priority,
+	                              ResponseHandler                *handler,
+	                              uint16_t                        timeout ) {
+		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
+		log->Debug(1,"Locfilesys::Prepare");
+		std::string root=localRoot();
+		if(root.empty() || !(flags&(PrepareFlags::Stage|PrepareFlags::Fresh))) {
+			std::vector<std::string> remote;
+			for(auto& f : fileList) remote.push_back(orig_url(f));
+			return fs.Prepare(remote,flags,priority,handler,timeout);
+		}
+		std::vector<std::string> local;
+		for(auto& f : fileList) local.push_back(root+localPath(f));
+		std::string id=Stager::instance().stage(local,fileList,flags&PrepareFlags::Fresh);
+		Buffer* buf=new Buffer();
+		buf->FromString(id);
+		AnyObject* obj=new AnyObject();
+		obj->Set(buf);
+		return Locfile::respond(handler,XRootDStatus(),obj);
+	}
+
+	//------------------------------------------------------------------------
+	// Query(Prepare) of a local staging request answers its progress, a
+	// batch stat (Opaque) and the space (Space) of a redirected host are
+	// answered locally, all other queries go to the server
+	//------------------------------------------------------------------------
+	virtual XRootDStatus Query( QueryCode::Code  queryCode,
+	                            const Buffer    &arg,
+	                            ResponseHandler *handler,
+	                            uint16_t         timeout ) {
+		XrdCl::Log *log=XrdCl::DefaultEnv::GetLog();
+		log->Debug(1,"Locfilesys::Query");
+		std::string req=arg.ToString();
+		if(queryCode==QueryCode::Prepare && Stager::isLocal(req)) {
+			std::string status;
+			std::istringstream ids(req);
+			std::string id;
+			while(ids>>id) {
+				std::string one;
+				if(!Stager::instance().status(id,one))
+					return XRootDStatus(XrdCl::stError,XrdCl::errInvalidArgs,0,"unknown prepare request "+id);
+				status+=one;
+			}
+			Buffer* buf=new Buffer();
+			buf->FromString(status);
+			AnyObject* obj=new AnyObject();
+			obj->Set(buf);
+			return Locfile::respond(handler,XRootDStatus(),obj);
+		}
+		if(queryCode==QueryCode::Opaque && BatchStat::isRequest(req)) {
+			std::string root=localRoot();
+			if(!root.empty()) {
+				std::string out;
+				XRootDStatus st=BatchStat::instance().stat(root,req,out,timeout);
+				if(!st.IsOK()) return st;
+				Buffer* buf=new Buffer();
+				buf->FromString(out);
+				AnyObject* obj=new AnyObject();
+				obj->Set(buf);
+				return Locfile::respond(handler,XRootDStatus(),obj);
+			}
+		}
+		if(queryCode==QueryCode::Space) {
+			std::string root=localRoot();
+			if(!root.empty()) {
+				SpaceUsage usage;
+				XRootDStatus st=SpaceCache::instance().get(root,timeout,usage);
+				if(!st.IsOK()) return Locfile::respond(handler,st);
+				Buffer* buf=new Buffer();
+				buf->FromString(SpaceCache::spaceCgi(usage));
+				AnyObject* obj=new AnyObject();
+				obj->Set(buf);
+				return Locfile::respond(handler,XRootDStatus(),obj);
+			}
+		}
+		return fs.Query(queryCode,arg,handler,timeout);
 	}
 };
 
@@ -398,30 +1768,69 @@ void ReadLocalFactory::loadDefaultConf(std::map<std::string,std::string>& config
 	}
 }
 
+void ReadLocalFactory::configure(const std::map<std::string,std::string>& config) {
+	//load config for Fileplugin
+	if(config.find("proxyPrefix")!=config.end())Locfile::Locfile::setProxyPrefix(config.find("proxyPrefix")->second);
+	if(config.find("redirectlocal")!=config.end())Locfile::Locfile::parseIntoLocalMap(config.find("redirectlocal")->second);
+	if(config.find("replicabalance")!=config.end())Locfile::Locfile::setReplicaBalance(config.find("replicabalance")->second);
+	if(config.find("lazyopen")!=config.end())Locfile::Locfile::setLazyOpen(Locfile::Utils::getBool(config,"lazyopen",false));
+	if(config.find("readadvice")!=config.end())Locfile::Locfile::setReadAdvice(config.find("readadvice")->second);
+	if(config.find("sparseread")!=config.end())Locfile::Locfile::setSparseRead(Locfile::Utils::getNumber(config,"sparseread",0));
+	//load config for Filesystemplugin
+	if(config.find("proxyPrefix")!=config.end())Locfile::Locfilesys::setProxyPrefix(config.find("proxyPrefix")->second);
+	//load config for the adaptive router and the mount health monitor
+	Locfile::Router::instance().configure(config);
+	Locfile::HealthMonitor::instance().configure(config);
+	//load config for hedged reads and the block cache
+	Locfile::Hedger::instance().configure(config);
+	Locfile::BlockCache::instance().configure(config);
+	Locfile::ShmCache::instance().configure(config);
+	Locfile::DiskCache::instance().configure(config);
+	Locfile::Stager::instance().configure(config);
+	Locfile::BatchStat::instance().configure(config);
+	Locfile::WriteBehind::instance().configure(config);
+	Locfile::SyncEngine::instance().configure(config);
+	Locfile::StripeScheduler::instance().configure(config);
+	Locfile::LocateCache::instance().configure(config);
+	Locfile::SpaceCache::instance().configure(config);
+	Locfile::ForkGuard::instance().configure(config);
+}
+
 ReadLocalFactory::ReadLocalFactory( const std::map<std::string, std::string> &config ) :
 	XrdCl::PlugInFactory() {
 	XrdCl::Log *log = DefaultEnv::GetLog();
 	log->Debug( 1, "ReadLocalFactory::Constructor" );
 
-	if(config.find("proxyPrefix")!=config.end())Locfile::Locfile::setProxyPrefix(config.find("proxyPrefix")->second);
-
-	if(config.find("redirectlocal")!=config.end())Locfile::Locfile::parseIntoLocalMap(config.find("redirectlocal")->second);
+	configure(config);
 
 	if(config.size()==0) {
 		std::map<std::string,std::string> defaultconfig;
 		log->Debug(1,"config size is zero... This is a default plugin call -> loading default config file @ XrdRedirLocDEFAULTCONF Environment Variable ");
 		loadDefaultConf(defaultconfig);
-		//load config for Fileplugin
-		if(defaultconfig.find("proxyPrefix")!=defaultconfig.end())Locfile::Locfile::setProxyPrefix(defaultconfig.find("proxyPrefix")->second);
-		if(defaultconfig.find("redirectlocal")!=defaultconfig.end())Locfile::Locfile::parseIntoLocalMap(defaultconfig.find("redirectlocal")->second);
-		//load config for Filesystemplugin
-		if(defaultconfig.find("proxyPrefix")!=defaultconfig.end())Locfile::Locfilesys::setProxyPrefix(defaultconfig.find("proxyPrefix")->second);
+		configure(defaultconfig);
 	}
 	Locfile::Locfile::printMaps();
 }
 ReadLocalFactory::~ReadLocalFactory() {
 	XrdCl::Log *log = XrdCl::DefaultEnv::GetLog();
 	log->Debug( 1, "ReadLocalFactory::~ReadLocalFactory" );
+	Locfile::Router::instance().printStats();
+	Locfile::HealthMonitor::instance().printStats();
+	Locfile::HealthMonitor::instance().stop();
+	Locfile::Hedger::instance().printStats();
+	Locfile::ReplicaSelector::instance().printStats();
+	Locfile::BlockCache::instance().printStats();
+	Locfile::ShmCache::instance().printStats();
+	Locfile::DiskCache::instance().printStats();
+	Locfile::Stager::instance().printStats();
+	Locfile::BatchStat::instance().printStats();
+	Locfile::WriteBehind::instance().printStats();
+	Locfile::SyncEngine::instance().printStats();
+	Locfile::StripeScheduler::instance().printStats();
+	Locfile::LocateCache::instance().printStats();
+	Locfile::SpaceCache::instance().printStats();
+	Locfile::ForkGuard::instance().printStats();
+	Locfile::Locfile::printFlightStats();
 }
 
 XrdCl::FilePlugIn * ReadLocalFactory::CreateFile( const std::string &url ) {
@@ -57,6 +57,9 @@ class ReadLocalFactory: public XrdCl::PlugInFactory {
 		// load default config:
 		void loadDefaultConf(std::map<std::string,std::string>& config);
 		//------------------------------------------------------------------------
+		// apply a plug-in config to the file and file system plug-ins
+		void configure(const std::map<std::string,std::string>& config);
+		//------------------------------------------------------------------------
 		
 
 	private:
@@ -0,0 +1,201 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalBatch.hh"
+#include "XrdOpenLocalHealth.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <math.h>
+#include <memory>
+#include <string.h>
+#include <sys/stat.h>
+#include <sstream>
+
+namespace Locfile {
+
+const char* BatchStat::request="xrdopenlocal.stat";
+
+//----------------------------------------------------------------------------
+// One batch, shared by the caller and its workers
+//----------------------------------------------------------------------------
+struct BatchStat::Batch {
+	Batch():end(0),next(0),finished(0),refs(1),cond(0) {}
+	std::string              root;
+	double                   end;     // deadline of the batch, 0 for none
+	std::vector<std::string> paths;
+	std::vector<std::string> results;
+	std::atomic<size_t>      next;
+	size_t                   finished;
+	int                      refs;
+	XrdSysCondVar            cond;
+};
+
+class BatchJob: public XrdCl::Job {
+	public:
+		virtual void Run(void* arg) {
+			BatchStat::Batch* b=static_cast<BatchStat::Batch*>(arg);
+			BatchStat::instance().work(b);
+			{
+				XrdSysMutexHelper lck(BatchStat::instance().mtx);
+				BatchStat::instance().active[b->root]--;
+			}
+			BatchStat::instance().release(b);
+		}
+};
+static BatchJob batchJob;
+
+BatchStat& BatchStat::instance() {
+	static BatchStat batch;
+	return batch;
+}
+
+BatchStat::BatchStat():perMount(8),batches(0),paths(0),pool("XrdOpenLocal stat",32) {
+}
+
+void BatchStat::configure(const std::map<std::string,std::string>& config) {
+	XrdSysMutexHelper lck(mtx);
+	perMount=Utils::getNumber(config,"statpermount",perMount);
+	if(!perMount) perMount=1;
+	if(config.find("statthreads")!=config.end())
+		pool.resize(Utils::getNumber(config,"statthreads",32),0);
+}
+
+bool BatchStat::isRequest(const std::string& arg) {
+	size_t n=strlen(request);
+	return arg.compare(0,n,request)==0 && (arg.size()==n || arg[n]=='\n');
+}
+
+void BatchStat::release(Batch* b) {
+	b->cond.Lock();
+	int refs=--b->refs;
+	b->cond.UnLock();
+	if(refs==0) delete b;
+}
+
+//----------------------------------------------------------------------------
+// Stat the paths not taken yet, each through the health monitor with what
+// is left of the deadline. Past the deadline the batch has expired and the
+// rest of the paths is left alone.
+//----------------------------------------------------------------------------
+void BatchStat::work(Batch* b) {
+	while(true) {
+		uint16_t timeout=0;
+		if(b->end) {
+			double left=b->end-Utils::now();
+			if(left<=0) return;
+			timeout=std::min(ceil(left),65535.0);
+		}
+		size_t i=b->next++;
+		if(i>=b->paths.size()) return;
+		std::shared_ptr<struct stat> sb(new struct stat);
+		std::string path=b->root+b->paths[i];
+		int rc=-1;
+		XrdCl::XRootDStatus st=HealthMonitor::instance().run(b->root,[path,sb]() {
+			return ::stat(path.c_str(),sb.get());
+		},std::function<void(int)>(),rc,timeout);
+		int err=0;
+		if(!st.IsOK()) err=st.code==XrdCl::errOperationExpired?ETIMEDOUT:(st.errNo?st.errNo:EIO);
+		else if(rc<0) err=errno;
+		std::string res;
+		if(!err) res="0 "+Utils::statLine(*sb);
+		else {
+			std::ostringstream out;
+			out<<err;
+			res=out.str();
+		}
+		b->cond.Lock();
+		b->results[i]=res;
+		b->finished++;
+		if(b->finished==b->paths.size()) b->cond.Broadcast();
+		b->cond.UnLock();
+	}
+}
+
+XrdCl::XRootDStatus BatchStat::stat(const std::string& root,const std::string& arg,
+                                    std::string& out,uint16_t timeout) {
+	if(!HealthMonitor::instance().available(root))
+		return XrdCl::XRootDStatus(XrdCl::stError,XrdCl::errOSError,EIO,"local mount "+root+" is tripped");
+	Batch* b=new Batch();
+	b->root=root;
+	std::istringstream in(arg);
+	std::string line;
+	std::getline(in,line); // the request name
+	while(std::getline(in,line)) {
+		if(!line.empty()) b->paths.push_back(line);
+	}
+	b->results.resize(b->paths.size());
+	if(timeout) b->end=Utils::now()+timeout;
+
+	//--------------------------------------------------------------------------
+	// Start as many workers as the mount has room for, the caller works
+	// along so a busy mount still makes progress
+	//--------------------------------------------------------------------------
+	uint32_t workers=0;
+	{
+		XrdSysMutexHelper lck(mtx);
+		batches++;
+		paths+=b->paths.size();
+		uint32_t& a=active[root];
+		if(a<perMount) workers=perMount-a;
+		if(workers>b->paths.size()) workers=b->paths.size();
+		a+=workers;
+	}
+	for(uint32_t i=0; i<workers; ++i) {
+		b->cond.Lock();
+		b->refs++;
+		b->cond.UnLock();
+		if(!pool.queue(&batchJob,b)) {
+			{
+				XrdSysMutexHelper lck(mtx);
+				active[root]--;
+			}
+			release(b);
+		}
+	}
+	work(b);
+
+	bool done=true;
+	b->cond.Lock();
+	while(b->finished<b->paths.size()) {
+		if(!timeout) {
+			b->cond.Wait();
+			continue;
+		}
+		double left=b->end-Utils::now();
+		if(left<=0) {
+			done=false;
+			break;
+		}
+		b->cond.WaitMS(left*1000+1);
+	}
+	b->cond.UnLock();
+	if(!done) {
+		release(b);
+		return XrdCl::XRootDStatus(XrdCl::stError,XrdCl::errOperationExpired,0,"batch stat timed out");
+	}
+	std::string res;
+	for(auto& r : b->results) {
+		res.append(r);
+		res.append("\n");
+	}
+	out.swap(res);
+	release(b);
+	return XrdCl::XRootDStatus();
+}
+
+void BatchStat::printStats() {
+	XrdSysMutexHelper lck(mtx);
+	if(!batches) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"BatchStat: %lu batches, %lu paths",(unsigned long)batches,(unsigned long)paths);
+}
+}
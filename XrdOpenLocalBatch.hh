@@ -0,0 +1,80 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_BATCH_HH___
+#define __XRDREDIRCT_TOLOCAL_BATCH_HH___
+#include "XrdOpenLocalPool.hh"
+#include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Batched stat of local paths
+//
+// Query(Opaque) with an argument of "xrdopenlocal.stat" followed by one
+// path per line stats all paths on a worker pool, with at most
+// "statpermount" lookups in flight per local root, and answers one line
+// per path in the order given: "0 id size flags mtime" (as in a server's
+// stat response) or the errno of a failed lookup. Each lookup runs through
+// the health monitor, bounded by what is left of the batch's timeout.
+//----------------------------------------------------------------------------
+class BatchStat {
+	public:
+		//------------------------------------------------------------------------
+		// The opaque query answered by the batch stat
+		//------------------------------------------------------------------------
+		static const char* request;
+
+		//------------------------------------------------------------------------
+		// The process wide instance
+		//------------------------------------------------------------------------
+		static BatchStat& instance();
+
+		//------------------------------------------------------------------------
+		// Read the options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		//------------------------------------------------------------------------
+		// Whether the query argument is a batch stat request
+		//------------------------------------------------------------------------
+		static bool isRequest(const std::string& arg);
+
+		//------------------------------------------------------------------------
+		// Stat root+path for all paths of the request
+		//
+		// @param root    the local root of the host
+		// @param arg     the query argument
+		// @param out     the response
+		// @param timeout seconds for the whole batch, counted from the call,
+		//                0 for no limit
+		//------------------------------------------------------------------------
+		XrdCl::XRootDStatus stat(const std::string& root,const std::string& arg,
+		                         std::string& out,uint16_t timeout);
+
+		void printStats();
+
+	private:
+		BatchStat();
+		struct Batch;
+		friend class BatchJob;
+		void work(Batch* b);
+		void release(Batch* b);
+
+		std::map<std::string,uint32_t> active;  // workers per local root
+		uint32_t   perMount;
+		uint64_t   batches;
+		uint64_t   paths;
+		WorkerPool pool;
+		XrdSysMutex mtx;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_BATCH_HH___
@@ -0,0 +1,193 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalCache.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <errno.h>
+#include <string.h>
+
+namespace Locfile {
+
+size_t BlockCache::KeyHash::operator()(const Key& k) const {
+	uint64_t h=k.file.ino*0x9E3779B97F4A7C15ULL;
+	h^=k.file.dev+0x632BE59BD9B4E019ULL+(h<<6)+(h>>2);
+	h^=k.file.mtime+(h<<6)+(h>>2);
+	h^=k.block*0xC2B2AE3D27D4EB4FULL+(h<<6)+(h>>2);
+	return h^(h>>29);
+}
+
+BlockCache& BlockCache::instance() {
+	static BlockCache cache;
+	return cache;
+}
+
+BlockCache::BlockCache():enable(false),budget(0),blockSize(256*1024) {
+	ForkGuard::instance().add(this,ForkAware::Lock);
+}
+
+void BlockCache::prepareFork() {
+	for(auto& s : shards) s->cond.Lock();
+}
+
+void BlockCache::parentFork() {
+	for(auto& s : shards) s->cond.UnLock();
+}
+
+void BlockCache::childFork() {
+	for(auto& s : shards) {
+		std::vector<BlockPtr> loading;
+		for(auto& b : s->blocks) {
+			if(!b.second->ready) loading.push_back(b.second);
+		}
+		for(auto& b : loading) remove(*s,b);
+		renew(s->cond);
+	}
+}
+
+void BlockCache::configure(const std::map<std::string,std::string>& config) {
+	if(config.find("blockcache")==config.end()) return;
+	enable=Utils::getBool(config,"blockcache",enable);
+	if(!enable) return;
+	uint64_t total=Utils::getNumber(config,"blockcachesize",512)*1024*1024;
+	blockSize=Utils::getNumber(config,"blockcacheblock",blockSize/1024)*1024;
+	if(blockSize<4096) blockSize=4096;
+	uint32_t n=Utils::getNumber(config,"blockcacheshards",16);
+	//--------------------------------------------------------------------------
+	// Every shard has to hold a few blocks, or CLOCK degenerates to FIFO
+	//--------------------------------------------------------------------------
+	while(n>1 && total/n<4ULL*blockSize) n/=2;
+	if(n==0) n=1;
+	budget=total/n;
+	if(budget<blockSize) budget=blockSize;
+	shards.clear();
+	for(uint32_t i=0; i<n; ++i) {
+		shards.push_back(std::unique_ptr<Shard>(new Shard()));
+		shards.back()->hand=shards.back()->ring.end();
+	}
+}
+
+void BlockCache::remove(Shard& s,const BlockPtr& b) {
+	if(s.hand==b->pos) ++s.hand;
+	s.ring.erase(b->pos);
+	s.blocks.erase(b->key);
+	s.bytes-=b->data.size();
+}
+
+//----------------------------------------------------------------------------
+// CLOCK: blocks referenced since the hand passed them get a second chance,
+// blocks still loading are skipped
+//----------------------------------------------------------------------------
+void BlockCache::evict(Shard& s) {
+	size_t steps=2*s.ring.size();
+	while(s.bytes>budget && steps--) {
+		if(s.hand==s.ring.end()) s.hand=s.ring.begin();
+		BlockPtr b=*s.hand;
+		if(!b->ready) {
+			++s.hand;
+		} else if(b->ref) {
+			b->ref=false;
+			++s.hand;
+		} else {
+			remove(s,b);
+			s.evictions++;
+		}
+	}
+}
+
+BlockCache::BlockPtr BlockCache::get(const Key& key,const Loader& load,int& err) {
+	Shard& s=*shards[KeyHash()(key)%shards.size()];
+	bool joined=false;
+	s.cond.Lock();
+	while(true) {
+		auto it=s.blocks.find(key);
+		if(it==s.blocks.end()) break;
+		BlockPtr b=it->second;
+		if(b->ready) {
+			b->ref=true;
+			if(joined) s.joins++;
+			else s.hits++;
+			s.cond.UnLock();
+			return b;
+		}
+		//----------------------------------------------------------------------
+		// Another reader is loading the block, wait for it. A failed load is
+		// taken out of the map, and the next waiter tries again.
+		//----------------------------------------------------------------------
+		joined=true;
+		s.cond.Wait();
+	}
+	s.misses++;
+	BlockPtr b(new Block(key));
+	s.ring.push_back(b);
+	b->pos=--s.ring.end();
+	s.blocks[key]=b;
+	s.cond.UnLock();
+
+	std::vector<char> data(blockSize);
+	ssize_t r=load(&data[0],blockSize,key.block*blockSize);
+
+	s.cond.Lock();
+	if(r<0) {
+		err=-r;
+		remove(s,b);
+		s.cond.Broadcast();
+		s.cond.UnLock();
+		return BlockPtr();
+	}
+	data.resize(r);
+	data.shrink_to_fit();
+	b->data.swap(data);
+	b->ready=true;
+	s.bytes+=b->data.size();
+	evict(s);
+	s.cond.Broadcast();
+	s.cond.UnLock();
+	return b;
+}
+
+ssize_t BlockCache::read(const FileId& id,uint64_t offset,uint32_t length,char* buffer,
+                         const Loader& load) {
+	Key key;
+	key.file=id;
+	uint32_t done=0;
+	while(done<length) {
+		uint64_t pos=offset+done;
+		key.block=pos/blockSize;
+		int err=0;
+		BlockPtr b=get(key,load,err);
+		if(!b) return -err;
+		uint64_t in=pos-key.block*blockSize;
+		if(in>=b->data.size()) break;
+		uint32_t n=b->data.size()-in;
+		if(n>length-done) n=length-done;
+		memcpy(buffer+done,&b->data[in],n);
+		done+=n;
+		if(b->data.size()<blockSize) break; // end of file
+	}
+	return done;
+}
+
+void BlockCache::printStats() {
+	if(!enable) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	uint64_t hits=0,misses=0,joins=0,evictions=0,bytes=0;
+	for(auto& s : shards) {
+		XrdSysCondVarHelper lck(s->cond);
+		hits+=s->hits;
+		misses+=s->misses;
+		joins+=s->joins;
+		evictions+=s->evictions;
+		bytes+=s->bytes;
+	}
+	log->Debug(1,"BlockCache: %lu hits, %lu misses, %lu waited for a load in flight, %lu evictions, %lu bytes cached",
+	           (unsigned long)hits,(unsigned long)misses,(unsigned long)joins,
+	           (unsigned long)evictions,(unsigned long)bytes);
+}
+}
@@ -0,0 +1,143 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_CACHE_HH___
+#define __XRDREDIRCT_TOLOCAL_CACHE_HH___
+#include "XrdOpenLocalFork.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Identity of a file version: blocks of a file that changed on disk since
+// they were cached are never found again and age out
+//----------------------------------------------------------------------------
+struct FileId {
+	FileId():dev(0),ino(0),mtime(0),size(0) {}
+	static FileId of(const struct stat& s) {
+		FileId id;
+		id.dev=s.st_dev;
+		id.ino=s.st_ino;
+		id.mtime=uint64_t(s.st_mtim.tv_sec)*1000000000ULL+s.st_mtim.tv_nsec;
+		id.size=s.st_size;
+		return id;
+	}
+	bool valid() const {
+		return ino!=0;
+	}
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t mtime;
+	uint64_t size;
+};
+
+//----------------------------------------------------------------------------
+// Process wide block cache for local reads
+//
+// With "blockcache = true" reads of files opened read-only go through a
+// cache of fixed size blocks keyed by (device, inode, version, block), so
+// separate Locfile objects reading the same baskets share one copy. The
+// cache is split into shards, each with its own lock and CLOCK eviction.
+// Concurrent misses on the same block wait for a single load. A child
+// drops the blocks its parent was loading.
+//----------------------------------------------------------------------------
+class BlockCache: public ForkAware {
+	public:
+		//------------------------------------------------------------------------
+		// Fills buf with up to len bytes at offset off, returns the number of
+		// bytes read or -errno
+		//------------------------------------------------------------------------
+		typedef std::function<ssize_t(char* buf,size_t len,uint64_t off)> Loader;
+
+		//------------------------------------------------------------------------
+		// The process wide cache
+		//------------------------------------------------------------------------
+		static BlockCache& instance();
+
+		//------------------------------------------------------------------------
+		// Read the cache options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		bool enabled() const {
+			return enable;
+		}
+
+		//------------------------------------------------------------------------
+		// Read length bytes at offset through the cache, missing blocks are
+		// loaded with load. Returns the number of bytes read or -errno.
+		//------------------------------------------------------------------------
+		ssize_t read(const FileId& id,uint64_t offset,uint32_t length,char* buffer,
+		             const Loader& load);
+
+		//------------------------------------------------------------------------
+		// ForkAware
+		//------------------------------------------------------------------------
+		virtual void prepareFork();
+		virtual void parentFork();
+		virtual void childFork();
+
+		void printStats();
+
+	private:
+		BlockCache();
+		struct Key {
+			FileId   file;
+			uint64_t block;
+			bool operator==(const Key& o) const {
+				return block==o.block && file.ino==o.file.ino && file.dev==o.file.dev &&
+				       file.mtime==o.file.mtime && file.size==o.file.size;
+			}
+		};
+		struct KeyHash {
+			size_t operator()(const Key& k) const;
+		};
+		struct Block;
+		typedef std::shared_ptr<Block> BlockPtr;
+		typedef std::list<BlockPtr> Ring;
+		struct Block {
+			Block(const Key& k):key(k),ready(false),ref(false),err(0) {}
+			Key               key;
+			std::vector<char> data;
+			bool              ready;  // loaded, data may be used
+			bool              ref;    // CLOCK reference bit
+			int               err;    // errno of a failed load
+			Ring::iterator    pos;    // place on the clock
+		};
+		struct Shard {
+			Shard():bytes(0),hits(0),misses(0),joins(0),evictions(0),cond(0) {}
+			std::unordered_map<Key,BlockPtr,KeyHash> blocks;
+			Ring          ring;
+			Ring::iterator hand;
+			uint64_t      bytes;
+			uint64_t      hits;
+			uint64_t      misses;
+			uint64_t      joins;      // misses that waited for a load in flight
+			uint64_t      evictions;
+			XrdSysCondVar cond;
+		};
+
+		BlockPtr get(const Key& key,const Loader& load,int& err);
+		void evict(Shard& s);
+		void remove(Shard& s,const BlockPtr& b);
+
+		bool     enable;
+		uint64_t budget;      // bytes per shard
+		uint32_t blockSize;
+		std::vector<std::unique_ptr<Shard> > shards;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_CACHE_HH___
@@ -0,0 +1,313 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalDiskCache.hh"
+#include "XrdOpenLocalSlots.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+namespace Locfile {
+
+static const uint64_t diskMagic=0x584f4c4449534b31ULL; // "XOLDISK1"
+static const uint32_t diskVersion=1;
+
+static uint64_t fnv(const std::string& s,uint64_t h) {
+	for(size_t i=0; i<s.size(); ++i) {
+		h^=(unsigned char)s[i];
+		h*=0x100000001B3ULL;
+	}
+	return h;
+}
+
+DiskCache& DiskCache::instance() {
+	static DiskCache cache;
+	return cache;
+}
+
+DiskCache::DiskCache():dataFd(-1),header(0),entries(0),hits(0),misses(0),corrupt(0),written(0),lost(0) {
+}
+
+FileId DiskCache::remoteId(const std::string& url,uint64_t size,uint64_t mtime) {
+	FileId id;
+	id.dev=fnv(url,0xCBF29CE484222325ULL);
+	id.ino=fnv(url,0x84222325CBF29CE4ULL)|1;
+	id.size=size;
+	id.mtime=mtime;
+	return id;
+}
+
+uint64_t DiskCache::checksum(const char* buf,size_t len) {
+	uint64_t h=len*0x9E3779B97F4A7C15ULL;
+	size_t i=0;
+	for(; i+8<=len; i+=8) {
+		uint64_t w;
+		memcpy(&w,buf+i,8);
+		h=(h^w)*0xFF51AFD7ED558CCDULL;
+		h^=h>>32;
+	}
+	for(; i<len; ++i) h=(h^(unsigned char)buf[i])*0x100000001B3ULL;
+	return h;
+}
+
+void DiskCache::configure(const std::map<std::string,std::string>& config) {
+	std::string dir=Utils::getString(config,"diskcache","");
+	if(entries || dir.empty()) return;
+	uint64_t bytes=Utils::getNumber(config,"diskcachesize",10240)*1024*1024;
+	uint32_t block=Utils::getNumber(config,"diskcacheblock",1024)*1024;
+	if(block<4096) block=4096;
+	if(!open(dir,bytes,block)) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"DiskCache: using %s, %lu blocks of %u bytes",dir.c_str(),
+	           (unsigned long)header->nSlots,header->blockSize);
+}
+
+bool DiskCache::open(const std::string& dir,uint64_t bytes,uint32_t block) {
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	std::string ipath=dir+"/index";
+	std::string dpath=dir+"/blocks";
+	int ifd=::open(ipath.c_str(),O_RDWR|O_CREAT|O_CLOEXEC,0600);
+	if(ifd<0) {
+		log->Warning(1,"DiskCache: cannot open %s: %s",ipath.c_str(),strerror(errno));
+		return false;
+	}
+	int dfd=::open(dpath.c_str(),O_RDWR|O_CREAT|O_CLOEXEC,0600);
+	if(dfd<0) {
+		log->Warning(1,"DiskCache: cannot open %s: %s",dpath.c_str(),strerror(errno));
+		::close(ifd);
+		return false;
+	}
+	//--------------------------------------------------------------------------
+	// Set up under a lock on the index, the kernel drops it if we die
+	//--------------------------------------------------------------------------
+	while(flock(ifd,LOCK_EX)<0 && errno==EINTR) ;
+	struct stat sb;
+	Header h;
+	memset(&h,0,sizeof(h));
+	bool valid=false;
+	if(fstat(ifd,&sb)==0 && (size_t)sb.st_size>=sizeof(Header) &&
+	   pread(ifd,&h,sizeof(h),0)==sizeof(h) && h.magic==diskMagic) {
+		if(h.version!=diskVersion || (uint64_t)sb.st_size<sizeof(Header)+h.nSlots*sizeof(Entry)) {
+			log->Warning(1,"DiskCache: %s has an incompatible layout, not using the cache",ipath.c_str());
+			::close(ifd);
+			::close(dfd);
+			return false;
+		}
+		valid=true;
+	}
+	if(!valid) {
+		h.magic=0;
+		h.version=diskVersion;
+		h.blockSize=block;
+		h.nSlots=bytes/block;
+		if(h.nSlots<window) h.nSlots=window;
+		if(ftruncate(ifd,0)<0 || ftruncate(ifd,sizeof(Header)+h.nSlots*sizeof(Entry))<0 ||
+		   ftruncate(dfd,h.nSlots*h.blockSize)<0) {
+			log->Warning(1,"DiskCache: cannot size the cache in %s: %s",dir.c_str(),strerror(errno));
+			::close(ifd);
+			::close(dfd);
+			return false;
+		}
+	}
+	size_t len=sizeof(Header)+h.nSlots*sizeof(Entry);
+	void* m=mmap(0,len,PROT_READ|PROT_WRITE,MAP_SHARED,ifd,0);
+	if(m==MAP_FAILED) {
+		log->Warning(1,"DiskCache: cannot map %s: %s",ipath.c_str(),strerror(errno));
+		::close(ifd);
+		::close(dfd);
+		return false;
+	}
+	header=(Header*)m;
+	Entry* table=(Entry*)((char*)m+sizeof(Header));
+	if(!valid) {
+		*header=h;
+		header->magic=diskMagic;
+	} else {
+		for(uint64_t i=0; i<h.nSlots; ++i) {
+			uint64_t seq=table[i].seq.load(std::memory_order_acquire);
+			if(seq&1) SharedSlots::reclaim(table[i],seq);
+		}
+	}
+	flock(ifd,LOCK_UN);
+	::close(ifd);
+	dataFd=dfd;
+	entries=table;
+	return true;
+}
+
+ssize_t DiskCache::lookup(const FileId& id,uint64_t block,uint64_t first,char* buf,bool& pending) {
+	for(uint64_t i=0; i<window; ++i) {
+		uint64_t idx=(first+i)%header->nSlots;
+		Entry& e=entries[idx];
+		uint64_t seq;
+		if(!SharedSlots::readBegin(e,id,block,seq)) continue;
+		if(seq&1) {
+			pending=true;
+			continue;
+		}
+		uint32_t len=e.len.load(std::memory_order_relaxed);
+		uint64_t sum=e.sum.load(std::memory_order_relaxed);
+		if(len>header->blockSize) continue;
+		ssize_t r=pread(dataFd,buf,len,idx*header->blockSize);
+		if(!SharedSlots::readValid(e,seq)) continue; // replaced meanwhile
+		if(r!=(ssize_t)len || checksum(buf,len)!=sum) {
+			//------------------------------------------------------------------
+			// The data did not make it to the disk before a crash, drop it
+			//------------------------------------------------------------------
+			corrupt++;
+			if(e.seq.compare_exchange_strong(seq,seq+1,std::memory_order_acq_rel))
+				SharedSlots::publish(e,seq+1,false);
+			continue;
+		}
+		e.lastUse.store(time(0),std::memory_order_relaxed);
+		return len;
+	}
+	return -1;
+}
+
+int64_t DiskCache::claim(const FileId& id,uint64_t block,uint64_t first,uint64_t& claimed) {
+	//--------------------------------------------------------------------------
+	// Take an empty slot of the window, or the least recently used one
+	//--------------------------------------------------------------------------
+	for(int attempt=0; attempt<3; ++attempt) {
+		int64_t victim=-1;
+		uint64_t oldest=~0ULL;
+		for(uint64_t i=0; i<window; ++i) {
+			uint64_t idx=(first+i)%header->nSlots;
+			Entry& e=entries[idx];
+			uint64_t seq=e.seq.load(std::memory_order_acquire);
+			if((seq&1) && !SharedSlots::reclaim(e,seq)) continue;
+			uint64_t use=e.ino.load(std::memory_order_relaxed)?e.lastUse.load(std::memory_order_relaxed):0;
+			if(use<oldest) {
+				oldest=use;
+				victim=idx;
+			}
+		}
+		if(victim<0) return -1;
+		Entry& e=entries[victim];
+		uint64_t seq=e.seq.load(std::memory_order_acquire);
+		if(seq&1) continue;
+		if(!SharedSlots::acquire(e,seq,id,block,claimed)) continue;
+		return victim;
+	}
+	return -1;
+}
+
+void DiskCache::store(const FileId& id,uint64_t block,const char* buf,uint32_t len) {
+	uint64_t first=SharedSlots::hash(id,block)%header->nSlots;
+	uint32_t blockSize=header->blockSize;
+	uint64_t seq=0;
+	int64_t idx=claim(id,block,first,seq);
+	if(idx<0) return;
+	Entry& e=entries[idx];
+	bool ok=false;
+	if(SharedSlots::owns(e,seq)) {
+		ssize_t w=pwrite(dataFd,buf,len,idx*blockSize);
+		if(w==(ssize_t)len) {
+			e.len.store(len,std::memory_order_relaxed);
+			e.sum.store(checksum(buf,len),std::memory_order_relaxed);
+			e.lastUse.store(time(0),std::memory_order_relaxed);
+			ok=true;
+		}
+	}
+	if(SharedSlots::publish(e,seq,ok)) {
+		if(ok) written+=len;
+	} else lost++;
+}
+
+//----------------------------------------------------------------------------
+// Copy the part of a block falling into the read
+//----------------------------------------------------------------------------
+static void place(uint64_t block,uint32_t blockSize,const char* data,uint32_t len,
+                  uint64_t offset,uint32_t length,char* buffer) {
+	uint64_t start=std::max<uint64_t>(block*blockSize,offset);
+	uint64_t end=std::min<uint64_t>(block*blockSize+len,offset+length);
+	if(end>start) memcpy(buffer+(start-offset),data+(start-block*blockSize),end-start);
+}
+
+ssize_t DiskCache::begin(const FileId& id,uint64_t offset,uint32_t length,char* buffer,Span& span) {
+	span.length=0;
+	span.lens.clear();
+	if(length==0) return 0;
+	uint32_t blockSize=header->blockSize;
+	uint64_t firstBlock=offset/blockSize;
+	uint64_t lastBlock=(offset+length-1)/blockSize;
+	span.lens.assign(lastBlock-firstBlock+1,-1);
+	std::vector<char> buf(blockSize);
+	int64_t lo=-1,hi=-1;
+	for(uint64_t block=firstBlock; block<=lastBlock; ++block) {
+		bool pending=false;
+		ssize_t r=lookup(id,block,SharedSlots::hash(id,block)%header->nSlots,&buf[0],pending);
+		if(r<0) {
+			misses++;
+			if(lo<0) lo=block;
+			hi=block;
+			continue;
+		}
+		hits++;
+		span.lens[block-firstBlock]=r;
+		place(block,blockSize,&buf[0],r,offset,length,buffer);
+		if((uint32_t)r<blockSize) break; // end of file
+	}
+	if(lo<0) return finish(offset,length,span);
+	span.offset=lo*blockSize;
+	span.length=(hi-lo+1)*blockSize;
+	span.data.resize(span.length);
+	return -1;
+}
+
+ssize_t DiskCache::complete(const FileId& id,uint64_t offset,uint32_t length,char* buffer,
+                            Span& span,uint32_t got) {
+	uint32_t blockSize=header->blockSize;
+	uint64_t firstBlock=offset/blockSize;
+	for(uint64_t pos=0; pos<span.length && pos<=got; pos+=blockSize) {
+		uint64_t block=(span.offset+pos)/blockSize;
+		uint32_t len=std::min<uint64_t>(blockSize,got-pos);
+		int64_t& known=span.lens[block-firstBlock];
+		if(known<0) {
+			store(id,block,&span.data[pos],len);
+			place(block,blockSize,&span.data[pos],len,offset,length,buffer);
+			known=len;
+		}
+		if(len<blockSize) break; // end of file
+	}
+	return finish(offset,length,span);
+}
+
+//----------------------------------------------------------------------------
+// The bytes of the read, up to the first short block
+//----------------------------------------------------------------------------
+ssize_t DiskCache::finish(uint64_t offset,uint32_t length,const Span& span) {
+	uint32_t blockSize=header->blockSize;
+	uint64_t firstBlock=offset/blockSize;
+	uint64_t done=0;
+	for(size_t i=0; i<span.lens.size() && span.lens[i]>=0; ++i) {
+		uint64_t start=(firstBlock+i)*blockSize;
+		uint64_t end=std::min<uint64_t>(start+span.lens[i],offset+length);
+		if(end>std::max(start,offset)) done=end-offset;
+		if(span.lens[i]<(int64_t)blockSize) break;
+	}
+	return done;
+}
+
+void DiskCache::printStats() {
+	if(!entries) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"DiskCache: %lu hits, %lu misses, %lu bytes written, %lu corrupt blocks dropped, %lu loads dropped",
+	           (unsigned long)hits.load(),(unsigned long)misses.load(),
+	           (unsigned long)written.load(),(unsigned long)corrupt.load(),(unsigned long)lost.load());
+}
+}
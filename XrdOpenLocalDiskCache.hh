@@ -0,0 +1,125 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_DISKCACHE_HH___
+#define __XRDREDIRCT_TOLOCAL_DISKCACHE_HH___
+#include "XrdOpenLocalCache.hh"
+#include <atomic>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Persistent block cache on a local disk for reads sent to XRootD
+//
+// With "diskcache = <directory>" reads of files opened read-only in
+// Default mode (hosts not in "redirectlocal") are kept in a block file of
+// fixed size in that directory, next to an mmapped index of the blocks.
+// All jobs of the node share both. The index is a table of SharedSlots
+// like the one of the shared memory cache, and the least recently used
+// slot of a window is replaced. Blocks are keyed by the URL and the remote
+// size and mtime, taken from the StatInfo of the opened file, and carry a
+// checksum so blocks lost in a crash are never served.
+//
+// A read is served in two steps, so the caller can fetch what is missing
+// asynchronously: begin() copies the cached blocks and gives the span of
+// blocks to read from the remote file in one request, complete() stores
+// the blocks of that span and copies them out.
+//----------------------------------------------------------------------------
+class DiskCache {
+	public:
+		//------------------------------------------------------------------------
+		// The process wide handle on the cache
+		//------------------------------------------------------------------------
+		static DiskCache& instance();
+
+		//------------------------------------------------------------------------
+		// Read the options from the plug-in config and open (or create) the
+		// cache directory
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		bool enabled() const {
+			return entries!=0;
+		}
+
+		//------------------------------------------------------------------------
+		// The identity of a remote file version
+		//------------------------------------------------------------------------
+		static FileId remoteId(const std::string& url,uint64_t size,uint64_t mtime);
+
+		//------------------------------------------------------------------------
+		// A read in progress: the block aligned span still to be fetched
+		// (length 0 if none) and the buffer to fetch it into
+		//------------------------------------------------------------------------
+		struct Span {
+			Span():offset(0),length(0) {}
+			uint64_t             offset;
+			uint32_t             length;
+			std::vector<char>    data;
+			std::vector<int64_t> lens;  // per block of the read, -1 while missing
+		};
+
+		//------------------------------------------------------------------------
+		// Copy the cached blocks of length bytes at offset into buffer. Returns
+		// the number of bytes read if nothing is missing, else -1 and the span
+		// to fetch. Blocks loaded by another job count as missing.
+		//------------------------------------------------------------------------
+		ssize_t begin(const FileId& id,uint64_t offset,uint32_t length,char* buffer,Span& span);
+
+		//------------------------------------------------------------------------
+		// Store the got bytes fetched into span.data and finish the read begun
+		// with the same arguments. Returns the number of bytes read.
+		//------------------------------------------------------------------------
+		ssize_t complete(const FileId& id,uint64_t offset,uint32_t length,char* buffer,
+		                 Span& span,uint32_t got);
+
+		void printStats();
+
+	private:
+		DiskCache();
+
+		struct Header {
+			uint64_t magic;
+			uint32_t version;
+			uint32_t blockSize;
+			uint64_t nSlots;
+		};
+		struct Entry {
+			std::atomic<uint64_t> seq;      // odd while a writer owns the slot
+			std::atomic<uint64_t> dev;      // two hashes of the URL (remoteId)
+			std::atomic<uint64_t> ino;      // 0 for an empty slot
+			std::atomic<uint64_t> mtime;
+			std::atomic<uint64_t> size;
+			std::atomic<uint64_t> block;
+			std::atomic<uint64_t> lastUse;  // seconds, for the LRU choice
+			std::atomic<uint64_t> sum;      // checksum of the block data
+			std::atomic<uint32_t> len;
+			std::atomic<int32_t>  owner;    // pid of the writer
+		};
+		static const uint64_t window=16;
+
+		bool open(const std::string& dir,uint64_t bytes,uint32_t block);
+		ssize_t lookup(const FileId& id,uint64_t block,uint64_t first,char* buf,bool& pending);
+		int64_t claim(const FileId& id,uint64_t block,uint64_t first,uint64_t& seq);
+		void store(const FileId& id,uint64_t block,const char* buf,uint32_t len);
+		ssize_t finish(uint64_t offset,uint32_t length,const Span& span);
+		static uint64_t checksum(const char* buf,size_t len);
+
+		int      dataFd;
+		Header*  header;
+		Entry*   entries;
+		std::atomic<uint64_t> hits;
+		std::atomic<uint64_t> misses;
+		std::atomic<uint64_t> corrupt;  // blocks failing their checksum
+		std::atomic<uint64_t> written;  // bytes written to the cache
+		std::atomic<uint64_t> lost;     // loads dropped, their slot was taken back
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_DISKCACHE_HH___
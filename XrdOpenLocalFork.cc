@@ -0,0 +1,116 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalFork.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <algorithm>
+#include <pthread.h>
+#include <unistd.h>
+
+namespace Locfile {
+
+static void forkPrepare() {
+	ForkGuard::instance().prepare();
+}
+
+static void forkParent() {
+	ForkGuard::instance().parent();
+}
+
+static void forkChild() {
+	ForkGuard::instance().child();
+}
+
+ForkGuard& ForkGuard::instance() {
+	static ForkGuard* guard=new ForkGuard();
+	return *guard;
+}
+
+ForkGuard::ForkGuard():wait(5),forks(0),busyPools(0) {
+	if(pthread_atfork(forkPrepare,forkParent,forkChild)!=0) {
+		XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+		log->Warning(1,"ForkGuard: unable to register the fork handlers");
+	}
+}
+
+void ForkGuard::configure(const std::map<std::string,std::string>& config) {
+	XrdSysMutexHelper lck(mtx);
+	wait=Utils::getNumber(config,"forkquiesce",wait);
+}
+
+void ForkGuard::add(ForkAware* p,ForkAware::Stage stage) {
+	XrdSysMutexHelper lck(mtx);
+	Participant part;
+	part.part=p;
+	part.stage=stage;
+	parts.push_back(part);
+}
+
+void ForkGuard::remove(ForkAware* p) {
+	XrdSysMutexHelper lck(mtx);
+	for(auto it=parts.begin(); it!=parts.end(); ++it) {
+		if(it->part==p) {
+			parts.erase(it);
+			return;
+		}
+	}
+}
+
+void ForkGuard::busy() {
+	XrdSysMutexHelper lck(mtx);
+	busyPools++;
+}
+
+void ForkGuard::prepare() {
+	std::vector<Participant> order;
+	{
+		XrdSysMutexHelper lck(mtx);
+		order=parts;
+	}
+	std::stable_sort(order.begin(),order.end(),[](const Participant& a,const Participant& b) {
+		return a.stage<b.stage;
+	});
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"ForkGuard: preparing %lu participants for a fork of process %d",
+	           (unsigned long)order.size(),(int)getpid());
+	forking.clear();
+	for(auto& p : order) {
+		p.part->prepareFork();
+		forking.push_back(p.part);
+	}
+	//--------------------------------------------------------------------------
+	// Held across the fork, participants joining meanwhile wait for it
+	//--------------------------------------------------------------------------
+	mtx.Lock();
+	forks++;
+}
+
+void ForkGuard::parent() {
+	mtx.UnLock();
+	for(auto it=forking.rbegin(); it!=forking.rend(); ++it) (*it)->parentFork();
+	forking.clear();
+}
+
+void ForkGuard::child() {
+	mtx.UnLock();
+	for(auto it=forking.rbegin(); it!=forking.rend(); ++it) (*it)->childFork();
+	forking.clear();
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"ForkGuard: process %d starts with fresh plug-in threads",(int)getpid());
+}
+
+void ForkGuard::printStats() {
+	XrdSysMutexHelper lck(mtx);
+	if(!forks) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"ForkGuard: %lu forks, %lu pools still busy at a fork",
+	           (unsigned long)forks,(unsigned long)busyPools);
+}
+}
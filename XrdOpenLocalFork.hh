@@ -0,0 +1,123 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_FORK_HH___
+#define __XRDREDIRCT_TOLOCAL_FORK_HH___
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Part of the plug-in with threads or in-flight state to carry over a fork
+//
+// prepareFork() runs in the parent before the fork and leaves the object
+// locked, parentFork() and childFork() run after it and unlock it. In the
+// child only the thread calling fork() survives, so childFork() forgets the
+// threads and the I/O the parent has in flight.
+//----------------------------------------------------------------------------
+class ForkAware {
+	public:
+		//------------------------------------------------------------------------
+		// The order of the preparation: buffered writes are written out, then
+		// the pools finish their jobs, then the state the jobs use is locked
+		//------------------------------------------------------------------------
+		enum Stage {
+			Flush = 0,
+			Drain = 1,
+			Lock  = 2
+		};
+
+		virtual ~ForkAware() {}
+		virtual void prepareFork() = 0;
+		virtual void parentFork() = 0;
+		virtual void childFork() = 0;
+};
+
+//----------------------------------------------------------------------------
+// Start a condition variable locked by prepareFork() over in the child, the
+// parent's threads waiting on it would stay its waiters for good
+//----------------------------------------------------------------------------
+inline void renew(XrdSysCondVar& cond) {
+	new(&cond) XrdSysCondVar(0);
+}
+
+//----------------------------------------------------------------------------
+// Fork handling of the plug-in engines
+//
+// Registered with pthread_atfork by the plug-in itself, so it runs on every
+// fork, whether or not XRD_RUNFORKHANDLER has the client handle its own
+// objects. It is registered after the client's handlers, so it prepares
+// before the client stops and is released after the client runs again.
+// Before the fork the participants are prepared stage by stage, the pools
+// wait at most "forkquiesce" seconds (default 5) for their jobs, and after
+// it they are released in the reverse order. Pools start new threads on
+// their next job, in the parent and in the child.
+//----------------------------------------------------------------------------
+class ForkGuard {
+	public:
+		//------------------------------------------------------------------------
+		// The process wide guard, never destroyed so participants can leave
+		// it at any time
+		//------------------------------------------------------------------------
+		static ForkGuard& instance();
+
+		//------------------------------------------------------------------------
+		// Read the options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		//------------------------------------------------------------------------
+		// Add a participant, prepared in stage
+		//------------------------------------------------------------------------
+		void add(ForkAware* p,ForkAware::Stage stage);
+
+		//------------------------------------------------------------------------
+		// Remove a participant, from its destructor
+		//------------------------------------------------------------------------
+		void remove(ForkAware* p);
+
+		//------------------------------------------------------------------------
+		// Seconds a pool waits for its jobs before the fork
+		//------------------------------------------------------------------------
+		double quiesce() const {
+			return wait;
+		}
+
+		//------------------------------------------------------------------------
+		// Count a pool that still had jobs running when the fork went ahead
+		//------------------------------------------------------------------------
+		void busy();
+
+		//------------------------------------------------------------------------
+		// The pthread_atfork handlers
+		//------------------------------------------------------------------------
+		void prepare();
+		void parent();
+		void child();
+
+		void printStats();
+
+	private:
+		ForkGuard();
+		struct Participant {
+			ForkAware*       part;
+			ForkAware::Stage stage;
+		};
+
+		double                   wait;
+		std::vector<Participant> parts;
+		std::vector<ForkAware*>  forking;  // prepared, in order
+		uint64_t                 forks;
+		uint64_t                 busyPools;
+		XrdSysMutex              mtx;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_FORK_HH___
@@ -0,0 +1,328 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalHealth.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClPostMaster.hh"
+#include <algorithm>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Locfile {
+
+//----------------------------------------------------------------------------
+// Errors that say something about the mount rather than about the file
+//----------------------------------------------------------------------------
+static bool isMountError(int err) {
+	switch(err) {
+		case EIO:
+		case ESTALE:
+		case ENOTCONN:
+		case EHOSTDOWN:
+		case ETIMEDOUT:
+		case ESHUTDOWN:
+			return true;
+		default:
+			return false;
+	}
+}
+
+class HelperJob: public XrdCl::Job {
+	public:
+		virtual void Run(void* arg) {
+			HealthMonitor::runOp(arg);
+		}
+};
+static HelperJob helperJob;
+
+std::atomic<bool> HealthMonitor::gone(false);
+
+HealthMonitor& HealthMonitor::instance() {
+	static HealthMonitor monitor;
+	return monitor;
+}
+
+HealthMonitor::HealthMonitor():deadline(10),threshold(3),retry(30),interval(10),
+	maxPending(16),helpers(new WorkerPool("XrdOpenLocal metadata",16,256,false)),
+	task(0),registered(false) {
+	ForkGuard::instance().add(this,ForkAware::Lock);
+}
+
+//----------------------------------------------------------------------------
+// The probe task may still be run by the TaskManager after the monitor is
+// destroyed with the other statics, it has to find it gone
+//----------------------------------------------------------------------------
+HealthMonitor::~HealthMonitor() {
+	gone=true;
+	stop();
+	ForkGuard::instance().remove(this);
+}
+
+void HealthMonitor::prepareFork() {
+	mtx.Lock();
+}
+
+void HealthMonitor::parentFork() {
+	mtx.UnLock();
+}
+
+//----------------------------------------------------------------------------
+// The operations and probes in flight stayed with the parent. The probe
+// task stays registered, the TaskManager keeps its tasks over a fork.
+//----------------------------------------------------------------------------
+void HealthMonitor::childFork() {
+	for(auto& m : mounts) {
+		m.second.pending=0;
+		m.second.probing=false;
+	}
+	mtx.UnLock();
+}
+
+void HealthMonitor::configure(const std::map<std::string,std::string>& config) {
+	XrdSysMutexHelper lck(mtx);
+	deadline=Utils::getNumber(config,"healthtimeout",deadline);
+	threshold=Utils::getNumber(config,"healththreshold",threshold);
+	retry=Utils::getNumber(config,"healthretry",retry);
+	interval=Utils::getNumber(config,"healthprobeinterval",interval);
+	maxPending=Utils::getNumber(config,"healthmaxpending",maxPending);
+	if(deadline<=0) deadline=10;
+	if(threshold==0) threshold=1;
+	if(interval<=0) interval=10;
+	if(maxPending==0) maxPending=1;
+	if(config.find("healthhelpers")!=config.end())
+		helpers->resize(Utils::getNumber(config,"healthhelpers",16),256);
+}
+
+void HealthMonitor::addMount(const std::string& root) {
+	XrdSysMutexHelper lck(mtx);
+	mounts[root];
+}
+
+//----------------------------------------------------------------------------
+// The probes are registered on first use, the post master may not be up yet
+// while the plug-in factory is being configured
+//----------------------------------------------------------------------------
+void HealthMonitor::startProbes() {
+	XrdSysMutexHelper lck(mtx);
+	if(registered) return;
+	XrdCl::PostMaster* pm=XrdCl::DefaultEnv::GetPostMaster();
+	if(!pm) return;
+	task=new ProbeTask();
+	pm->GetTaskManager()->RegisterTask(task,time(0)+interval,true);
+	registered=true;
+}
+
+void HealthMonitor::stop() {
+	XrdSysMutexHelper lck(mtx);
+	if(!registered) return;
+	XrdCl::PostMaster* pm=XrdCl::DefaultEnv::GetPostMaster();
+	if(pm) pm->GetTaskManager()->UnregisterTask(task);
+	task=0;
+	registered=false;
+}
+
+bool HealthMonitor::available(const std::string& root) {
+	XrdSysMutexHelper lck(mtx);
+	auto it=mounts.find(root);
+	if(it==mounts.end()) return true;
+	return it->second.state==MountHealth::Closed;
+}
+
+void HealthMonitor::failed(const std::string& root) {
+	XrdSysMutexHelper lck(mtx);
+	failure(mounts[root],root);
+}
+
+void HealthMonitor::failure(MountHealth& h,const std::string& root) {
+	h.failures++;
+	if(h.state==MountHealth::HalfOpen || (h.state==MountHealth::Closed && h.failures>=threshold)) {
+		XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+		log->Warning(1,"HealthMonitor: mount %s is not answering, routing new opens to the remote path",root.c_str());
+		h.state=MountHealth::Open;
+		h.retryAt=Utils::now()+retry;
+	}
+}
+
+void HealthMonitor::finished(const std::string& root,bool ok,bool probe) {
+	XrdSysMutexHelper lck(mtx);
+	MountHealth& h=mounts[root];
+	if(h.pending) h.pending--;
+	if(probe) h.probing=false;
+	if(ok) {
+		if(h.state!=MountHealth::Closed) {
+			XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+			log->Info(1,"HealthMonitor: mount %s recovered",root.c_str());
+		}
+		h.state=MountHealth::Closed;
+		h.failures=0;
+	} else {
+		failure(h,root);
+	}
+}
+
+void* HealthMonitor::runOp(void* arg) {
+	PendingOp* p=static_cast<PendingOp*>(arg);
+	int res=p->op();
+	int err=errno;
+
+	p->cond.Lock();
+	p->result=res;
+	p->err=err;
+	p->done=true;
+	bool abandoned=p->abandoned;
+	p->cond.Signal();
+	p->cond.UnLock();
+
+	if(abandoned && res>=0 && p->cleanup) p->cleanup(res);
+	//--------------------------------------------------------------------------
+	// A late answer still tells us the mount is alive again
+	//--------------------------------------------------------------------------
+	instance().finished(p->root,res>=0 || !isMountError(err),p->probe);
+	instance().release(p);
+	return 0;
+}
+
+void HealthMonitor::release(PendingOp* op) {
+	op->cond.Lock();
+	int refs=--op->refs;
+	op->cond.UnLock();
+	if(refs==0) delete op;
+}
+
+bool HealthMonitor::launch(PendingOp* op) {
+	{
+		XrdSysMutexHelper lck(mtx);
+		MountHealth& h=mounts[op->root];
+		//----------------------------------------------------------------------
+		// One hung mount must not take all helpers from the others
+		//----------------------------------------------------------------------
+		uint32_t limit=std::min<uint32_t>(maxPending,std::max<uint32_t>(helpers->size()/2,1));
+		if(h.pending>=limit) {
+			failure(h,op->root);
+			return false;
+		}
+		h.pending++;
+	}
+	if(!helpers->queue(&helperJob,op)) {
+		XrdSysMutexHelper lck(mtx);
+		mounts[op->root].pending--;
+		return false;
+	}
+	return true;
+}
+
+XrdCl::XRootDStatus HealthMonitor::run(const std::string& root,
+                                       std::function<int()> op,
+                                       std::function<void(int)> cleanup,
+                                       int& result,uint16_t timeout) {
+	startProbes();
+	double limit;
+	{
+		XrdSysMutexHelper lck(mtx);
+		limit=deadline;
+	}
+	if(timeout>0 && timeout<limit) limit=timeout;
+
+	PendingOp* p=new PendingOp();
+	p->root=root;
+	p->op=op;
+	p->cleanup=cleanup;
+	if(!launch(p)) {
+		delete p;
+		return XrdCl::XRootDStatus(XrdCl::stError,XrdCl::errOperationExpired,0,
+		                           "too many operations pending on "+root);
+	}
+
+	double end=Utils::now()+limit;
+	p->cond.Lock();
+	while(!p->done) {
+		double left=end-Utils::now();
+		if(left<=0) break;
+		p->cond.WaitMS(left*1000+1);
+	}
+	bool done=p->done;
+	if(done) {
+		result=p->result;
+		errno=p->err;
+	} else {
+		p->abandoned=true;
+	}
+	p->cond.UnLock();
+
+	if(!done) {
+		XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+		log->Warning(1,"HealthMonitor: metadata operation on %s exceeded %.1fs",root.c_str(),limit);
+		{
+			XrdSysMutexHelper lck(mtx);
+			failure(mounts[root],root);
+		}
+		release(p);
+		return XrdCl::XRootDStatus(XrdCl::stError,XrdCl::errOperationExpired,0,
+		                           "local mount "+root+" did not answer in time");
+	}
+	release(p);
+	return XrdCl::XRootDStatus();
+}
+
+time_t HealthMonitor::probe(time_t now) {
+	std::vector<PendingOp*> probes;
+	time_t next;
+	{
+		XrdSysMutexHelper lck(mtx);
+		next=now+interval;
+		double t=Utils::now();
+		for(auto& m : mounts) {
+			MountHealth& h=m.second;
+			if(h.probing) continue;
+			if(h.state==MountHealth::Open) {
+				if(t<h.retryAt) continue;
+				h.state=MountHealth::HalfOpen;
+			}
+			h.probing=true;
+			PendingOp* p=new PendingOp();
+			p->root=m.first;
+			p->probe=true;
+			std::string root=m.first;
+			p->op=[root]() {
+				struct stat s;
+				return stat(root.c_str(),&s);
+			};
+			probes.push_back(p);
+		}
+	}
+	//--------------------------------------------------------------------------
+	// Probes are fire and forget, their helper threads report back through
+	// finished() so the TaskManager thread never waits on a hung mount
+	//--------------------------------------------------------------------------
+	for(auto p : probes) {
+		p->refs=1;
+		if(!launch(p)) {
+			XrdSysMutexHelper lck(mtx);
+			mounts[p->root].probing=false;
+			delete p;
+		}
+	}
+	return next;
+}
+
+void HealthMonitor::printStats() {
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	XrdSysMutexHelper lck(mtx);
+	for(auto& m : mounts) {
+		const char* st=m.second.state==MountHealth::Closed?"healthy":
+		               (m.second.state==MountHealth::Open?"tripped":"probing");
+		log->Debug(1,"HealthMonitor: mount %s is %s (%u failures, %u pending)",
+		           m.first.c_str(),st,m.second.failures,m.second.pending);
+	}
+}
+}
@@ -0,0 +1,172 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_HEALTH_HH___
+#define __XRDREDIRCT_TOLOCAL_HEALTH_HH___
+#include "XrdOpenLocalFork.hh"
+#include "XrdOpenLocalPool.hh"
+#include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdCl/XrdClTaskManager.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Health of one local mount, a circuit breaker over its metadata operations
+//----------------------------------------------------------------------------
+struct MountHealth {
+	enum State {Closed,Open,HalfOpen};
+	MountHealth():state(Closed),failures(0),pending(0),retryAt(0),probing(false) {}
+	State    state;
+	uint32_t failures;  // consecutive failed or timed out operations
+	uint32_t pending;   // operations still running on helper threads
+	double   retryAt;   // when an open breaker lets a probe through
+	bool     probing;   // a probe of the mount is in flight
+};
+
+//----------------------------------------------------------------------------
+// Per-mount health monitor
+//
+// Metadata operations on a local mount (open, stat) run on a bounded pool
+// of helper threads with a deadline, so a hung mount cannot block the
+// caller. A mount may hold at most half of the helpers. Timeouts and hard
+// errors trip the breaker of the mount, which routes new opens to the
+// proxy/XRootD path until a periodic probe run through the TaskManager
+// sees the mount answering again. A fork does not wait for the helper
+// threads, which may be stuck on a hung mount, and the child does not
+// wait for the calls they run.
+//----------------------------------------------------------------------------
+class HealthMonitor: public ForkAware {
+	public:
+		//------------------------------------------------------------------------
+		// The process wide monitor
+		//------------------------------------------------------------------------
+		static HealthMonitor& instance();
+
+		//------------------------------------------------------------------------
+		// Read the health options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		//------------------------------------------------------------------------
+		// Start watching a local mount
+		//------------------------------------------------------------------------
+		void addMount(const std::string& root);
+
+		//------------------------------------------------------------------------
+		// false if the breaker of the mount is open
+		//------------------------------------------------------------------------
+		bool available(const std::string& root);
+
+		//------------------------------------------------------------------------
+		// Count an I/O error on a mount against its breaker
+		//------------------------------------------------------------------------
+		void failed(const std::string& root);
+
+		//------------------------------------------------------------------------
+		// Run a metadata operation on a helper thread and wait at most the
+		// configured deadline (or timeout seconds, if smaller and non zero).
+		// What op shares with the caller
+		// has to be held by value or shared_ptr: a helper thread may still
+		// run it after the deadline has passed and run() has returned.
+		//
+		// @param op      the operation, returns <0 and sets errno on failure
+		// @param cleanup undoes a successful result that arrived after the
+		//                deadline (e.g. closes a descriptor), may be empty
+		// @param result  the return value of op
+		// @return        stOK if op finished in time (check result/errno),
+		//                errOperationExpired otherwise
+		//------------------------------------------------------------------------
+		XrdCl::XRootDStatus run(const std::string& root,
+		                        std::function<int()> op,
+		                        std::function<void(int)> cleanup,
+		                        int& result,uint16_t timeout);
+
+		//------------------------------------------------------------------------
+		// Run the periodic probes of all mounts, called by the TaskManager
+		//------------------------------------------------------------------------
+		time_t probe(time_t now);
+
+		//------------------------------------------------------------------------
+		// Stop the periodic probes
+		//------------------------------------------------------------------------
+		void stop();
+
+		//------------------------------------------------------------------------
+		// ForkAware
+		//------------------------------------------------------------------------
+		virtual void prepareFork();
+		virtual void parentFork();
+		virtual void childFork();
+
+		void printStats();
+
+	private:
+		HealthMonitor();
+		~HealthMonitor();
+
+		//------------------------------------------------------------------------
+		// Operation handed over to a helper thread
+		//------------------------------------------------------------------------
+		struct PendingOp {
+			PendingOp():result(-1),err(0),done(false),abandoned(false),probe(false),refs(2),cond(0) {}
+			std::string root;
+			std::function<int()> op;
+			std::function<void(int)> cleanup;
+			int  result;
+			int  err;
+			bool done;
+			bool abandoned;
+			bool probe;
+			int  refs;
+			XrdSysCondVar cond;
+		};
+		friend class HelperJob;
+		static void* runOp(void* arg);
+		bool launch(PendingOp* op);
+		void startProbes();
+		void release(PendingOp* op);
+		void finished(const std::string& root,bool ok,bool probe);
+		void failure(MountHealth& h,const std::string& root);
+
+		//------------------------------------------------------------------------
+		// The probe task registered with the TaskManager, which owns it. It
+		// ends itself once the monitor is gone.
+		//------------------------------------------------------------------------
+		class ProbeTask: public XrdCl::Task {
+			public:
+				ProbeTask() {
+					SetName("XrdOpenLocal mount probe");
+				}
+				virtual time_t Run(time_t now) {
+					if(gone) return 0;
+					return HealthMonitor::instance().probe(now);
+				}
+		};
+		static std::atomic<bool> gone;
+
+		std::map<std::string,MountHealth> mounts;
+		double   deadline;     // seconds
+		uint32_t threshold;    // failures that trip the breaker
+		double   retry;        // seconds an open breaker stays open
+		time_t   interval;     // seconds between probes
+		uint32_t maxPending;   // helper threads stuck on one mount before it trips
+		//------------------------------------------------------------------------
+		// Never deleted: joining helpers stuck on a hung mount would hang the
+		// exit of the process
+		//------------------------------------------------------------------------
+		WorkerPool* helpers;
+		ProbeTask*  task;
+		bool     registered;
+		XrdSysMutex mtx;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_HEALTH_HH___
@@ -0,0 +1,348 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalHedge.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <algorithm>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace Locfile {
+
+//----------------------------------------------------------------------------
+// Latency histogram
+//----------------------------------------------------------------------------
+static double bucketBound(int i) {
+	return 1e-5*pow(1.4,i+1);
+}
+
+LatencyHistogram::LatencyHistogram():total(0) {
+	memset(buckets,0,sizeof(buckets));
+}
+
+void LatencyHistogram::add(double seconds) {
+	int i=0;
+	while(i<nBuckets-1 && seconds>bucketBound(i)) ++i;
+	buckets[i]++;
+	total++;
+	//--------------------------------------------------------------------------
+	// Age the histogram so it follows the current state of the mount
+	//--------------------------------------------------------------------------
+	if(total>=4096) {
+		total=0;
+		for(int j=0; j<nBuckets; ++j) {
+			buckets[j]/=2;
+			total+=buckets[j];
+		}
+	}
+}
+
+double LatencyHistogram::percentile(double p) const {
+	if(total==0) return 0;
+	uint64_t rank=ceil(total*p/100.0);
+	uint64_t sum=0;
+	for(int i=0; i<nBuckets; ++i) {
+		sum+=buckets[i];
+		if(sum>=rank) return bucketBound(i);
+	}
+	return bucketBound(nBuckets-1);
+}
+
+//----------------------------------------------------------------------------
+// State shared between the caller, the local job and the remote handler
+//----------------------------------------------------------------------------
+namespace {
+struct HedgeState {
+	HedgeState(int fd,const std::string& t,const XrdCl::ChunkList& c):chunks(c),target(t),
+		total(0),fd(fd),localDone(false),localErr(0),remoteDone(false),
+		refs(1),cond(0) {
+		for(auto& ch : chunks) total+=ch.length;
+		localBuf.resize(total);
+		localGot.resize(chunks.size(),0);
+		remoteGot.resize(chunks.size(),0);
+	}
+	~HedgeState() {
+		if(fd>=0) close(fd);
+	}
+	void release() {
+		cond.Lock();
+		int r=--refs;
+		cond.UnLock();
+		if(r==0) delete this;
+	}
+	XrdCl::ChunkList     chunks;
+	std::string          target;
+	uint64_t             total;
+	std::vector<char>    localBuf;
+	std::vector<char>    remoteBuf;
+	std::vector<uint32_t> localGot;
+	std::vector<uint32_t> remoteGot;
+	int                  fd;
+	bool                 localDone;
+	int                  localErr;
+	bool                 remoteDone;
+	XrdCl::XRootDStatus  remoteSt;
+	int                  refs;
+	XrdSysCondVar        cond;
+};
+
+//----------------------------------------------------------------------------
+// The local side, runs on the hedger's worker pool. It reads into a buffer
+// of its own, so a remote answer never waits for it, and records its
+// latency even when it lost.
+//----------------------------------------------------------------------------
+class LocalReadJob: public XrdCl::Job {
+	public:
+		virtual void Run(void* arg) {
+			HedgeState* s=static_cast<HedgeState*>(arg);
+			double start=Utils::now();
+			int err=0;
+			uint64_t pos=0;
+			for(size_t i=0; i<s->chunks.size() && !err; ++i) {
+				char* buf=&s->localBuf[pos];
+				uint32_t done=0;
+				while(done<s->chunks[i].length) {
+					ssize_t r=pread(s->fd,buf+done,s->chunks[i].length-done,
+					                s->chunks[i].offset+done);
+					if(r<0 && errno==EINTR) continue;
+					if(r<0) {
+						err=errno;
+						break;
+					}
+					if(r==0) break;
+					done+=r;
+				}
+				s->localGot[i]=done;
+				pos+=s->chunks[i].length;
+			}
+			double took=Utils::now()-start;
+			if(!err) Hedger::instance().record(s->target,s->total,took);
+			s->cond.Lock();
+			s->localDone=true;
+			s->localErr=err;
+			s->cond.Broadcast();
+			s->cond.UnLock();
+			s->release();
+		}
+};
+LocalReadJob localReadJob;
+
+//----------------------------------------------------------------------------
+// The remote side, answered by the XrdCl::File opened on the original URL
+//----------------------------------------------------------------------------
+class RemoteReadHandler: public XrdCl::ResponseHandler {
+	public:
+		RemoteReadHandler(HedgeState* s):state(s) {}
+		virtual void HandleResponse(XrdCl::XRootDStatus* status,XrdCl::AnyObject* response) {
+			if(status->IsOK() && response) {
+				XrdCl::ChunkInfo* chunk=0;
+				response->Get(chunk);
+				if(chunk) state->remoteGot[0]=chunk->length;
+				XrdCl::VectorReadInfo* vinfo=0;
+				response->Get(vinfo);
+				if(vinfo) {
+					XrdCl::ChunkList& got=vinfo->GetChunks();
+					for(size_t i=0; i<got.size() && i<state->remoteGot.size(); ++i)
+						state->remoteGot[i]=got[i].length;
+				}
+			}
+			state->cond.Lock();
+			state->remoteDone=true;
+			state->remoteSt=*status;
+			state->cond.Broadcast();
+			state->cond.UnLock();
+			state->release();
+			delete status;
+			delete response;
+			delete this;
+		}
+	private:
+		HedgeState* state;
+};
+}
+
+//----------------------------------------------------------------------------
+// Hedger
+//----------------------------------------------------------------------------
+Hedger& Hedger::instance() {
+	static Hedger hedger;
+	return hedger;
+}
+
+Hedger::Hedger():enable(false),pct(95),minBudget(0.005),maxBudget(1.0),minSamples(32),
+	hedged(0),remoteWins(0),pool("XrdOpenLocal hedge",8,1024) {
+}
+
+void Hedger::configure(const std::map<std::string,std::string>& config) {
+	XrdSysMutexHelper lck(mtx);
+	enable=Utils::getBool(config,"hedge",enable);
+	pct=Utils::getNumber(config,"hedgepercentile",pct);
+	minBudget=Utils::getNumber(config,"hedgemin",minBudget*1000)/1000;
+	maxBudget=Utils::getNumber(config,"hedgemax",maxBudget*1000)/1000;
+	minSamples=Utils::getNumber(config,"hedgesamples",minSamples);
+	if(pct<=0 || pct>100) pct=95;
+	if(maxBudget<minBudget) maxBudget=minBudget;
+	uint32_t threads=Utils::getNumber(config,"hedgethreads",8);
+	pool.resize(threads,threads*128);
+}
+
+int Hedger::sizeClass(uint64_t bytes) {
+	if(bytes<=64*1024) return 0;
+	if(bytes<=1024*1024) return 1;
+	if(bytes<=16*1024*1024) return 2;
+	return 3;
+}
+
+double Hedger::budget(const std::string& target,uint64_t bytes) {
+	XrdSysMutexHelper lck(mtx);
+	const LatencyHistogram& h=latencies[target].cls[sizeClass(bytes)];
+	if(h.count()<minSamples) return maxBudget;
+	double b=h.percentile(pct);
+	if(b<minBudget) b=minBudget;
+	if(b>maxBudget) b=maxBudget;
+	return b;
+}
+
+void Hedger::record(const std::string& target,uint64_t bytes,double seconds) {
+	XrdSysMutexHelper lck(mtx);
+	latencies[target].cls[sizeClass(bytes)].add(seconds);
+}
+
+XrdCl::XRootDStatus Hedger::read(int fd,const std::string& target,
+                                 const XrdCl::ChunkList& chunks,
+                                 RemoteOpener opener,uint16_t timeout,
+                                 std::vector<uint32_t>& got) {
+	int lfd=dup(fd);
+	if(lfd<0) return XrdCl::XRootDStatus(XrdCl::stError,XrdCl::errOSError,errno,strerror(errno));
+	HedgeState* s=new HedgeState(lfd,target,chunks);
+
+	s->refs++;
+	if(!pool.queue(&localReadJob,s)) {
+		//----------------------------------------------------------------------
+		// The pool is saturated, read inline rather than queue up
+		//----------------------------------------------------------------------
+		localReadJob.Run(s);
+	}
+
+	//--------------------------------------------------------------------------
+	// Once half of the budget is gone the remote file is opened, so the hedge
+	// can fire when the budget runs out. An open still in flight then is
+	// polled, the read is hedged as soon as it is done.
+	//--------------------------------------------------------------------------
+	double b=budget(target,s->total);
+	double start=Utils::now();
+	XrdCl::File* remote=0;
+	bool hedge=false;
+	s->cond.Lock();
+	while(!s->localDone) {
+		double t=Utils::now()-start;
+		if(!remote && t>=b/2) {
+			s->cond.UnLock();
+			remote=opener();
+			s->cond.Lock();
+			if(s->localDone) break;
+			t=Utils::now()-start;
+		}
+		if(remote && t>=b) {
+			hedge=true;
+			break;
+		}
+		double next=t<b/2?b/2:remote?b:t+std::max(b/8,0.001);
+		s->cond.WaitMS((next-t)*1000+1);
+	}
+	s->cond.UnLock();
+
+	if(hedge) {
+		XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+		log->Debug(1,"Hedger::read local read on %s over budget, hedging %lu bytes",
+		           target.c_str(),(unsigned long)s->total);
+		{
+			XrdSysMutexHelper lck(mtx);
+			hedged++;
+		}
+		s->remoteBuf.resize(s->total);
+		s->refs++;
+		RemoteReadHandler* h=new RemoteReadHandler(s);
+		XrdCl::XRootDStatus st;
+		if(chunks.size()==1) {
+			st=remote->Read(chunks[0].offset,chunks[0].length,&s->remoteBuf[0],h,timeout);
+		} else {
+			XrdCl::ChunkList rchunks;
+			uint64_t pos=0;
+			for(auto& ch : chunks) {
+				rchunks.push_back(XrdCl::ChunkInfo(ch.offset,ch.length,&s->remoteBuf[pos]));
+				pos+=ch.length;
+			}
+			st=remote->VectorRead(rchunks,0,h,timeout);
+		}
+		if(!st.IsOK()) {
+			delete h;
+			s->cond.Lock();
+			s->remoteDone=true;
+			s->remoteSt=st;
+			s->refs--;
+			s->cond.UnLock();
+		}
+	}
+
+	//--------------------------------------------------------------------------
+	// Wait for the local read, or for a successful remote one
+	//--------------------------------------------------------------------------
+	s->cond.Lock();
+	while(true) {
+		bool remoteOK=s->remoteDone && s->remoteSt.IsOK();
+		bool remotePending=hedge && !s->remoteDone && s->remoteBuf.size();
+		if(remoteOK) break;
+		if(s->localDone && (s->localErr==0 || !remotePending)) break;
+		s->cond.Wait();
+	}
+	bool remoteOK=s->remoteDone && s->remoteSt.IsOK();
+	bool local=s->localDone && (s->localErr==0 || !remoteOK);
+	int localErr=s->localErr;
+	s->cond.UnLock();
+
+	XrdCl::XRootDStatus ret;
+	if(local && localErr) {
+		ret=XrdCl::XRootDStatus(XrdCl::stError,XrdCl::errOSError,localErr,strerror(localErr));
+	} else {
+		const std::vector<char>& buf=local?s->localBuf:s->remoteBuf;
+		const std::vector<uint32_t>& len=local?s->localGot:s->remoteGot;
+		got=len;
+		uint64_t pos=0;
+		for(size_t i=0; i<chunks.size(); ++i) {
+			if(len[i]) memcpy(chunks[i].buffer,&buf[pos],len[i]);
+			pos+=chunks[i].length;
+		}
+		if(!local) {
+			XrdSysMutexHelper lck(mtx);
+			remoteWins++;
+		}
+	}
+	s->release();
+	return ret;
+}
+
+void Hedger::printStats() {
+	if(!enable) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	XrdSysMutexHelper lck(mtx);
+	log->Debug(1,"Hedger: %lu reads hedged, %lu answered by the remote path",
+	           (unsigned long)hedged,(unsigned long)remoteWins);
+	for(auto& l : latencies) {
+		for(int c=0; c<nClasses; ++c) {
+			if(!l.second.cls[c].count()) continue;
+			log->Debug(1,"Hedger: %s size class %d p%.0f latency %.6fs",l.first.c_str(),c,
+			           pct,l.second.cls[c].percentile(pct));
+		}
+	}
+}
+}
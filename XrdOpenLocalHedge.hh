@@ -0,0 +1,112 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_HEDGE_HH___
+#define __XRDREDIRCT_TOLOCAL_HEDGE_HH___
+#include "XrdOpenLocalPool.hh"
+#include "XrdCl/XrdClFile.hh"
+#include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Latency histogram with logarithmic buckets, 10us to ~100s
+//----------------------------------------------------------------------------
+class LatencyHistogram {
+	public:
+		LatencyHistogram();
+		void add(double seconds);
+		//------------------------------------------------------------------------
+		// Upper bound of the bucket holding the given percentile (0-100)
+		//------------------------------------------------------------------------
+		double percentile(double p) const;
+		uint64_t count() const {
+			return total;
+		}
+	private:
+		static const int nBuckets=48;
+		uint64_t buckets[nBuckets];
+		uint64_t total;
+};
+
+//----------------------------------------------------------------------------
+// Hedging of local reads against the XRootD path
+//
+// With "hedge = true" local Read and VectorRead calls run on a worker pool.
+// If one has not finished within a latency budget taken from a percentile
+// of the recent local reads of the same size class, the same ranges are
+// requested from the original XRootD URL and the first answer wins.
+// The local side reads into a buffer of its own, so the caller returns as
+// soon as the remote answer is in.
+//----------------------------------------------------------------------------
+class Hedger {
+	public:
+		//------------------------------------------------------------------------
+		// The process wide hedger
+		//------------------------------------------------------------------------
+		static Hedger& instance();
+
+		//------------------------------------------------------------------------
+		// Read the hedging options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		bool enabled() const {
+			return enable;
+		}
+
+		//------------------------------------------------------------------------
+		// Returns the remote file to hedge against, 0 while it is not open.
+		// Must not block: it may start an asynchronous open, and is called
+		// again while that is in flight.
+		//------------------------------------------------------------------------
+		typedef std::function<XrdCl::File*()> RemoteOpener;
+
+		//------------------------------------------------------------------------
+		// Read the chunks from fd, hedging against the remote file if the local
+		// read runs over budget. Data ends up in the chunk buffers, the number
+		// of bytes read per chunk in got.
+		//------------------------------------------------------------------------
+		XrdCl::XRootDStatus read(int fd,const std::string& target,
+		                         const XrdCl::ChunkList& chunks,
+		                         RemoteOpener opener,uint16_t timeout,
+		                         std::vector<uint32_t>& got);
+
+		//------------------------------------------------------------------------
+		// Add the latency of a local read to the histograms of its target
+		//------------------------------------------------------------------------
+		void record(const std::string& target,uint64_t bytes,double seconds);
+
+		void printStats();
+
+	private:
+		Hedger();
+		double budget(const std::string& target,uint64_t bytes);
+		static int sizeClass(uint64_t bytes);
+
+		static const int nClasses=4;
+		struct Histograms {
+			LatencyHistogram cls[nClasses];
+		};
+		std::map<std::string,Histograms> latencies;
+		bool     enable;
+		double   pct;         // percentile defining the budget
+		double   minBudget;   // seconds
+		double   maxBudget;   // seconds, used until enough samples are in
+		uint64_t minSamples;
+		uint64_t hedged;      // reads sent to the remote path
+		uint64_t remoteWins;  // reads answered by the remote path
+		WorkerPool pool;
+		XrdSysMutex mtx;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_HEDGE_HH___
@@ -0,0 +1,109 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalLocate.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <sstream>
+
+namespace Locfile {
+
+LocateCache& LocateCache::instance() {
+	static LocateCache cache;
+	return cache;
+}
+
+LocateCache::LocateCache():on(false),hints(false),ttl(5),maxDirs(1024),hits(0),misses(0) {
+}
+
+void LocateCache::configure(const std::map<std::string,std::string>& config) {
+	XrdSysMutexHelper lck(mtx);
+	on=Utils::getBool(config,"locatelocal",on);
+	hints=Utils::getBool(config,"locatestripes",hints);
+	ttl=Utils::getNumber(config,"locatettl",ttl);
+	maxDirs=Utils::getNumber(config,"locatedirs",maxDirs);
+	if(!maxDirs) maxDirs=1;
+}
+
+bool LocateCache::fresh(const Listing& l) const {
+	return Utils::now()-l.listed<ttl;
+}
+
+bool LocateCache::lookup(const std::string& dir,const std::string& name,bool& found) {
+	XrdSysMutexHelper lck(mtx);
+	auto it=dirs.find(dir);
+	if(it==dirs.end() || !fresh(it->second)) {
+		misses++;
+		return false;
+	}
+	hits++;
+	found=it->second.names.count(name);
+	return true;
+}
+
+void LocateCache::store(const std::string& dir,const std::vector<std::string>& names) {
+	XrdSysMutexHelper lck(mtx);
+	if(ttl<=0) return;
+	if(!dirs.count(dir) && dirs.size()>=maxDirs) {
+		auto oldest=dirs.begin();
+		for(auto it=dirs.begin(); it!=dirs.end(); ++it) {
+			if(it->second.listed<oldest->second.listed) oldest=it;
+		}
+		dirs.erase(oldest);
+	}
+	Listing& l=dirs[dir];
+	l.listed=Utils::now();
+	l.names=std::set<std::string>(names.begin(),names.end());
+	l.hints.clear();
+}
+
+void LocateCache::invalidate(const std::string& dir) {
+	XrdSysMutexHelper lck(mtx);
+	dirs.erase(dir);
+}
+
+bool LocateCache::hint(const std::string& dir,const std::string& name,std::string& out) {
+	XrdSysMutexHelper lck(mtx);
+	auto it=dirs.find(dir);
+	if(it==dirs.end() || !fresh(it->second)) return false;
+	auto h=it->second.hints.find(name);
+	if(h==it->second.hints.end()) return false;
+	out=h->second;
+	return true;
+}
+
+void LocateCache::storeHint(const std::string& dir,const std::string& name,const std::string& h) {
+	XrdSysMutexHelper lck(mtx);
+	auto it=dirs.find(dir);
+	if(it!=dirs.end()) it->second.hints[name]=h;
+}
+
+std::string LocateCache::layoutHint(const StripeLayout& l) {
+	if(l.comps.empty()) return std::string();
+	std::ostringstream out;
+	out<<"lustre.stripesize="<<l.comps.front().stripeSize<<"&lustre.osts=";
+	std::set<uint32_t> seen;
+	for(auto& c : l.comps) {
+		for(auto ost : c.osts) {
+			if(!seen.insert(ost).second) continue;
+			if(seen.size()>1) out<<",";
+			out<<ost;
+		}
+	}
+	return out.str();
+}
+
+void LocateCache::printStats() {
+	XrdSysMutexHelper lck(mtx);
+	if(!hits && !misses) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"LocateCache: %lu hits, %lu misses, %lu directories",
+	           (unsigned long)hits,(unsigned long)misses,(unsigned long)dirs.size());
+}
+}
@@ -0,0 +1,104 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_LOCATE_HH___
+#define __XRDREDIRCT_TOLOCAL_LOCATE_HH___
+#include "XrdOpenLocalStripe.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Directory listings behind local Locate answers
+//
+// With "locatelocal = true", Locate of a redirected host's file is
+// answered from the local mount, naming this node as the server holding
+// it. Callers that contact the answer would reach this node rather than
+// the data server, so it is off by default. The file is looked up in the
+// listing of its directory, which is kept for "locatettl" seconds, so
+// locating many files of one directory lists it once. At most
+// "locatedirs" directories are kept, the oldest listing goes first. With
+// "locatestripes = true" the answer carries the file's stripe layout,
+// kept with the listing.
+//----------------------------------------------------------------------------
+class LocateCache {
+	public:
+		//------------------------------------------------------------------------
+		// The process wide cache
+		//------------------------------------------------------------------------
+		static LocateCache& instance();
+
+		//------------------------------------------------------------------------
+		// Read the options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		//------------------------------------------------------------------------
+		// Whether Locate is answered locally ("locatelocal", default false)
+		//------------------------------------------------------------------------
+		bool enabled() const {
+			return on;
+		}
+
+		bool stripeHints() const {
+			return hints;
+		}
+
+		//------------------------------------------------------------------------
+		// Whether name is in the cached listing of the directory dir, false
+		// if dir has no fresh listing
+		//------------------------------------------------------------------------
+		bool lookup(const std::string& dir,const std::string& name,bool& found);
+
+		//------------------------------------------------------------------------
+		// Keep the listing of dir
+		//------------------------------------------------------------------------
+		void store(const std::string& dir,const std::vector<std::string>& names);
+
+		//------------------------------------------------------------------------
+		// Drop the listing of dir, after a file was created in it
+		//------------------------------------------------------------------------
+		void invalidate(const std::string& dir);
+
+		//------------------------------------------------------------------------
+		// The stripe hint of name kept with the listing of dir
+		//------------------------------------------------------------------------
+		bool hint(const std::string& dir,const std::string& name,std::string& out);
+		void storeHint(const std::string& dir,const std::string& name,const std::string& h);
+
+		//------------------------------------------------------------------------
+		// The opaque describing a layout: lustre.stripesize of the first
+		// component and lustre.osts, the OSTs in stripe order
+		//------------------------------------------------------------------------
+		static std::string layoutHint(const StripeLayout& l);
+
+		void printStats();
+
+	private:
+		LocateCache();
+		struct Listing {
+			double                            listed;
+			std::set<std::string>             names;
+			std::map<std::string,std::string> hints;
+		};
+		bool fresh(const Listing& l) const;
+
+		bool                          on;
+		bool                          hints;
+		double                        ttl;
+		size_t                        maxDirs;
+		std::map<std::string,Listing> dirs;
+		uint64_t                      hits;
+		uint64_t                      misses;
+		XrdSysMutex                   mtx;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_LOCATE_HH___
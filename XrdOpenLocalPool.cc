@@ -0,0 +1,141 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalPool.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+
+namespace Locfile {
+
+WorkerPool::WorkerPool(const std::string& name,uint32_t workers,uint32_t capacity,bool drain):
+	name(name),nWorkers(workers?workers:1),capacity(capacity),active(0),drain(drain),
+	running(false),stopping(false),cond(0) {
+	ForkGuard::instance().add(this,ForkAware::Drain);
+}
+
+WorkerPool::~WorkerPool() {
+	ForkGuard::instance().remove(this);
+	stop();
+}
+
+void WorkerPool::resize(uint32_t workers,uint32_t cap) {
+	XrdSysCondVarHelper lck(cond);
+	if(running) return;
+	nWorkers=workers?workers:1;
+	capacity=cap;
+}
+
+void* WorkerPool::runWorker(void* arg) {
+	static_cast<WorkerPool*>(arg)->work();
+	return 0;
+}
+
+bool WorkerPool::start() {
+	if(running) return true;
+	stopping=false;
+	for(uint32_t i=0; i<nWorkers; ++i) {
+		pthread_t tid;
+		if(XrdSysThread::Run(&tid,runWorker,this,XRDSYSTHREAD_HOLD,name.c_str())!=0) {
+			XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+			log->Error(1,"WorkerPool %s: unable to start a worker thread",name.c_str());
+			break;
+		}
+		threads.push_back(tid);
+	}
+	running=!threads.empty();
+	return running;
+}
+
+void WorkerPool::work() {
+	while(true) {
+		cond.Lock();
+		while(jobs.empty() && !stopping) cond.Wait();
+		if(jobs.empty()) {
+			cond.UnLock();
+			return;
+		}
+		JobHelper h=jobs.front();
+		jobs.pop_front();
+		active++;
+		cond.Broadcast();
+		cond.UnLock();
+		h.job->Run(h.arg);
+		cond.Lock();
+		active--;
+		if(!active && jobs.empty()) cond.Broadcast();
+		cond.UnLock();
+	}
+}
+
+bool WorkerPool::queue(XrdCl::Job* job,void* arg) {
+	XrdSysCondVarHelper lck(cond);
+	if(!start()) return false;
+	if(capacity && jobs.size()>=capacity) return false;
+	jobs.push_back(JobHelper(job,arg));
+	cond.Broadcast();
+	return true;
+}
+
+bool WorkerPool::queueWait(XrdCl::Job* job,void* arg) {
+	XrdSysCondVarHelper lck(cond);
+	if(!start()) return false;
+	while(capacity && jobs.size()>=capacity && !stopping) cond.Wait();
+	if(stopping) return false;
+	jobs.push_back(JobHelper(job,arg));
+	cond.Broadcast();
+	return true;
+}
+
+void WorkerPool::stop() {
+	std::vector<pthread_t> toJoin;
+	{
+		XrdSysCondVarHelper lck(cond);
+		if(!running) return;
+		stopping=true;
+		cond.Broadcast();
+		toJoin.swap(threads);
+	}
+	for(auto tid : toJoin) XrdSysThread::Join(tid,0);
+	XrdSysCondVarHelper lck(cond);
+	running=false;
+}
+
+void WorkerPool::prepareFork() {
+	double end=Utils::now()+ForkGuard::instance().quiesce();
+	cond.Lock();
+	if(!drain) return;
+	while(!jobs.empty() || active) {
+		double left=end-Utils::now();
+		if(left<=0) break;
+		cond.WaitMS(left*1000+1);
+	}
+	if(!jobs.empty() || active) {
+		XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+		log->Warning(1,"WorkerPool %s: forking with %u jobs running and %lu queued, the child drops them",
+		             name.c_str(),active,(unsigned long)jobs.size());
+		ForkGuard::instance().busy();
+	}
+}
+
+void WorkerPool::parentFork() {
+	cond.UnLock();
+}
+
+void WorkerPool::childFork() {
+	//--------------------------------------------------------------------------
+	// The workers and their jobs stayed with the parent
+	//--------------------------------------------------------------------------
+	threads.clear();
+	jobs.clear();
+	active=0;
+	running=false;
+	stopping=false;
+	renew(cond);
+}
+}
@@ -0,0 +1,102 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_POOL_HH___
+#define __XRDREDIRCT_TOLOCAL_POOL_HH___
+#include "XrdOpenLocalFork.hh"
+#include "XrdCl/XrdClJobManager.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// A bounded pool of worker threads for local I/O
+//
+// Runs XrdCl::Job objects like the XrdCl JobManager does, but on threads of
+// its own, so blocking file system calls never hold up the client's
+// response handling. The threads are started on the first queued job.
+//
+// Before a fork the pool waits for its jobs, unless it was built not to
+// (jobs that may hang on a mount); the child starts with no threads and no
+// jobs, its own are started on its first job.
+//----------------------------------------------------------------------------
+class WorkerPool: public ForkAware {
+	public:
+		//------------------------------------------------------------------------
+		// Constructor
+		//
+		// @param name     name of the threads, for debugging
+		// @param workers  number of threads
+		// @param capacity maximum number of queued jobs, 0 for unbounded
+		// @param drain    whether a fork waits for the jobs
+		//------------------------------------------------------------------------
+		WorkerPool(const std::string& name,uint32_t workers,uint32_t capacity=0,
+		           bool drain=true);
+
+		//------------------------------------------------------------------------
+		// Destructor, stops the workers
+		//------------------------------------------------------------------------
+		~WorkerPool();
+
+		//------------------------------------------------------------------------
+		// Change the number of workers and the capacity, before the first job
+		//------------------------------------------------------------------------
+		void resize(uint32_t workers,uint32_t capacity);
+
+		//------------------------------------------------------------------------
+		// Queue a job, false if the pool is full or cannot be started
+		//------------------------------------------------------------------------
+		bool queue(XrdCl::Job* job,void* arg=0);
+
+		//------------------------------------------------------------------------
+		// Queue a job, waiting for room if the pool is full
+		//------------------------------------------------------------------------
+		bool queueWait(XrdCl::Job* job,void* arg=0);
+
+		//------------------------------------------------------------------------
+		// Stop the workers, queued jobs are run before they exit
+		//------------------------------------------------------------------------
+		void stop();
+
+		uint32_t size() const {
+			return nWorkers;
+		}
+
+		//------------------------------------------------------------------------
+		// ForkAware
+		//------------------------------------------------------------------------
+		virtual void prepareFork();
+		virtual void parentFork();
+		virtual void childFork();
+
+	private:
+		struct JobHelper {
+			JobHelper(XrdCl::Job* j=0,void* a=0):job(j),arg(a) {}
+			XrdCl::Job* job;
+			void*       arg;
+		};
+		static void* runWorker(void* arg);
+		void work();
+		bool start();
+
+		std::string            name;
+		uint32_t               nWorkers;
+		uint32_t               capacity;
+		std::deque<JobHelper>  jobs;
+		std::vector<pthread_t> threads;
+		uint32_t               active;   // jobs being run
+		bool                   drain;
+		bool                   running;
+		bool                   stopping;
+		XrdSysCondVar          cond;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_POOL_HH___
@@ -0,0 +1,178 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalPrepare.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <sstream>
+
+namespace Locfile {
+
+static const char* idPrefix="xrdopenlocal-";
+static const size_t keepRequests=256;
+static const uint64_t stageChunk=16*1024*1024;
+
+class StageJob: public XrdCl::Job {
+	public:
+		virtual void Run(void* arg) {
+			Stager::instance().run(static_cast<Stager::Task*>(arg));
+		}
+};
+static StageJob stageJob;
+
+Stager& Stager::instance() {
+	static Stager stager;
+	return stager;
+}
+
+Stager::Stager():counter(0),readAll(false),staged(0),bytes(0),pool("XrdOpenLocal stage",8) {
+}
+
+void Stager::configure(const std::map<std::string,std::string>& config) {
+	XrdSysMutexHelper lck(mtx);
+	readAll=Utils::getBool(config,"prepareread",readAll);
+	if(config.find("preparethreads")!=config.end())
+		pool.resize(Utils::getNumber(config,"preparethreads",8),0);
+}
+
+bool Stager::isLocal(const std::string& id) {
+	return id.compare(0,strlen(idPrefix),idPrefix)==0;
+}
+
+std::string Stager::stage(const std::vector<std::string>& paths,
+                          const std::vector<std::string>& names,bool read) {
+	std::shared_ptr<Request> req(new Request());
+	{
+		XrdSysMutexHelper lck(mtx);
+		std::ostringstream id;
+		id<<idPrefix<<getpid()<<"-"<<++counter;
+		req->id=id.str();
+		req->read=read || readAll;
+		req->items.resize(paths.size());
+		for(size_t i=0; i<paths.size(); ++i) {
+			req->items[i].path=paths[i];
+			req->items[i].name=i<names.size()?names[i]:paths[i];
+		}
+		req->pending=paths.size();
+		requests[req->id]=req;
+		order.push_back(req->id);
+		//----------------------------------------------------------------------
+		// Forget the oldest finished requests
+		//----------------------------------------------------------------------
+		while(order.size()>keepRequests) {
+			auto it=requests.find(order.front());
+			if(it!=requests.end() && it->second->pending) break;
+			if(it!=requests.end()) requests.erase(it);
+			order.pop_front();
+		}
+	}
+	for(size_t i=0; i<paths.size(); ++i) {
+		Task* t=new Task();
+		t->req=req;
+		t->item=i;
+		if(!pool.queue(&stageJob,t)) run(t);
+	}
+	return req->id;
+}
+
+void Stager::progress(Request& req,size_t item,uint64_t size,uint64_t done) {
+	XrdSysMutexHelper lck(mtx);
+	req.items[item].size=size;
+	bytes+=done-req.items[item].done;
+	req.items[item].done=done;
+}
+
+void Stager::run(Task* task) {
+	std::shared_ptr<Request> req=task->req;
+	size_t item=task->item;
+	delete task;
+	std::string path=req->items[item].path;
+	int err=0;
+	int fd=open(path.c_str(),O_RDONLY|O_CLOEXEC|O_NOATIME);
+	if(fd<0 && errno==EPERM) fd=open(path.c_str(),O_RDONLY|O_CLOEXEC);
+	struct stat sb;
+	if(fd<0 || fstat(fd,&sb)<0) {
+		err=errno;
+	} else if(req->read) {
+		std::vector<char> buf(4*1024*1024);
+		uint64_t done=0;
+		while(done<(uint64_t)sb.st_size) {
+			ssize_t r=pread(fd,&buf[0],buf.size(),done);
+			if(r<0 && errno==EINTR) continue;
+			if(r<0) {
+				err=errno;
+				break;
+			}
+			if(r==0) break;
+			done+=r;
+			progress(*req,item,sb.st_size,done);
+		}
+	} else {
+		posix_fadvise(fd,0,sb.st_size,POSIX_FADV_WILLNEED);
+		for(uint64_t off=0; off<(uint64_t)sb.st_size; off+=stageChunk) {
+			uint64_t len=std::min<uint64_t>(stageChunk,sb.st_size-off);
+			if(readahead(fd,off,len)<0 && errno!=EINVAL) {
+				err=errno;
+				break;
+			}
+			progress(*req,item,sb.st_size,off+len);
+		}
+	}
+	if(fd>=0) close(fd);
+	XrdSysMutexHelper lck(mtx);
+	req->items[item].err=err;
+	req->items[item].finished=true;
+	req->pending--;
+	if(!err) staged++;
+	if(err) {
+		XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+		log->Warning(1,"Stager %s: %s: %s",req->id.c_str(),path.c_str(),strerror(err));
+	}
+}
+
+bool Stager::status(const std::string& id,std::string& out) {
+	XrdSysMutexHelper lck(mtx);
+	auto it=requests.find(id);
+	if(it==requests.end()) return false;
+	const Request& req=*it->second;
+	uint64_t size=0,done=0;
+	size_t failed=0;
+	for(auto& i : req.items) {
+		size+=i.size;
+		done+=i.done;
+		if(i.err) failed++;
+	}
+	std::ostringstream s;
+	s<<req.id<<" "<<(req.items.size()-req.pending)<<"/"<<req.items.size()<<" files "
+	 <<done<<"/"<<size<<" bytes "<<failed<<" failed\n";
+	for(auto& i : req.items) {
+		s<<i.name<<" ";
+		if(!i.finished) s<<"staging "<<i.done<<"/"<<i.size;
+		else if(i.err) s<<"error "<<strerror(i.err);
+		else s<<"online";
+		s<<"\n";
+	}
+	out=s.str();
+	return true;
+}
+
+void Stager::printStats() {
+	XrdSysMutexHelper lck(mtx);
+	if(!counter) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"Stager: %lu requests, %lu files staged, %lu bytes",
+	           (unsigned long)counter,(unsigned long)staged,(unsigned long)bytes);
+}
+}
@@ -0,0 +1,99 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_PREPARE_HH___
+#define __XRDREDIRCT_TOLOCAL_PREPARE_HH___
+#include "XrdOpenLocalPool.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Local Prepare: warms the page cache with the files of a request
+//
+// Every file of a request is a job on a bounded worker pool. A staged file
+// gets posix_fadvise(WILLNEED) and readahead, a "fresh" one (or any with
+// "prepareread = true") is read through, which also works on file systems
+// ignoring the hints. The progress is kept per request and answered to
+// Query(Prepare) with the request id Prepare returned.
+//----------------------------------------------------------------------------
+class Stager {
+	public:
+		//------------------------------------------------------------------------
+		// The process wide stager
+		//------------------------------------------------------------------------
+		static Stager& instance();
+
+		//------------------------------------------------------------------------
+		// Read the options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		//------------------------------------------------------------------------
+		// Start staging the local paths, returns the request id
+		//
+		// @param paths the local paths
+		// @param names the names given by the caller, used in the status
+		// @param read  read the files through instead of advising the kernel
+		//------------------------------------------------------------------------
+		std::string stage(const std::vector<std::string>& paths,
+		                  const std::vector<std::string>& names,bool read);
+
+		//------------------------------------------------------------------------
+		// Whether the id names a request of this stager
+		//------------------------------------------------------------------------
+		static bool isLocal(const std::string& id);
+
+		//------------------------------------------------------------------------
+		// The progress of a request, false if the id is unknown
+		//------------------------------------------------------------------------
+		bool status(const std::string& id,std::string& out);
+
+		void printStats();
+
+	private:
+		Stager();
+		struct Item {
+			Item():size(0),done(0),err(0),finished(false) {}
+			std::string path;
+			std::string name;
+			uint64_t    size;
+			uint64_t    done;
+			int         err;
+			bool        finished;
+		};
+		struct Request {
+			Request():pending(0) {}
+			std::string       id;
+			bool              read;
+			std::vector<Item> items;
+			size_t            pending;
+		};
+		struct Task {
+			std::shared_ptr<Request> req;
+			size_t                   item;
+		};
+		friend class StageJob;
+		void run(Task* task);
+		void progress(Request& req,size_t item,uint64_t size,uint64_t done);
+
+		std::map<std::string,std::shared_ptr<Request> > requests;
+		std::deque<std::string> order;   // request ids, oldest first
+		uint64_t   counter;
+		bool       readAll;
+		uint64_t   staged;               // files staged since start
+		uint64_t   bytes;                // bytes advised or read
+		WorkerPool pool;
+		XrdSysMutex mtx;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_PREPARE_HH___
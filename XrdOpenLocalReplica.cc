@@ -0,0 +1,114 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalReplica.hh"
+#include "XrdOpenLocalHealth.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <algorithm>
+
+namespace Locfile {
+
+ReplicaSelector& ReplicaSelector::instance() {
+	static ReplicaSelector selector;
+	return selector;
+}
+
+ReplicaSelector::ReplicaSelector() {
+	ForkGuard::instance().add(this,ForkAware::Lock);
+}
+
+void ReplicaSelector::prepareFork() {
+	mtx.Lock();
+}
+
+void ReplicaSelector::parentFork() {
+	mtx.UnLock();
+}
+
+void ReplicaSelector::childFork() {
+	for(auto& l : loads) l.second.outstanding=0;
+	mtx.UnLock();
+}
+
+void ReplicaSelector::begin(const std::string& root) {
+	XrdSysMutexHelper lck(mtx);
+	Load& l=loads[root];
+	l.outstanding++;
+	l.total++;
+}
+
+void ReplicaSelector::end(const std::string& root) {
+	XrdSysMutexHelper lck(mtx);
+	Load& l=loads[root];
+	if(l.outstanding) l.outstanding--;
+}
+
+std::vector<std::string> ReplicaSelector::order(const std::vector<LocalRoot>& roots) {
+	struct Candidate {
+		std::string path;
+		bool        available;
+		double      load;
+		size_t      pos;
+		bool operator<(const Candidate& o) const {
+			if(available!=o.available) return available;
+			if(load!=o.load) return load<o.load;
+			return pos<o.pos;
+		}
+	};
+	std::vector<Candidate> cands;
+	for(size_t i=0; i<roots.size(); ++i) {
+		Candidate c;
+		c.path=roots[i].path;
+		c.available=HealthMonitor::instance().available(c.path);
+		c.pos=i;
+		c.load=0;
+		cands.push_back(c);
+	}
+
+	//--------------------------------------------------------------------------
+	// Smooth weighted round-robin over the available roots: each gains its
+	// weight, divided by its outstanding I/O plus one, as credit, the one
+	// with the most credit goes first and pays the credit of all. Idle roots
+	// take turns in proportion to their weights, busy ones lose their turn.
+	//--------------------------------------------------------------------------
+	XrdSysMutexHelper lck(mtx);
+	double sum=0;
+	Candidate* first=0;
+	for(auto& c : cands) {
+		Load& l=loads[c.path];
+		double w=roots[c.pos].weight>0?roots[c.pos].weight:1;
+		c.load=(l.outstanding+1)/w;
+		if(!c.available) continue;
+		double share=w/(l.outstanding+1);
+		l.current+=share;
+		sum+=share;
+		if(!first || l.current>loads[first->path].current) first=&c;
+	}
+	if(first) {
+		loads[first->path].current-=sum;
+		first->load=-1;
+	}
+	std::stable_sort(cands.begin(),cands.end());
+	std::vector<std::string> out;
+	for(auto& c : cands) out.push_back(c.path);
+	return out;
+}
+
+std::string ReplicaSelector::pick(const std::vector<LocalRoot>& roots) {
+	std::vector<std::string> o=order(roots);
+	return o.empty()?std::string():o.front();
+}
+
+void ReplicaSelector::printStats() {
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	XrdSysMutexHelper lck(mtx);
+	for(auto& l : loads)
+		log->Debug(1,"ReplicaSelector: %s served %lu operations",l.first.c_str(),(unsigned long)l.second.total);
+}
+}
@@ -0,0 +1,97 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_REPLICA_HH___
+#define __XRDREDIRCT_TOLOCAL_REPLICA_HH___
+#include "XrdOpenLocalFork.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// A local root a host is mirrored on
+//----------------------------------------------------------------------------
+struct LocalRoot {
+	LocalRoot(const std::string& p="",double w=1):path(p),weight(w) {}
+	std::string path;
+	double      weight;
+};
+
+//----------------------------------------------------------------------------
+// Load balancing between the local roots ("replicas") of a host
+//
+// "redirectlocal" may give several roots per host, each with an optional
+// weight ("host|/lustre/scratch,2|/lustre/project"). The selector takes
+// the available roots (the mount health breaker) in a smooth weighted
+// round-robin, in which outstanding I/O lowers a root's weight; the others
+// follow by outstanding I/O relative to their weight. A child starts with
+// no outstanding I/O.
+//----------------------------------------------------------------------------
+class ReplicaSelector: public ForkAware {
+	public:
+		//------------------------------------------------------------------------
+		// The process wide selector
+		//------------------------------------------------------------------------
+		static ReplicaSelector& instance();
+
+		//------------------------------------------------------------------------
+		// Track outstanding I/O of a root
+		//------------------------------------------------------------------------
+		void begin(const std::string& root);
+		void end(const std::string& root);
+
+		//------------------------------------------------------------------------
+		// The given roots, best candidate first, roots with a tripped mount
+		// last
+		//------------------------------------------------------------------------
+		std::vector<std::string> order(const std::vector<LocalRoot>& roots);
+
+		//------------------------------------------------------------------------
+		// The best root among the given ones
+		//------------------------------------------------------------------------
+		std::string pick(const std::vector<LocalRoot>& roots);
+
+		//------------------------------------------------------------------------
+		// ForkAware
+		//------------------------------------------------------------------------
+		virtual void prepareFork();
+		virtual void parentFork();
+		virtual void childFork();
+
+		void printStats();
+
+	private:
+		ReplicaSelector();
+		struct Load {
+			Load():outstanding(0),total(0),current(0) {}
+			uint32_t outstanding;
+			uint64_t total;
+			double   current;  // credit of the smooth weighted round-robin
+		};
+		std::map<std::string,Load> loads;
+		XrdSysMutex mtx;
+};
+
+//----------------------------------------------------------------------------
+// Scoped outstanding I/O on a root
+//----------------------------------------------------------------------------
+class InFlight {
+	public:
+		InFlight(const std::string& root):root(root) {
+			ReplicaSelector::instance().begin(root);
+		}
+		~InFlight() {
+			ReplicaSelector::instance().end(root);
+		}
+	private:
+		std::string root;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_REPLICA_HH___
@@ -0,0 +1,149 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalRouter.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClUtils.hh"
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+
+namespace Locfile {
+
+Router& Router::instance() {
+	static Router router;
+	return router;
+}
+
+Router::Router():policy(Static),alpha(0.2),hysteresis(0.2),explore(0.05),
+	refBytes(1024*1024),smallIO(64*1024),rng(getpid()) {
+}
+
+void Router::configure(const std::map<std::string,std::string>& config) {
+	XrdSysMutexHelper lck(mtx);
+	std::string pol=Utils::getString(config,"routing","static");
+	policy=(pol=="adaptive")?Adaptive:Static;
+	alpha=Utils::getNumber(config,"routingalpha",alpha);
+	hysteresis=Utils::getNumber(config,"routinghysteresis",hysteresis);
+	explore=Utils::getNumber(config,"routingexplore",explore);
+	refBytes=Utils::getNumber(config,"routingrefbytes",refBytes);
+	if(alpha<=0 || alpha>1) alpha=0.2;
+	if(hysteresis<0) hysteresis=0;
+	if(explore<0) explore=0;
+	if(explore>1) explore=1;
+
+	auto it=config.find("routingpin");
+	if(it!=config.end()) {
+		std::vector<std::string> hosts;
+		XrdCl::Utils::splitString(hosts,it->second,";");
+		pinned.clear();
+		for(auto& h : hosts) if(!h.empty()) pinned.insert(h);
+	}
+}
+
+double Router::scoreLocked(const std::string& target) {
+	auto it=estimates.find(target);
+	if(it==estimates.end()) return -1;
+	const Estimate& e=it->second;
+	if(e.latSamples==0 && e.tpSamples==0) return -1;
+	double t=e.latency;
+	if(e.tpSamples>0 && e.throughput>0) t+=refBytes/e.throughput;
+	return t;
+}
+
+double Router::score(const std::string& target) {
+	XrdSysMutexHelper lck(mtx);
+	return scoreLocked(target);
+}
+
+bool Router::preferLocal(const std::string& host,
+                         const std::string& localTarget,
+                         const std::string& remoteTarget) {
+	if(policy==Static) return true;
+	XrdSysMutexHelper lck(mtx);
+	if(pinned.count(host)) return true;
+
+	auto last=lastChoice.find(host);
+	bool current=(last==lastChoice.end())?true:last->second;
+
+	//--------------------------------------------------------------------------
+	// Switch only if the other backend is faster by more than the hysteresis
+	// margin, a backend without estimates never displaces the current one
+	//--------------------------------------------------------------------------
+	double cur=scoreLocked(current?localTarget:remoteTarget);
+	double oth=scoreLocked(current?remoteTarget:localTarget);
+	bool choice=current;
+	if(oth>=0 && (cur<0 || oth*(1+hysteresis)<cur)) choice=!current;
+	lastChoice[host]=choice;
+
+	//--------------------------------------------------------------------------
+	// Occasionally send an open to the other backend to keep its estimate
+	// fresh, without moving the host over
+	//--------------------------------------------------------------------------
+	std::uniform_real_distribution<double> dist(0.0,1.0);
+	if(explore>0 && dist(rng)<explore) {
+		XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+		log->Debug(1,"Router::preferLocal exploring the other backend for %s",host.c_str());
+		return !choice;
+	}
+	return choice;
+}
+
+void Router::record(const std::string& target,uint64_t bytes,double seconds) {
+	if(policy==Static || seconds<=0) return;
+	XrdSysMutexHelper lck(mtx);
+	Estimate& e=estimates[target];
+	if(bytes<smallIO) {
+		e.latency=e.latSamples?(1-alpha)*e.latency+alpha*seconds:seconds;
+		e.latSamples++;
+	} else {
+		double tp=bytes/seconds;
+		e.throughput=e.tpSamples?(1-alpha)*e.throughput+alpha*tp:tp;
+		e.tpSamples++;
+	}
+}
+
+void Router::printStats() {
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	XrdSysMutexHelper lck(mtx);
+	log->Debug(1,"Router::printStats policy: %s",policy==Adaptive?"adaptive":"static");
+	for(auto& i : estimates) {
+		std::stringstream msg;
+		msg<<"\""<<i.first<<"\" latency: "<<i.second.latency<<"s ("<<i.second.latSamples
+		   <<" samples) throughput: "<<i.second.throughput<<"B/s ("<<i.second.tpSamples<<" samples)";
+		log->Debug(1,msg.str().c_str());
+	}
+}
+
+TimedHandler::TimedHandler(XrdCl::ResponseHandler* handler,const std::string& target,uint64_t bytes):
+	handler(handler),target(target),bytes(bytes),start(Utils::now()) {
+}
+
+void TimedHandler::HandleResponseWithHosts(XrdCl::XRootDStatus* status,
+                                           XrdCl::AnyObject* response,
+                                           XrdCl::HostList* hostList) {
+	if(status->IsOK()) {
+		uint64_t done=bytes;
+		if(response) {
+			XrdCl::ChunkInfo* chunk=0;
+			response->Get(chunk);
+			if(chunk) done=chunk->length;
+		}
+		Router::instance().record(target,done,Utils::now()-start);
+	}
+	if(handler) handler->HandleResponseWithHosts(status,response,hostList);
+	else {
+		delete status;
+		delete response;
+		delete hostList;
+	}
+	delete this;
+}
+}
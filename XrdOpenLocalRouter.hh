@@ -0,0 +1,111 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_ROUTER_HH___
+#define __XRDREDIRCT_TOLOCAL_ROUTER_HH___
+#include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <random>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Adaptive router between a "redirectlocal" target and the XRootD path
+//
+// Keeps exponentially weighted throughput and latency estimates for every
+// backend (a local root or a remote host) and decides per Open which one
+// a mapped host should use. Without "routing = adaptive" in the config the
+// static mapping of "redirectlocal" is used unchanged.
+//----------------------------------------------------------------------------
+class Router {
+	public:
+		enum Policy {Static,Adaptive};
+
+		//------------------------------------------------------------------------
+		// The process wide router
+		//------------------------------------------------------------------------
+		static Router& instance();
+
+		//------------------------------------------------------------------------
+		// Read the routing options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		//------------------------------------------------------------------------
+		// Decide whether a new open on a mapped host should use the local
+		// target (true) or the remote one (false)
+		//------------------------------------------------------------------------
+		bool preferLocal(const std::string& host,
+		                 const std::string& localTarget,
+		                 const std::string& remoteTarget);
+
+		//------------------------------------------------------------------------
+		// Feed a completed operation into the estimates of a backend,
+		// bytes==0 marks a pure latency sample (open, stat)
+		//------------------------------------------------------------------------
+		void record(const std::string& target,uint64_t bytes,double seconds);
+
+		//------------------------------------------------------------------------
+		// Expected time of a reference sized request, <0 if still unknown
+		//------------------------------------------------------------------------
+		double score(const std::string& target);
+
+		bool isAdaptive() const {
+			return policy==Adaptive;
+		}
+
+		void printStats();
+
+	private:
+		Router();
+
+		struct Estimate {
+			Estimate():throughput(0),latency(0),tpSamples(0),latSamples(0) {}
+			double   throughput; // bytes per second
+			double   latency;    // seconds per request
+			uint64_t tpSamples;
+			uint64_t latSamples;
+		};
+		double scoreLocked(const std::string& target);
+
+		///@estimates EWMA estimates per backend (local root or remote host)
+		std::map<std::string,Estimate> estimates;
+		///@lastChoice the current choice per host, used for the hysteresis
+		std::map<std::string,bool> lastChoice;
+		///@pinned hosts that always use the static "redirectlocal" route
+		std::set<std::string> pinned;
+		Policy  policy;
+		double  alpha;
+		double  hysteresis;
+		double  explore;
+		double  refBytes;
+		double  smallIO;
+		std::minstd_rand rng;
+		XrdSysMutex mtx;
+};
+
+//----------------------------------------------------------------------------
+// Response handler wrapper timing a remote operation for the router
+//----------------------------------------------------------------------------
+class TimedHandler: public XrdCl::ResponseHandler {
+	public:
+		TimedHandler(XrdCl::ResponseHandler* handler,const std::string& target,uint64_t bytes);
+
+		virtual void HandleResponseWithHosts(XrdCl::XRootDStatus* status,
+		                                     XrdCl::AnyObject* response,
+		                                     XrdCl::HostList* hostList);
+	private:
+		XrdCl::ResponseHandler* handler;
+		std::string target;
+		uint64_t bytes;
+		double start;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_ROUTER_HH___
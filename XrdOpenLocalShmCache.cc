@@ -0,0 +1,247 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalShmCache.hh"
+#include "XrdOpenLocalSlots.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sstream>
+#include <vector>
+
+namespace Locfile {
+
+static const uint64_t shmMagic=0x584f4c53484d4331ULL; // "XOLSHMC1"
+static const uint32_t shmVersion=1;
+
+ShmCache& ShmCache::instance() {
+	static ShmCache cache;
+	return cache;
+}
+
+ShmCache::ShmCache():base(0),header(0),slots(0),hits(0),misses(0),joins(0),reclaims(0),lost(0) {
+}
+
+void ShmCache::configure(const std::map<std::string,std::string>& config) {
+	if(slots || !Utils::getBool(config,"shmcache",false)) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	if(!std::atomic<uint64_t>().is_lock_free()) {
+		log->Warning(1,"ShmCache: 64 bit atomics are not lock free here, not using the shared cache");
+		return;
+	}
+	//--------------------------------------------------------------------------
+	// One segment per user by default, jobs of other users must not be able
+	// to put data into our reads
+	//--------------------------------------------------------------------------
+	std::ostringstream def;
+	def<<"/xrdopenlocal."<<getuid();
+	std::string nm=Utils::getString(config,"shmcachename",def.str());
+	uint64_t bytes=Utils::getNumber(config,"shmcachesize",1024)*1024*1024;
+	uint32_t block=Utils::getNumber(config,"shmcacheblock",256)*1024;
+	if(block<4096) block=4096;
+	if(!attach(nm,bytes,block)) return;
+	log->Debug(1,"ShmCache: attached to %s, %lu slots of %u bytes",nm.c_str(),
+	           (unsigned long)header->nSlots,header->blockSize);
+}
+
+bool ShmCache::attach(const std::string& nm,uint64_t bytes,uint32_t block) {
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	int fd=shm_open(nm.c_str(),O_RDWR|O_CREAT,0600);
+	if(fd<0) {
+		log->Warning(1,"ShmCache: cannot open %s: %s",nm.c_str(),strerror(errno));
+		return false;
+	}
+	//--------------------------------------------------------------------------
+	// The lock serialises the set up of the segment. The kernel drops it if
+	// the process setting up dies, the next one then starts over.
+	//--------------------------------------------------------------------------
+	while(flock(fd,LOCK_EX)<0 && errno==EINTR) ;
+	struct stat sb;
+	Header h;
+	memset(&h,0,sizeof(h));
+	bool valid=false;
+	if(fstat(fd,&sb)==0 && (size_t)sb.st_size>=sizeof(Header) &&
+	   pread(fd,&h,sizeof(h),0)==sizeof(h) && h.magic==shmMagic) {
+		if(h.version!=shmVersion || (uint64_t)sb.st_size<h.dataOffset+h.nSlots*h.blockSize) {
+			log->Warning(1,"ShmCache: %s has an incompatible layout, not using the shared cache",nm.c_str());
+			close(fd);
+			return false;
+		}
+		valid=true;
+	}
+	if(!valid) {
+		h.magic=0;
+		h.version=shmVersion;
+		h.blockSize=block;
+		h.nSlots=bytes/(block+sizeof(Slot));
+		if(h.nSlots<window) h.nSlots=window;
+		h.dataOffset=(sizeof(Header)+h.nSlots*sizeof(Slot)+4095)&~4095ULL;
+		if(ftruncate(fd,0)<0 || ftruncate(fd,h.dataOffset+h.nSlots*h.blockSize)<0) {
+			log->Warning(1,"ShmCache: cannot size %s: %s",nm.c_str(),strerror(errno));
+			close(fd);
+			return false;
+		}
+	}
+	size_t len=h.dataOffset+h.nSlots*h.blockSize;
+	void* m=mmap(0,len,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	if(m==MAP_FAILED) {
+		log->Warning(1,"ShmCache: cannot map %s: %s",nm.c_str(),strerror(errno));
+		close(fd);
+		return false;
+	}
+	base=(char*)m;
+	header=(Header*)base;
+	Slot* table=(Slot*)(base+sizeof(Header));
+	if(!valid) {
+		*header=h;
+		header->magic=shmMagic;
+	} else {
+		//----------------------------------------------------------------------
+		// Take back the slots of writers that died while holding them
+		//----------------------------------------------------------------------
+		uint64_t stale=0;
+		for(uint64_t i=0; i<h.nSlots; ++i) {
+			uint64_t seq=table[i].seq.load(std::memory_order_acquire);
+			if((seq&1) && reclaim(table[i],seq)) stale++;
+		}
+		if(stale) log->Info(1,"ShmCache: reclaimed %lu slots of dead processes in %s",(unsigned long)stale,nm.c_str());
+	}
+	flock(fd,LOCK_UN);
+	close(fd);
+	name=nm;
+	slots=table;
+	return true;
+}
+
+bool ShmCache::reclaim(Slot& s,uint64_t seq) {
+	if(!SharedSlots::reclaim(s,seq)) return false;
+	reclaims++;
+	return true;
+}
+
+ssize_t ShmCache::lookup(const FileId& id,uint64_t block,uint64_t first,char* buf,bool& pending) {
+	for(uint64_t i=0; i<window; ++i) {
+		uint64_t idx=(first+i)%header->nSlots;
+		Slot& s=slots[idx];
+		uint64_t seq;
+		if(!SharedSlots::readBegin(s,id,block,seq)) continue;
+		if(seq&1) {
+			pending=true;
+			continue;
+		}
+		uint32_t len=s.len.load(std::memory_order_relaxed);
+		if(len>header->blockSize) continue;
+		memcpy(buf,data(idx),len);
+		if(!SharedSlots::readValid(s,seq)) continue; // overwritten meanwhile
+		if(!s.ref.load(std::memory_order_relaxed)) s.ref.store(1,std::memory_order_relaxed);
+		return len;
+	}
+	return -1;
+}
+
+int64_t ShmCache::claim(const FileId& id,uint64_t block,uint64_t first,uint64_t& claimed) {
+	//--------------------------------------------------------------------------
+	// CLOCK within the window: the first pass takes an empty or unreferenced
+	// slot and clears the reference bits it passes, the second takes any
+	//--------------------------------------------------------------------------
+	for(int pass=0; pass<2; ++pass) {
+		for(uint64_t i=0; i<window; ++i) {
+			uint64_t idx=(first+i)%header->nSlots;
+			Slot& s=slots[idx];
+			uint64_t seq=s.seq.load(std::memory_order_acquire);
+			if(seq&1) {
+				if(!reclaim(s,seq)) continue;
+				seq=s.seq.load(std::memory_order_acquire);
+				if(seq&1) continue;
+			}
+			if(pass==0 && s.ino.load(std::memory_order_relaxed) && s.ref.load(std::memory_order_relaxed)) {
+				s.ref.store(0,std::memory_order_relaxed);
+				continue;
+			}
+			if(!SharedSlots::acquire(s,seq,id,block,claimed)) continue;
+			s.ref.store(0,std::memory_order_relaxed);
+			return idx;
+		}
+	}
+	return -1;
+}
+
+ssize_t ShmCache::get(const FileId& id,uint64_t block,char* buf,const BlockCache::Loader& load) {
+	uint64_t first=SharedSlots::hash(id,block)%header->nSlots;
+	uint32_t blockSize=header->blockSize;
+	//--------------------------------------------------------------------------
+	// If another process is loading the block, give it a moment rather than
+	// reading the same data from disk
+	//--------------------------------------------------------------------------
+	double deadline=0;
+	bool waited=false;
+	while(true) {
+		bool pending=false;
+		ssize_t r=lookup(id,block,first,buf,pending);
+		if(r>=0) {
+			if(waited) joins++;
+			else hits++;
+			return r;
+		}
+		if(!pending) break;
+		if(!deadline) deadline=Utils::now()+2;
+		if(Utils::now()>deadline) break;
+		waited=true;
+		usleep(200);
+	}
+	misses++;
+	uint64_t seq=0;
+	int64_t idx=claim(id,block,first,seq);
+	ssize_t r=load(buf,blockSize,block*blockSize);
+	if(idx<0) return r;
+	Slot& s=slots[idx];
+	bool ok=r>=0 && SharedSlots::owns(s,seq);
+	if(ok) {
+		memcpy(data(idx),buf,r);
+		s.len.store(r,std::memory_order_relaxed);
+		s.ref.store(1,std::memory_order_relaxed);
+	}
+	if(!SharedSlots::publish(s,seq,ok)) lost++;
+	return r;
+}
+
+ssize_t ShmCache::read(const FileId& id,uint64_t offset,uint32_t length,char* buffer,
+                       const BlockCache::Loader& load) {
+	uint32_t blockSize=header->blockSize;
+	std::vector<char> buf(blockSize);
+	uint32_t done=0;
+	while(done<length) {
+		uint64_t pos=offset+done;
+		uint64_t block=pos/blockSize;
+		ssize_t r=get(id,block,&buf[0],load);
+		if(r<0) return r;
+		uint64_t in=pos-block*blockSize;
+		if(in>=(uint64_t)r) break;
+		uint32_t n=r-in;
+		if(n>length-done) n=length-done;
+		memcpy(buffer+done,&buf[in],n);
+		done+=n;
+		if((uint32_t)r<blockSize) break; // end of file
+	}
+	return done;
+}
+
+void ShmCache::printStats() {
+	if(!slots) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"ShmCache: %lu hits, %lu misses, %lu loaded by another process, %lu slots reclaimed, %lu loads dropped",
+	           (unsigned long)hits.load(),(unsigned long)misses.load(),(unsigned long)joins.load(),
+	           (unsigned long)reclaims.load(),(unsigned long)lost.load());
+}
+}
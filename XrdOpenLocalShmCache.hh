@@ -0,0 +1,105 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_SHMCACHE_HH___
+#define __XRDREDIRCT_TOLOCAL_SHMCACHE_HH___
+#include "XrdOpenLocalCache.hh"
+#include <atomic>
+#include <stdint.h>
+#include <map>
+#include <string>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Node wide block cache in a POSIX shared memory segment
+//
+// With "shmcache = true" every process loading the plug-in attaches to the
+// same segment, so a block read by one job is served from memory to all
+// others on the node. Only files opened read-only are cached.
+//
+// The segment holds a table of SharedSlots, each caching one block, and is
+// used as a set associative cache. The key includes the file's size and
+// mtime, blocks of a changed file are never found again. A slot left odd
+// by a process that died is reclaimed by the next writer that finds it.
+//----------------------------------------------------------------------------
+class ShmCache {
+	public:
+		//------------------------------------------------------------------------
+		// The process wide handle on the segment
+		//------------------------------------------------------------------------
+		static ShmCache& instance();
+
+		//------------------------------------------------------------------------
+		// Read the options from the plug-in config and attach to (or create)
+		// the segment
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		bool enabled() const {
+			return slots!=0;
+		}
+
+		//------------------------------------------------------------------------
+		// Read length bytes at offset through the segment, missing blocks are
+		// loaded with load. Returns the number of bytes read or -errno.
+		//------------------------------------------------------------------------
+		ssize_t read(const FileId& id,uint64_t offset,uint32_t length,char* buffer,
+		             const BlockCache::Loader& load);
+
+		void printStats();
+
+	private:
+		ShmCache();
+
+		struct Header {
+			uint64_t magic;
+			uint32_t version;
+			uint32_t blockSize;
+			uint64_t nSlots;
+			uint64_t dataOffset;
+		};
+		struct Slot {
+			std::atomic<uint64_t> seq;    // odd while a writer owns the slot
+			std::atomic<uint64_t> dev;
+			std::atomic<uint64_t> ino;    // 0 for an empty slot
+			std::atomic<uint64_t> mtime;
+			std::atomic<uint64_t> size;
+			std::atomic<uint64_t> block;
+			std::atomic<uint32_t> len;
+			std::atomic<uint32_t> ref;    // CLOCK reference bit
+			std::atomic<int32_t>  owner;  // pid of the writer
+			uint32_t              pad;
+		};
+		static const uint64_t window=8;
+
+		bool attach(const std::string& name,uint64_t bytes,uint32_t block);
+		char* data(uint64_t slot) {
+			return base+header->dataOffset+slot*header->blockSize;
+		}
+		//------------------------------------------------------------------------
+		// Copy the block out of a slot, -1 if it is not there (anymore)
+		//------------------------------------------------------------------------
+		ssize_t lookup(const FileId& id,uint64_t block,uint64_t first,char* buf,bool& pending);
+		//------------------------------------------------------------------------
+		// Claim a slot of the window for a new block, -1 if all are busy
+		//------------------------------------------------------------------------
+		int64_t claim(const FileId& id,uint64_t block,uint64_t first,uint64_t& seq);
+		bool reclaim(Slot& s,uint64_t seq);
+		ssize_t get(const FileId& id,uint64_t block,char* buf,const BlockCache::Loader& load);
+
+		std::string name;
+		char*       base;
+		Header*     header;
+		Slot*       slots;
+		std::atomic<uint64_t> hits;
+		std::atomic<uint64_t> misses;
+		std::atomic<uint64_t> joins;     // misses served by another process' load
+		std::atomic<uint64_t> reclaims;  // slots taken back from dead writers
+		std::atomic<uint64_t> lost;      // loads dropped, their slot was taken back
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_SHMCACHE_HH___
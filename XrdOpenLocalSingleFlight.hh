@@ -0,0 +1,149 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_SINGLEFLIGHT_HH___
+#define __XRDREDIRCT_TOLOCAL_SINGLEFLIGHT_HH___
+#include "XrdOpenLocalFork.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <stdint.h>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Collapses concurrent calls for the same key into one
+//
+// The first caller for a key runs the call, callers arriving while it is
+// running wait for it and get the same result. Keys are spread over shards
+// with a lock each, so unrelated keys do not contend. Results are not
+// kept once the call is done. A call that throws throws in every caller.
+// A child forgets the calls its parent runs, its callers run their own.
+//----------------------------------------------------------------------------
+template<typename T>
+class SingleFlight: public ForkAware {
+	public:
+		typedef std::function<std::shared_ptr<T>()> Call;
+
+		SingleFlight(const std::string& name,unsigned nShards=32):name(name),shards(nShards) {
+			ForkGuard::instance().add(this,ForkAware::Lock);
+		}
+
+		~SingleFlight() {
+			ForkGuard::instance().remove(this);
+		}
+
+		//------------------------------------------------------------------------
+		// Run call for key, or wait for the one running already
+		//
+		// @param joined set if the result came from another caller's call
+		//------------------------------------------------------------------------
+		std::shared_ptr<T> run(const std::string& key,const Call& call,bool& joined) {
+			Shard& s=shards[std::hash<std::string>()(key)%shards.size()];
+			std::shared_ptr<Flight> f;
+			s.mtx.Lock();
+			auto it=s.flights.find(key);
+			if(it!=s.flights.end()) {
+				f=it->second;
+				s.joins++;
+				s.mtx.UnLock();
+				f->cond.Lock();
+				while(!f->done) f->cond.Wait();
+				f->cond.UnLock();
+				joined=true;
+				if(f->error) std::rethrow_exception(f->error);
+				return f->result;
+			}
+			f.reset(new Flight());
+			s.flights[key]=f;
+			s.calls++;
+			s.mtx.UnLock();
+
+			std::shared_ptr<T> result;
+			try {
+				result=call();
+			} catch(...) {
+				finish(s,key,f,result,std::current_exception());
+				throw;
+			}
+			finish(s,key,f,result,std::exception_ptr());
+			joined=false;
+			return result;
+		}
+
+		//------------------------------------------------------------------------
+		// ForkAware
+		//------------------------------------------------------------------------
+		virtual void prepareFork() {
+			for(auto& s : shards) s.mtx.Lock();
+		}
+
+		virtual void parentFork() {
+			for(auto& s : shards) s.mtx.UnLock();
+		}
+
+		virtual void childFork() {
+			for(auto& s : shards) {
+				s.flights.clear();
+				s.mtx.UnLock();
+			}
+		}
+
+		void printStats() {
+			uint64_t calls=0,joins=0;
+			for(auto& s : shards) {
+				XrdSysMutexHelper lck(s.mtx);
+				calls+=s.calls;
+				joins+=s.joins;
+			}
+			if(!calls) return;
+			XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+			log->Debug(1,"SingleFlight %s: %lu calls, %lu callers joined a running one",
+			           name.c_str(),(unsigned long)calls,(unsigned long)joins);
+		}
+
+	private:
+		struct Flight {
+			Flight():done(false),cond(0) {}
+			bool               done;
+			std::shared_ptr<T> result;
+			std::exception_ptr error;
+			XrdSysCondVar      cond;
+		};
+		struct Shard {
+			Shard():calls(0),joins(0) {}
+			XrdSysMutex mtx;
+			std::unordered_map<std::string,std::shared_ptr<Flight> > flights;
+			uint64_t    calls;
+			uint64_t    joins;
+		};
+
+		//------------------------------------------------------------------------
+		// Hand the result, or the exception, of a call to its waiters
+		//------------------------------------------------------------------------
+		void finish(Shard& s,const std::string& key,const std::shared_ptr<Flight>& f,
+		            const std::shared_ptr<T>& result,std::exception_ptr error) {
+			s.mtx.Lock();
+			s.flights.erase(key);
+			s.mtx.UnLock();
+			f->cond.Lock();
+			f->result=result;
+			f->error=error;
+			f->done=true;
+			f->cond.Broadcast();
+			f->cond.UnLock();
+		}
+		std::string        name;
+		std::vector<Shard> shards;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_SINGLEFLIGHT_HH___
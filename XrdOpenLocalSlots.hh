@@ -0,0 +1,135 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_SLOTS_HH___
+#define __XRDREDIRCT_TOLOCAL_SLOTS_HH___
+#include "XrdOpenLocalCache.hh"
+#include <atomic>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Slots of the block caches shared between processes (ShmCache, DiskCache)
+//
+// A slot caches one block and can only live in a small window of slots
+// starting at the hash of its key. It is guarded by a sequence number, odd
+// while a writer owns it: readers copy the block and check the number did
+// not change, so lookups never take a lock. The writer's pid is kept in
+// the slot, a slot left odd by a process that died is taken back.
+//
+// A slot type S has the atomic members seq, dev, ino (0 for an empty
+// slot), mtime, size, block, len and owner.
+//----------------------------------------------------------------------------
+namespace SharedSlots {
+	//------------------------------------------------------------------------
+	// The first slot of the window of a block
+	//------------------------------------------------------------------------
+	inline uint64_t hash(const FileId& id,uint64_t block) {
+		uint64_t h=id.ino*0x9E3779B97F4A7C15ULL;
+		h^=id.dev+0x632BE59BD9B4E019ULL+(h<<6)+(h>>2);
+		h^=id.mtime+(h<<6)+(h>>2);
+		h^=block*0xC2B2AE3D27D4EB4FULL+(h<<6)+(h>>2);
+		return h^(h>>29);
+	}
+
+	//------------------------------------------------------------------------
+	// Whether a pid names a live process, pids we may not signal are alive too
+	//------------------------------------------------------------------------
+	inline bool alive(int32_t pid) {
+		return kill(pid,0)==0 || errno!=ESRCH;
+	}
+
+	template<typename S>
+	bool matches(S& s,const FileId& id,uint64_t block) {
+		return s.ino.load(std::memory_order_relaxed)==id.ino &&
+		       s.block.load(std::memory_order_relaxed)==block &&
+		       s.dev.load(std::memory_order_relaxed)==id.dev &&
+		       s.mtime.load(std::memory_order_relaxed)==id.mtime &&
+		       s.size.load(std::memory_order_relaxed)==id.size;
+	}
+
+	//------------------------------------------------------------------------
+	// Take back a slot left odd (seq) by a writer that died. Writers clear
+	// the owner before they release a slot, a slot that is still odd with
+	// the same sequence number belongs to the owner read here.
+	//------------------------------------------------------------------------
+	template<typename S>
+	bool reclaim(S& s,uint64_t seq) {
+		int32_t owner=s.owner.load(std::memory_order_acquire);
+		if(owner==0 || alive(owner)) return false;
+		if(!s.seq.compare_exchange_strong(seq,seq+2,std::memory_order_acq_rel)) return false;
+		s.ino.store(0,std::memory_order_relaxed);
+		s.len.store(0,std::memory_order_relaxed);
+		s.owner.store(0,std::memory_order_relaxed);
+		s.seq.store(seq+3,std::memory_order_release);
+		return true;
+	}
+
+	//------------------------------------------------------------------------
+	// Start reading a slot holding the block: false if it does not, seq is
+	// odd (the block is being loaded) or the number to check afterwards
+	//------------------------------------------------------------------------
+	template<typename S>
+	bool readBegin(S& s,const FileId& id,uint64_t block,uint64_t& seq) {
+		seq=s.seq.load(std::memory_order_acquire);
+		return matches(s,id,block);
+	}
+
+	//------------------------------------------------------------------------
+	// Whether what was read since readBegin is the slot's block
+	//------------------------------------------------------------------------
+	template<typename S>
+	bool readValid(S& s,uint64_t seq) {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return s.seq.load(std::memory_order_relaxed)==seq;
+	}
+
+	//------------------------------------------------------------------------
+	// Own the even slot seq for the block, claimed is the odd number to
+	// publish with
+	//------------------------------------------------------------------------
+	template<typename S>
+	bool acquire(S& s,uint64_t seq,const FileId& id,uint64_t block,uint64_t& claimed) {
+		if(!s.seq.compare_exchange_strong(seq,seq+1,std::memory_order_acq_rel)) return false;
+		s.owner.store(getpid(),std::memory_order_release);
+		s.dev.store(id.dev,std::memory_order_relaxed);
+		s.ino.store(id.ino,std::memory_order_relaxed);
+		s.mtime.store(id.mtime,std::memory_order_relaxed);
+		s.size.store(id.size,std::memory_order_relaxed);
+		s.block.store(block,std::memory_order_relaxed);
+		s.len.store(0,std::memory_order_relaxed);
+		claimed=seq+1;
+		return true;
+	}
+
+	//------------------------------------------------------------------------
+	// Whether an acquired slot is still ours. A process in another pid
+	// namespace looks dead to kill(), its slot may have been taken back.
+	//------------------------------------------------------------------------
+	template<typename S>
+	bool owns(S& s,uint64_t claimed) {
+		return s.seq.load(std::memory_order_acquire)==claimed;
+	}
+
+	//------------------------------------------------------------------------
+	// Release an acquired slot, with the block or emptied if ok is false.
+	// False if the slot was taken back meanwhile, the block is dropped.
+	//------------------------------------------------------------------------
+	template<typename S>
+	bool publish(S& s,uint64_t claimed,bool ok) {
+		if(!owns(s,claimed)) return false;
+		if(!ok) s.ino.store(0,std::memory_order_relaxed);
+		s.owner.store(0,std::memory_order_relaxed);
+		return s.seq.compare_exchange_strong(claimed,claimed+1,std::memory_order_release,
+		                                     std::memory_order_relaxed);
+	}
+}
+}
+#endif // __XRDREDIRCT_TOLOCAL_SLOTS_HH___
@@ -0,0 +1,101 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalSpace.hh"
+#include "XrdOpenLocalHealth.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <errno.h>
+#include <string.h>
+#include <sys/statvfs.h>
+#include <memory>
+#include <sstream>
+
+namespace Locfile {
+
+SpaceCache& SpaceCache::instance() {
+	static SpaceCache cache;
+	return cache;
+}
+
+SpaceCache::SpaceCache():ttl(5),queries(0),statfss(0),flight("statfs") {
+}
+
+void SpaceCache::configure(const std::map<std::string,std::string>& config) {
+	XrdSysMutexHelper lck(mtx);
+	ttl=Utils::getNumber(config,"spacettl",ttl);
+}
+
+XrdCl::XRootDStatus SpaceCache::get(const std::string& root,uint16_t timeout,SpaceUsage& out) {
+	{
+		XrdSysMutexHelper lck(mtx);
+		queries++;
+		auto it=entries.find(root);
+		if(it!=entries.end() && Utils::now()-it->second.taken<ttl) {
+			out=it->second.usage;
+			return XrdCl::XRootDStatus();
+		}
+	}
+
+	bool joined=false;
+	std::shared_ptr<Result> r=flight.run(root,[&]() {
+		std::shared_ptr<Result> res(new Result());
+		std::shared_ptr<struct statvfs> buf(new struct statvfs);
+		int rc=-1;
+		res->st=HealthMonitor::instance().run(root,[root,buf]() {
+			return statvfs(root.c_str(),buf.get());
+		},std::function<void(int)>(),rc,timeout);
+		if(!res->st.IsOK()) return res;
+		if(rc<0) {
+			res->err=errno;
+			return res;
+		}
+		uint64_t frsize=buf->f_frsize?buf->f_frsize:buf->f_bsize;
+		res->usage.total=(uint64_t)buf->f_blocks*frsize;
+		res->usage.free=(uint64_t)buf->f_bavail*frsize;
+		res->usage.used=(uint64_t)(buf->f_blocks-buf->f_bfree)*frsize;
+		XrdSysMutexHelper lck(mtx);
+		statfss++;
+		Entry& e=entries[root];
+		e.taken=Utils::now();
+		e.usage=res->usage;
+		return res;
+	},joined);
+	if(!r->st.IsOK()) return r->st;
+	if(r->err) {
+		std::string msg="statfs failed: ";
+		msg.append(strerror(r->err));
+		return XrdCl::XRootDStatus(XrdCl::stError,XrdCl::errOSError,r->err,msg);
+	}
+	out=r->usage;
+	return XrdCl::XRootDStatus();
+}
+
+std::string SpaceCache::vfsLine(const SpaceUsage& u) {
+	uint64_t util=u.total?(u.used*100+u.total-1)/u.total:0;
+	std::ostringstream line;
+	line<<1<<" "<<(u.free>>20)<<" "<<util<<" 0 0 0";
+	return line.str();
+}
+
+std::string SpaceCache::spaceCgi(const SpaceUsage& u) {
+	std::ostringstream cgi;
+	cgi<<"oss.cgroup=default&oss.space="<<u.total<<"&oss.free="<<u.free
+	   <<"&oss.maxf="<<u.free<<"&oss.used="<<u.used<<"&oss.quota=-1";
+	return cgi.str();
+}
+
+void SpaceCache::printStats() {
+	XrdSysMutexHelper lck(mtx);
+	if(!queries) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"SpaceCache: %lu queries, %lu statfs",(unsigned long)queries,(unsigned long)statfss);
+	flight.printStats();
+}
+}
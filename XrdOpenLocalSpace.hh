@@ -0,0 +1,83 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_SPACE_HH___
+#define __XRDREDIRCT_TOLOCAL_SPACE_HH___
+#include "XrdOpenLocalSingleFlight.hh"
+#include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <map>
+#include <string>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Space of a local mount, in bytes
+//----------------------------------------------------------------------------
+struct SpaceUsage {
+	SpaceUsage():total(0),free(0),used(0) {}
+	uint64_t total;
+	uint64_t free;   // available to unprivileged users
+	uint64_t used;
+};
+
+//----------------------------------------------------------------------------
+// statfs of the local roots, shared by all file systems of the process
+//
+// StatVFS and space queries of a redirected host are answered from a
+// statfs of its local root that is at most "spacettl" seconds (default 5)
+// old. Concurrent queries of a root whose answer is stale share one statfs,
+// which runs through the health monitor like every other call on a mount.
+//----------------------------------------------------------------------------
+class SpaceCache {
+	public:
+		//------------------------------------------------------------------------
+		// The process wide cache
+		//------------------------------------------------------------------------
+		static SpaceCache& instance();
+
+		//------------------------------------------------------------------------
+		// Read the options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		//------------------------------------------------------------------------
+		// The space of the file system root is on
+		//------------------------------------------------------------------------
+		XrdCl::XRootDStatus get(const std::string& root,uint16_t timeout,SpaceUsage& out);
+
+		//------------------------------------------------------------------------
+		// The space as a StatVFS answer ("nodesRW freeRW utilRW nodesStaging
+		// freeStaging utilStaging", MB and percent) and as a kXR_Qspace one
+		//------------------------------------------------------------------------
+		static std::string vfsLine(const SpaceUsage& u);
+		static std::string spaceCgi(const SpaceUsage& u);
+
+		void printStats();
+
+	private:
+		SpaceCache();
+		struct Result {
+			Result():err(0) {}
+			XrdCl::XRootDStatus st;
+			int                 err;
+			SpaceUsage          usage;
+		};
+		struct Entry {
+			double     taken;
+			SpaceUsage usage;
+		};
+
+		double                       ttl;
+		std::map<std::string,Entry>  entries;
+		uint64_t                     queries;
+		uint64_t                     statfss;
+		SingleFlight<Result>         flight;
+		XrdSysMutex                  mtx;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_SPACE_HH___
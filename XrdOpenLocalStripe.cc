@@ -0,0 +1,471 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalStripe.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+
+namespace Locfile {
+
+//----------------------------------------------------------------------------
+// lov_user_md magics and sizes, from lustre_user.h
+//----------------------------------------------------------------------------
+static const uint32_t lovMagicV1=0x0BD10BD0;
+static const uint32_t lovMagicV3=0x0BD30BD0;
+static const uint32_t lovMagicComp=0x0BD60BD0;
+static const size_t   lovHeaderV1=32;
+static const size_t   lovHeaderV3=48;
+static const size_t   lovObjectSize=24;  // lov_user_ost_data_v1, l_ost_idx at 20
+static const size_t   compHeader=32;     // lov_comp_md_v1
+static const uint32_t compInit=0x10;     // LCME_FL_INIT, the component has objects
+
+static uint16_t get16(const char* p) {
+	uint16_t v;
+	memcpy(&v,p,sizeof(v));
+	return v;
+}
+static uint32_t get32(const char* p) {
+	uint32_t v;
+	memcpy(&v,p,sizeof(v));
+	return v;
+}
+static uint64_t get64(const char* p) {
+	uint64_t v;
+	memcpy(&v,p,sizeof(v));
+	return v;
+}
+
+bool StripeLayout::locate(uint64_t off,uint32_t& ost,uint64_t& unitEnd) const {
+	for(auto& c : comps) {
+		if(off<c.start || off>=c.end) continue;
+		//--------------------------------------------------------------------
+		// Stripe units count from the start of the file, component
+		// boundaries are multiples of the stripe size
+		//--------------------------------------------------------------------
+		uint64_t unit=off/c.stripeSize;
+		ost=c.osts[unit%c.osts.size()];
+		unitEnd=std::min((unit+1)*c.stripeSize,c.end);
+		return true;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------
+// A v1 or v3 lov_user_md, the layout of one component
+//----------------------------------------------------------------------------
+static bool parsePlain(const char* buf,size_t len,uint64_t start,uint64_t end,
+                       StripeLayout::Component& c) {
+	if(len<lovHeaderV1) return false;
+	size_t hdr;
+	uint32_t magic=get32(buf);
+	if(magic==lovMagicV1) hdr=lovHeaderV1;
+	else if(magic==lovMagicV3) hdr=lovHeaderV3;
+	else return false;
+	uint32_t size=get32(buf+24);
+	uint16_t count=get16(buf+28);
+	if(!size || !count || len<hdr+count*lovObjectSize) return false;
+	c.start=start;
+	c.end=end;
+	c.stripeSize=size;
+	c.osts.clear();
+	for(uint16_t i=0; i<count; ++i) c.osts.push_back(get32(buf+hdr+i*lovObjectSize+20));
+	return true;
+}
+
+bool LovLayoutProvider::parse(const char* buf,size_t len,StripeLayout& out) {
+	out.comps.clear();
+	if(len<4) return false;
+	if(get32(buf)!=lovMagicComp) {
+		StripeLayout::Component c;
+		if(!parsePlain(buf,len,0,UINT64_MAX,c)) return false;
+		out.comps.push_back(c);
+		return true;
+	}
+
+	//------------------------------------------------------------------------
+	// A composite layout: the entry table is followed by the component
+	// blobs, so the offset of the first blob gives the size of an entry.
+	// Components that follow on from the ones taken belong to the first
+	// mirror, those without objects are not written yet.
+	//------------------------------------------------------------------------
+	if(len<compHeader) return false;
+	uint16_t count=get16(buf+14);
+	if(!count || len<compHeader+28) return false;
+	uint32_t first=get32(buf+compHeader+24);
+	if(first<=compHeader || (first-compHeader)%count) return false;
+	size_t stride=(first-compHeader)/count;
+	if(stride<32 || first>len) return false;
+	uint64_t covered=0;
+	for(uint16_t i=0; i<count; ++i) {
+		const char* e=buf+compHeader+i*stride;
+		uint32_t flags=get32(e+4);
+		uint64_t start=get64(e+8);
+		uint64_t end=get64(e+16);
+		uint32_t off=get32(e+24);
+		uint32_t size=get32(e+28);
+		if(!(flags & compInit) || start!=covered) continue;
+		if(off>len || size>len-off) return false;
+		StripeLayout::Component c;
+		if(!parsePlain(buf+off,size,start,end,c)) continue;
+		out.comps.push_back(c);
+		covered=end;
+		if(end==UINT64_MAX) break;
+	}
+	return !out.comps.empty();
+}
+
+std::shared_ptr<const StripeLayout> LovLayoutProvider::layout(int fd) {
+	std::shared_ptr<const StripeLayout> none;
+	ssize_t len=fgetxattr(fd,"lustre.lov",0,0);
+	if(len<=0) return none;
+	std::vector<char> buf(len);
+	len=fgetxattr(fd,"lustre.lov",&buf[0],buf.size());
+	struct stat sb;
+	if(len<=0 || fstat(fd,&sb)<0) return none;
+	std::shared_ptr<StripeLayout> l(new StripeLayout());
+	l->dev=sb.st_dev;
+	if(!parse(&buf[0],len,*l)) return none;
+	return l;
+}
+
+FakeLayoutProvider::FakeLayoutProvider(uint64_t stripeSize,uint32_t count):
+	stripeSize(stripeSize?stripeSize:1024*1024),count(count?count:1) {
+}
+
+std::shared_ptr<const StripeLayout> FakeLayoutProvider::layout(int fd) {
+	struct stat sb;
+	if(fstat(fd,&sb)<0 || !S_ISREG(sb.st_mode)) return std::shared_ptr<const StripeLayout>();
+	std::shared_ptr<StripeLayout> l(new StripeLayout());
+	l->dev=sb.st_dev;
+	StripeLayout::Component c;
+	c.start=0;
+	c.end=UINT64_MAX;
+	c.stripeSize=stripeSize;
+	for(uint32_t i=0; i<count; ++i) c.osts.push_back(i);
+	l->comps.push_back(c);
+	return l;
+}
+
+//----------------------------------------------------------------------------
+// One scheduled read, shared by the caller and its workers. Its pieces and
+// counters are guarded by its own cond, the OST slots by the scheduler's
+// mtx, taken after cond.
+//----------------------------------------------------------------------------
+struct StripeScheduler::Batch {
+	Batch():left(0),finished(0),turn(0),refs(1),cond(0) {}
+	Reader                          reader;
+	std::vector<Piece>              pieces;
+	std::vector<OstKey>             osts;
+	std::vector<std::deque<size_t> > queues; // pieces not taken, per OST
+	size_t                          left;
+	size_t                          finished;
+	size_t                          turn;    // the OST tried first by the next take
+	std::atomic<int>                refs;
+	XrdSysCondVar                   cond;
+};
+
+class StripeJob: public XrdCl::Job {
+	public:
+		virtual void Run(void* arg) {
+			StripeScheduler::Batch* b=static_cast<StripeScheduler::Batch*>(arg);
+			StripeScheduler::instance().work(b);
+			StripeScheduler::instance().release(b);
+		}
+};
+static StripeJob stripeJob;
+
+StripeScheduler& StripeScheduler::instance() {
+	static StripeScheduler scheduler;
+	return scheduler;
+}
+
+StripeScheduler::StripeScheduler():on(false),depth(2),provider(new LovLayoutProvider()),
+	files(0),batches(0),pieces(0),waits(0),pool("XrdOpenLocal stripe",16) {
+	ForkGuard::instance().add(this,ForkAware::Lock);
+}
+
+void StripeScheduler::configure(const std::map<std::string,std::string>& config) {
+	XrdSysMutexHelper lck(mtx);
+	on=Utils::getBool(config,"stripeaware",on);
+	depth=Utils::getNumber(config,"stripedepth",depth);
+	if(!depth) depth=1;
+	if(config.find("stripethreads")!=config.end())
+		pool.resize(Utils::getNumber(config,"stripethreads",16),0);
+	std::string src=Utils::getString(config,"stripelayout","");
+	if(src=="lov") {
+		provider.reset(new LovLayoutProvider());
+	} else if(src.compare(0,5,"fake:")==0) {
+		//--------------------------------------------------------------------
+		// "fake:<stripe size in KB>:<stripe count>"
+		//--------------------------------------------------------------------
+		char* end=0;
+		uint64_t kb=strtoull(src.c_str()+5,&end,10);
+		uint32_t count=(*end==':')?strtoul(end+1,0,10):1;
+		provider.reset(new FakeLayoutProvider(kb*1024,count));
+	}
+}
+
+void StripeScheduler::setProvider(LayoutProvider* p) {
+	XrdSysMutexHelper lck(mtx);
+	provider.reset(p);
+}
+
+//----------------------------------------------------------------------------
+// The provider is used unlocked, a configure or setProvider meanwhile only
+// drops the scheduler's reference to it
+//----------------------------------------------------------------------------
+std::shared_ptr<const StripeLayout> StripeScheduler::probe(int fd) {
+	std::shared_ptr<LayoutProvider> p;
+	{
+		XrdSysMutexHelper lck(mtx);
+		p=provider;
+	}
+	if(!p) return std::shared_ptr<const StripeLayout>();
+	return p->layout(fd);
+}
+
+std::shared_ptr<const StripeLayout> StripeScheduler::layout(int fd) {
+	std::shared_ptr<const StripeLayout> none;
+	mtx.Lock();
+	bool enabled=on;
+	mtx.UnLock();
+	if(!enabled) return none;
+	std::shared_ptr<const StripeLayout> l=probe(fd);
+	if(!l) return none;
+	bool striped=false;
+	for(auto& c : l->comps) {
+		if(c.osts.size()>1) striped=true;
+	}
+	if(!striped) return none;
+	XrdSysMutexHelper lck(mtx);
+	files++;
+	return l;
+}
+
+bool StripeScheduler::spreads(const StripeLayout& l,const XrdCl::ChunkList& chunks) {
+	bool first=true;
+	uint32_t seen=0;
+	for(auto& ch : chunks) {
+		uint64_t off=ch.offset;
+		uint64_t end=ch.offset+ch.length;
+		while(off<end) {
+			uint32_t ost;
+			uint64_t unitEnd;
+			if(!l.locate(off,ost,unitEnd)) break;
+			if(first) {
+				seen=ost;
+				first=false;
+			} else if(ost!=seen) {
+				return true;
+			}
+			off=unitEnd;
+		}
+	}
+	return false;
+}
+
+void StripeScheduler::release(Batch* b) {
+	if(--b->refs==0) delete b;
+}
+
+//----------------------------------------------------------------------------
+// Take the next piece of an OST with room, taking turns over the OSTs.
+// Called with the batch's cond locked, waits while all OSTs of the batch
+// are busy, false when no piece is left.
+//----------------------------------------------------------------------------
+bool StripeScheduler::take(Batch* b,size_t& idx) {
+	while(b->left) {
+		mtx.Lock();
+		for(size_t n=0; n<b->osts.size(); ++n) {
+			size_t i=(b->turn+n)%b->osts.size();
+			if(b->queues[i].empty()) continue;
+			uint32_t& a=active[b->osts[i]];
+			if(a>=depth) continue;
+			a++;
+			mtx.UnLock();
+			idx=b->queues[i].front();
+			b->queues[i].pop_front();
+			b->left--;
+			b->turn=i+1;
+			return true;
+		}
+		//--------------------------------------------------------------------
+		// Wait on the OSTs with pieces left, done() of one of them wakes the
+		// batch. It cannot post before the wait: it needs the batch's cond.
+		//--------------------------------------------------------------------
+		for(size_t i=0; i<b->osts.size(); ++i) {
+			if(!b->queues[i].empty()) waiters[b->osts[i]].insert(b);
+		}
+		waits++;
+		mtx.UnLock();
+		b->cond.Wait();
+		mtx.Lock();
+		for(size_t i=0; i<b->osts.size(); ++i) {
+			auto it=waiters.find(b->osts[i]);
+			if(it==waiters.end()) continue;
+			it->second.erase(b);
+			if(it->second.empty()) waiters.erase(it);
+		}
+		mtx.UnLock();
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------
+// A piece on ost is done, wake the reads waiting for room on it
+//----------------------------------------------------------------------------
+void StripeScheduler::done(const OstKey& ost) {
+	std::vector<Batch*> wake;
+	{
+		XrdSysMutexHelper lck(mtx);
+		active[ost]--;
+		auto it=waiters.find(ost);
+		if(it==waiters.end()) return;
+		for(auto b : it->second) {
+			b->refs++;
+			wake.push_back(b);
+		}
+	}
+	for(auto b : wake) {
+		b->cond.Lock();
+		b->cond.Broadcast();
+		b->cond.UnLock();
+		release(b);
+	}
+}
+
+void StripeScheduler::work(Batch* b) {
+	b->cond.Lock();
+	size_t idx;
+	while(take(b,idx)) {
+		Piece& p=b->pieces[idx];
+		b->cond.UnLock();
+		ssize_t r=b->reader(p.buf,p.len,p.off);
+		done(b->osts[p.ost]);
+		b->cond.Lock();
+		p.result=r;
+		b->finished++;
+		b->cond.Broadcast();
+	}
+	b->cond.UnLock();
+}
+
+void StripeScheduler::prepareFork() {
+	mtx.Lock();
+}
+
+void StripeScheduler::parentFork() {
+	mtx.UnLock();
+}
+
+void StripeScheduler::childFork() {
+	active.clear();
+	waiters.clear();
+	mtx.UnLock();
+}
+
+int StripeScheduler::read(const StripeLayout& l,const XrdCl::ChunkList& chunks,
+                          std::vector<uint32_t>& got,const Reader& reader) {
+	Batch* b=new Batch();
+	b->reader=reader;
+
+	//--------------------------------------------------------------------------
+	// Split the chunks at the stripe units, what no component covers is
+	// read as one piece
+	//--------------------------------------------------------------------------
+	std::map<OstKey,size_t> ostIdx;
+	for(size_t i=0; i<chunks.size(); ++i) {
+		uint64_t off=chunks[i].offset;
+		uint64_t end=off+chunks[i].length;
+		char* buf=(char*)chunks[i].buffer;
+		while(off<end) {
+			uint32_t ost;
+			uint64_t unitEnd;
+			if(!l.locate(off,ost,unitEnd)) {
+				ost=UINT32_MAX;
+				unitEnd=end;
+			}
+			OstKey key(l.dev,ost);
+			auto it=ostIdx.find(key);
+			if(it==ostIdx.end()) {
+				it=ostIdx.insert(std::make_pair(key,b->osts.size())).first;
+				b->osts.push_back(key);
+				b->queues.push_back(std::deque<size_t>());
+			}
+			Piece p;
+			p.chunk=i;
+			p.ost=it->second;
+			p.buf=buf;
+			p.len=std::min(end,unitEnd)-off;
+			p.off=off;
+			p.result=0;
+			b->queues[p.ost].push_back(b->pieces.size());
+			b->pieces.push_back(p);
+			buf+=p.len;
+			off+=p.len;
+		}
+	}
+	b->left=b->pieces.size();
+
+	//--------------------------------------------------------------------------
+	// As many workers as the OSTs have room for, the caller is one of them
+	//--------------------------------------------------------------------------
+	uint32_t workers=0;
+	{
+		XrdSysMutexHelper lck(mtx);
+		batches++;
+		pieces+=b->pieces.size();
+		workers=std::min<size_t>(b->osts.size()*depth,b->pieces.size());
+		if(workers) workers--;
+		workers=std::min(workers,pool.size());
+		b->refs+=workers;
+	}
+	for(uint32_t i=0; i<workers; ++i) {
+		if(!pool.queue(&stripeJob,b)) release(b);
+	}
+	work(b);
+
+	b->cond.Lock();
+	while(b->finished<b->pieces.size()) b->cond.Wait();
+	b->cond.UnLock();
+
+	//--------------------------------------------------------------------------
+	// A chunk got what its pieces read up to the first short one
+	//--------------------------------------------------------------------------
+	int err=0;
+	got.assign(chunks.size(),0);
+	std::vector<bool> shortRead(chunks.size(),false);
+	for(auto& p : b->pieces) {
+		if(p.result<0) {
+			if(!err) err=-p.result;
+			continue;
+		}
+		if(shortRead[p.chunk]) continue;
+		got[p.chunk]+=p.result;
+		if((size_t)p.result<p.len) shortRead[p.chunk]=true;
+	}
+	release(b);
+	return err;
+}
+
+void StripeScheduler::printStats() {
+	XrdSysMutexHelper lck(mtx);
+	if(!files) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"StripeScheduler: %lu striped files, %lu reads in %lu pieces, %lu waits for an OST",
+	           (unsigned long)files,(unsigned long)batches,(unsigned long)pieces,(unsigned long)waits);
+}
+}
@@ -0,0 +1,184 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_STRIPE_HH___
+#define __XRDREDIRCT_TOLOCAL_STRIPE_HH___
+#include "XrdOpenLocalPool.hh"
+#include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <sys/types.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// How a file is striped over the OSTs of its file system
+//
+// A plain layout has one component covering the whole file, a progressive
+// one (PFL) has one per extent. Stripe unit n of a component is on
+// osts[n % osts.size()].
+//----------------------------------------------------------------------------
+struct StripeLayout {
+	struct Component {
+		uint64_t              start;
+		uint64_t              end;        // exclusive, UINT64_MAX up to EOF
+		uint64_t              stripeSize;
+		std::vector<uint32_t> osts;
+	};
+	uint64_t               dev;           // OST numbers are per file system
+	std::vector<Component> comps;
+
+	//------------------------------------------------------------------------
+	// The OST holding the byte at off and the end of its stripe unit, false
+	// if no component covers off
+	//------------------------------------------------------------------------
+	bool locate(uint64_t off,uint32_t& ost,uint64_t& unitEnd) const;
+};
+
+//----------------------------------------------------------------------------
+// Where layouts come from: the "lustre.lov" xattr, or a fixed layout for
+// testing on file systems without one
+//----------------------------------------------------------------------------
+class LayoutProvider {
+	public:
+		virtual ~LayoutProvider() {}
+
+		//------------------------------------------------------------------------
+		// The layout of the file open on fd, null if it has none
+		//------------------------------------------------------------------------
+		virtual std::shared_ptr<const StripeLayout> layout(int fd)=0;
+};
+
+//----------------------------------------------------------------------------
+// Layouts parsed from the lov_user_md in the "lustre.lov" xattr (v1, v3
+// and the initialized components of the first mirror of a composite one)
+//----------------------------------------------------------------------------
+class LovLayoutProvider: public LayoutProvider {
+	public:
+		virtual std::shared_ptr<const StripeLayout> layout(int fd);
+
+		//------------------------------------------------------------------------
+		// Parse an xattr value, false if it is not a layout we know
+		//------------------------------------------------------------------------
+		static bool parse(const char* buf,size_t len,StripeLayout& out);
+};
+
+//----------------------------------------------------------------------------
+// Every file striped the same way ("stripelayout = fake:<KB>:<count>")
+//----------------------------------------------------------------------------
+class FakeLayoutProvider: public LayoutProvider {
+	public:
+		FakeLayoutProvider(uint64_t stripeSize,uint32_t count);
+		virtual std::shared_ptr<const StripeLayout> layout(int fd);
+
+	private:
+		uint64_t stripeSize;
+		uint32_t count;
+};
+
+//----------------------------------------------------------------------------
+// Stripe-aware scheduling of local reads
+//
+// With "stripeaware = true" the layout of a local file is fetched once per
+// open. Reads and vector reads covering more than one OST are split at the
+// stripe units and the pieces are read by a worker pool, the caller
+// working along, taking turns over the OSTs: at most "stripedepth" reads
+// are in flight per OST, process wide, so a burst spreads over all stripes
+// instead of queueing on one. A read waiting for its OSTs is woken when
+// one of them has room again. A child forgets the reads its parent has in
+// flight.
+//----------------------------------------------------------------------------
+class StripeScheduler: public ForkAware {
+	public:
+		typedef std::function<ssize_t(char*,size_t,uint64_t)> Reader;
+
+		//------------------------------------------------------------------------
+		// The process wide scheduler
+		//------------------------------------------------------------------------
+		static StripeScheduler& instance();
+
+		//------------------------------------------------------------------------
+		// Read the options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		//------------------------------------------------------------------------
+		// Replace the layout provider, the scheduler owns it
+		//------------------------------------------------------------------------
+		void setProvider(LayoutProvider* p);
+
+		//------------------------------------------------------------------------
+		// The layout of the file open on fd, null if disabled or not striped
+		//------------------------------------------------------------------------
+		std::shared_ptr<const StripeLayout> layout(int fd);
+
+		//------------------------------------------------------------------------
+		// The layout of the file open on fd from the provider, also when
+		// the scheduling is off
+		//------------------------------------------------------------------------
+		std::shared_ptr<const StripeLayout> probe(int fd);
+
+		//------------------------------------------------------------------------
+		// Whether the chunks cover more than one OST
+		//------------------------------------------------------------------------
+		static bool spreads(const StripeLayout& l,const XrdCl::ChunkList& chunks);
+
+		//------------------------------------------------------------------------
+		// Read the chunks with reader, which returns the bytes read or -errno,
+		// got holds the bytes read per chunk. Returns 0 or the errno of the
+		// first failed piece.
+		//------------------------------------------------------------------------
+		int read(const StripeLayout& l,const XrdCl::ChunkList& chunks,
+		         std::vector<uint32_t>& got,const Reader& reader);
+
+		//------------------------------------------------------------------------
+		// ForkAware
+		//------------------------------------------------------------------------
+		virtual void prepareFork();
+		virtual void parentFork();
+		virtual void childFork();
+
+		void printStats();
+
+	private:
+		StripeScheduler();
+		typedef std::pair<uint64_t,uint32_t> OstKey; // device, OST
+		struct Piece {
+			size_t   chunk;
+			size_t   ost;     // index into the OSTs of the batch
+			char*    buf;
+			size_t   len;
+			uint64_t off;
+			ssize_t  result;
+		};
+		struct Batch;
+		friend class StripeJob;
+		bool take(Batch* b,size_t& idx);
+		void work(Batch* b);
+		void release(Batch* b);
+		void done(const OstKey& ost);
+
+		bool                            on;
+		uint32_t                        depth;   // reads in flight per OST
+		std::shared_ptr<LayoutProvider> provider;
+		std::map<OstKey,uint32_t>       active;
+		std::map<OstKey,std::set<Batch*> > waiters; // reads waiting for room on an OST
+		uint64_t                        files;
+		uint64_t                        batches;
+		uint64_t                        pieces;
+		uint64_t                        waits;
+		WorkerPool                      pool;
+		XrdSysMutex                     mtx;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_STRIPE_HH___
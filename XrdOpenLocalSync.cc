@@ -0,0 +1,126 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalSync.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace Locfile {
+
+SyncEngine& SyncEngine::instance() {
+	static SyncEngine engine;
+	return engine;
+}
+
+SyncEngine::SyncEngine():window(2000),maxBatch(64),syncfsFiles(0),committing(0),onClose(false),
+	requests(0),batches(0),datasyncs(0),syncfss(0),cond(0) {
+}
+
+void SyncEngine::configure(const std::map<std::string,std::string>& config) {
+	XrdSysCondVarHelper lck(cond);
+	window=Utils::getNumber(config,"syncwindow",window);
+	maxBatch=Utils::getNumber(config,"syncbatch",maxBatch);
+	if(!maxBatch) maxBatch=1;
+	syncfsFiles=Utils::getNumber(config,"syncfsfiles",syncfsFiles);
+	onClose=Utils::getBool(config,"syncclose",onClose);
+}
+
+int SyncEngine::sync(int fd) {
+	struct stat sb;
+	if(fstat(fd,&sb)<0) return errno;
+	Entry e;
+	e.fd=fd;
+	e.dev=sb.st_dev;
+	e.ino=sb.st_ino;
+	e.err=0;
+
+	cond.Lock();
+	requests++;
+	bool leader=!current;
+	if(leader) current.reset(new Batch());
+	std::shared_ptr<Batch> b=current;
+	size_t idx=b->entries.size();
+	b->entries.push_back(e);
+	if(b->entries.size()>=maxBatch) cond.Broadcast(); // wake the leader early
+	if(!leader) {
+		while(!b->done) cond.Wait();
+		int err=b->entries[idx].err;
+		cond.UnLock();
+		return err;
+	}
+
+	//--------------------------------------------------------------------------
+	// While another batch is committed the leader collects Syncs, new ones
+	// then start a batch of their own while this one is committed
+	//--------------------------------------------------------------------------
+	double end=Utils::now()+window/1e6;
+	while(committing && b->entries.size()<maxBatch) {
+		double left=end-Utils::now();
+		if(left<=0) break;
+		cond.WaitMS(left*1000+1);
+	}
+	current.reset();
+	batches++;
+	committing++;
+	cond.UnLock();
+
+	commit(*b);
+
+	cond.Lock();
+	committing--;
+	b->done=true;
+	cond.Broadcast();
+	int err=b->entries[idx].err;
+	cond.UnLock();
+	return err;
+}
+
+//----------------------------------------------------------------------------
+// Sync all entries of a batch, no one adds to it any more
+//----------------------------------------------------------------------------
+void SyncEngine::commit(Batch& b) {
+	std::map<uint64_t,std::vector<Entry*> > perDev;
+	for(auto& e : b.entries) perDev[e.dev].push_back(&e);
+	uint64_t nData=0,nFs=0;
+	for(auto& d : perDev) {
+		if(syncfsFiles && d.second.size()>=syncfsFiles) {
+			int err=syncfs(d.second.front()->fd)<0?errno:0;
+			for(auto e : d.second) e->err=err;
+			nFs++;
+			continue;
+		}
+		std::map<uint64_t,int> done;  // inode -> result, a file opened twice is synced once
+		for(auto e : d.second) {
+			auto it=done.find(e->ino);
+			if(it!=done.end()) {
+				e->err=it->second;
+				continue;
+			}
+			int err=fdatasync(e->fd)<0?errno:0;
+			done[e->ino]=err;
+			e->err=err;
+			nData++;
+		}
+	}
+	XrdSysCondVarHelper lck(cond);
+	datasyncs+=nData;
+	syncfss+=nFs;
+}
+
+void SyncEngine::printStats() {
+	XrdSysCondVarHelper lck(cond);
+	if(!requests) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"SyncEngine: %lu syncs in %lu batches, %lu fdatasync, %lu syncfs",
+	           (unsigned long)requests,(unsigned long)batches,(unsigned long)datasyncs,(unsigned long)syncfss);
+}
+}
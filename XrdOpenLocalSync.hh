@@ -0,0 +1,85 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_SYNC_HH___
+#define __XRDREDIRCT_TOLOCAL_SYNC_HH___
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Group commit of local syncs
+//
+// A Sync while no batch is being committed is committed at once. Else the
+// first Sync of a new batch waits until the running commit is over, at
+// most "syncwindow" microseconds (or until "syncbatch" files joined), and
+// then makes the whole batch durable for all of them: one fdatasync per
+// distinct file, or one syncfs per file system that has "syncfsfiles" or
+// more files in the batch. Every caller of the batch returns when the
+// batch is done. syncfs flushes the data of every job on the file system
+// and, before Linux 5.8, does not report writeback errors, so it is off
+// by default.
+//----------------------------------------------------------------------------
+class SyncEngine {
+	public:
+		//------------------------------------------------------------------------
+		// The process wide engine
+		//------------------------------------------------------------------------
+		static SyncEngine& instance();
+
+		//------------------------------------------------------------------------
+		// Read the options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		//------------------------------------------------------------------------
+		// Make the data of fd durable, returns 0 or errno
+		//------------------------------------------------------------------------
+		int sync(int fd);
+
+		//------------------------------------------------------------------------
+		// Whether files written to are synced at Close ("syncclose = true")
+		//------------------------------------------------------------------------
+		bool syncOnClose() const {
+			return onClose;
+		}
+
+		void printStats();
+
+	private:
+		SyncEngine();
+		struct Entry {
+			int      fd;
+			uint64_t dev;
+			uint64_t ino;
+			int      err;
+		};
+		struct Batch {
+			Batch():done(false) {}
+			std::vector<Entry> entries;
+			bool               done;
+		};
+		void commit(Batch& b);
+
+		std::shared_ptr<Batch> current;  // the batch new Syncs join
+		uint32_t window;                 // microseconds the first Sync waits
+		uint32_t maxBatch;
+		uint32_t syncfsFiles;            // 0 never uses syncfs
+		uint32_t committing;             // batches being committed
+		bool     onClose;
+		uint64_t requests;
+		uint64_t batches;
+		uint64_t datasyncs;
+		uint64_t syncfss;
+		XrdSysCondVar cond;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_SYNC_HH___
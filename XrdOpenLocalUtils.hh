@@ -0,0 +1,84 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_UTILS_HH___
+#define __XRDREDIRCT_TOLOCAL_UTILS_HH___
+#include <map>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <time.h>
+#include <sys/stat.h>
+#include "XrdCl/XrdClXRootDResponses.hh"
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Small helpers shared by the plug-in engines
+//----------------------------------------------------------------------------
+namespace Utils {
+	//------------------------------------------------------------------------
+	// Monotonic time in seconds, used for all latency measurements
+	//------------------------------------------------------------------------
+	inline double now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC,&ts);
+		return ts.tv_sec+ts.tv_nsec*1e-9;
+	}
+
+	//------------------------------------------------------------------------
+	// Read a numeric value from the plug-in config, or return the default
+	//------------------------------------------------------------------------
+	inline double getNumber(const std::map<std::string,std::string>& config,
+	                        const std::string& key,double def) {
+		auto it=config.find(key);
+		if(it==config.end() || it->second.empty()) return def;
+		char* end=0;
+		double val=strtod(it->second.c_str(),&end);
+		if(end==it->second.c_str()) return def;
+		return val;
+	}
+
+	//------------------------------------------------------------------------
+	// Read a boolean ("true"/"false", "1"/"0") from the plug-in config
+	//------------------------------------------------------------------------
+	inline bool getBool(const std::map<std::string,std::string>& config,
+	                    const std::string& key,bool def) {
+		auto it=config.find(key);
+		if(it==config.end()) return def;
+		if(it->second=="true" || it->second=="1" || it->second=="yes") return true;
+		if(it->second=="false" || it->second=="0" || it->second=="no") return false;
+		return def;
+	}
+
+	//------------------------------------------------------------------------
+	// A local stat in the server's "id size flags mtime" format, as parsed
+	// by XrdCl::StatInfo
+	//------------------------------------------------------------------------
+	inline std::string statLine(const struct stat& s) {
+		uint32_t flags=0;
+		if(S_ISDIR(s.st_mode)) flags|=XrdCl::StatInfo::IsDir;
+		else if(!S_ISREG(s.st_mode)) flags|=XrdCl::StatInfo::Other;
+		if(s.st_mode&(S_IXUSR|S_IXGRP|S_IXOTH)) flags|=XrdCl::StatInfo::XBitSet;
+		if(s.st_mode&(S_IRUSR|S_IRGRP|S_IROTH)) flags|=XrdCl::StatInfo::IsReadable;
+		if(s.st_mode&(S_IWUSR|S_IWGRP|S_IWOTH)) flags|=XrdCl::StatInfo::IsWritable;
+		std::ostringstream data;
+		data<<s.st_dev<<":"<<s.st_ino <<" "<< s.st_size <<" "<<flags<<" "<<s.st_mtime ;
+		return data.str();
+	}
+
+	//------------------------------------------------------------------------
+	// Read a string value from the plug-in config, or return the default
+	//------------------------------------------------------------------------
+	inline std::string getString(const std::map<std::string,std::string>& config,
+	                             const std::string& key,const std::string& def) {
+		auto it=config.find(key);
+		if(it==config.end()) return def;
+		return it->second;
+	}
+}
+}
+#endif // __XRDREDIRCT_TOLOCAL_UTILS_HH___
@@ -0,0 +1,243 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "XrdOpenLocalWriteBehind.hh"
+#include "XrdOpenLocalUtils.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+namespace Locfile {
+
+//----------------------------------------------------------------------------
+// Write all of len bytes at off, returns 0 or errno
+//----------------------------------------------------------------------------
+static int writeAll(int fd,const char* buf,size_t len,uint64_t off) {
+	size_t done=0;
+	while(done<len) {
+		ssize_t r=pwrite(fd,buf+done,len-done,off+done);
+		if(r<0 && errno==EINTR) continue;
+		if(r<0) return errno;
+		done+=r;
+	}
+	return 0;
+}
+
+class FlushJob: public XrdCl::Job {
+	public:
+		virtual void Run(void* arg) {
+			static_cast<WriteBuffer*>(arg)->flush();
+		}
+};
+static FlushJob flushJob;
+
+WriteBuffer::WriteBuffer(int fd,size_t capacity,unsigned depth):fd(fd),capacity(capacity),depth(depth),
+	running(false),err(0),writes(0),merged(0),flushes(0),bytes(0),cond(0) {
+}
+
+WriteBuffer::~WriteBuffer() {
+	int e=barrier();
+	if(e) {
+		XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+		log->Warning(1,"WriteBuffer: data lost at close: %s",strerror(e));
+	}
+	WriteBehind::instance().retire(this);
+}
+
+//----------------------------------------------------------------------------
+// Queue the extent being filled, called with cond locked
+//----------------------------------------------------------------------------
+void WriteBuffer::push() {
+	while(queued.size()>=depth) cond.Wait();
+	if(fill.data.empty()) return;
+	queued.push_back(Extent());
+	std::swap(queued.back(),fill);
+	fill.data.reserve(capacity);
+	kick();
+}
+
+//----------------------------------------------------------------------------
+// Start a flush job unless one runs, called with cond locked
+//----------------------------------------------------------------------------
+void WriteBuffer::kick() {
+	if(running || queued.empty()) return;
+	running=true;
+	if(WriteBehind::instance().pool.queue(&flushJob,this)) return;
+	cond.UnLock();
+	flush();
+	cond.Lock();
+}
+
+//----------------------------------------------------------------------------
+// Wait until the queue is written, called with cond locked
+//----------------------------------------------------------------------------
+void WriteBuffer::drain() {
+	while(running || !queued.empty()) cond.Wait();
+}
+
+void WriteBuffer::flush() {
+	cond.Lock();
+	while(!queued.empty()) {
+		Extent e;
+		std::swap(e,queued.front());
+		queued.pop_front();
+		cond.Broadcast(); // room for a waiting writer
+		int wfd=fd;
+		cond.UnLock();
+		int r=writeAll(wfd,&e.data[0],e.data.size(),e.off);
+		cond.Lock();
+		if(r && !err) err=r;
+		flushes++;
+		bytes+=e.data.size();
+	}
+	running=false;
+	cond.Broadcast();
+	cond.UnLock();
+}
+
+int WriteBuffer::write(const char* buf,size_t size,uint64_t off) {
+	XrdSysCondVarHelper lck(cond);
+	if(err) {
+		int e=err;
+		err=0;
+		return e;
+	}
+	writes++;
+	if(size>=capacity) {
+		//--------------------------------------------------------------------
+		// Nothing to merge, write it once the earlier extents are out
+		//--------------------------------------------------------------------
+		push();
+		drain();
+		if(err) {
+			int e=err;
+			err=0;
+			return e;
+		}
+		bytes+=size;
+		return writeAll(fd,buf,size,off);
+	}
+	uint64_t end=off+size;
+	while(true) {
+		if(fill.data.empty()) {
+			fill.off=off;
+			fill.data.assign(buf,buf+size);
+			return 0;
+		}
+		uint64_t fend=fill.off+fill.data.size();
+		uint64_t start=std::min(off,fill.off);
+		if(off<=fend && end>=fill.off && std::max(end,fend)-start<=capacity) {
+			if(off<fill.off) {
+				fill.data.insert(fill.data.begin(),fill.off-off,0);
+				fill.off=off;
+			}
+			if(end>fend) fill.data.resize(end-fill.off);
+			memcpy(&fill.data[off-fill.off],buf,size);
+			merged++;
+			if(fill.data.size()>=capacity) push();
+			return 0;
+		}
+		push();
+	}
+}
+
+int WriteBuffer::barrier() {
+	XrdSysCondVarHelper lck(cond);
+	push();
+	drain();
+	int e=err;
+	err=0;
+	return e;
+}
+
+void WriteBuffer::setFd(int newFd) {
+	XrdSysCondVarHelper lck(cond);
+	fd=newFd;
+}
+
+WriteBehind& WriteBehind::instance() {
+	static WriteBehind wb;
+	return wb;
+}
+
+WriteBehind::WriteBehind():on(false),bufSize(1024*1024),depth(4),files(0),writes(0),merged(0),
+	flushes(0),bytes(0),pool("XrdOpenLocal flush",4) {
+	ForkGuard::instance().add(this,ForkAware::Flush);
+}
+
+void WriteBehind::configure(const std::map<std::string,std::string>& config) {
+	XrdSysMutexHelper lck(mtx);
+	on=Utils::getBool(config,"writebehind",on);
+	bufSize=Utils::getNumber(config,"writebehindsize",bufSize/1024)*1024;
+	if(bufSize<4096) bufSize=4096;
+	depth=Utils::getNumber(config,"writebehinddepth",depth);
+	if(!depth) depth=1;
+	if(config.find("writebehindthreads")!=config.end())
+		pool.resize(Utils::getNumber(config,"writebehindthreads",4),0);
+}
+
+WriteBuffer* WriteBehind::create(int fd) {
+	size_t size=bufSize;
+	struct stat sb;
+	if(fstat(fd,&sb)==0 && size_t(sb.st_blksize)>size) size=sb.st_blksize;
+	XrdSysMutexHelper lck(mtx);
+	files++;
+	WriteBuffer* b=new WriteBuffer(fd,size,depth);
+	buffers.insert(b);
+	return b;
+}
+
+void WriteBehind::retire(WriteBuffer* b) {
+	XrdSysMutexHelper lck(mtx);
+	buffers.erase(b);
+	writes+=b->writes;
+	merged+=b->merged;
+	flushes+=b->flushes;
+	bytes+=b->bytes;
+}
+
+//----------------------------------------------------------------------------
+// Write out every buffer and keep them locked over the fork, a failed
+// flush is returned to the parent's next write
+//----------------------------------------------------------------------------
+void WriteBehind::prepareFork() {
+	mtx.Lock();
+	for(auto b : buffers) {
+		b->cond.Lock();
+		b->push();
+		b->drain();
+	}
+}
+
+void WriteBehind::parentFork() {
+	for(auto b : buffers) b->cond.UnLock();
+	mtx.UnLock();
+}
+
+void WriteBehind::childFork() {
+	for(auto b : buffers) {
+		b->running=false;
+		b->err=0;
+		renew(b->cond);
+	}
+	mtx.UnLock();
+}
+
+void WriteBehind::printStats() {
+	XrdSysMutexHelper lck(mtx);
+	if(!files) return;
+	XrdCl::Log *log= XrdCl::DefaultEnv::GetLog();
+	log->Debug(1,"WriteBehind: %lu files, %lu writes, %lu merged, %lu flushes, %lu bytes",
+	           (unsigned long)files,(unsigned long)writes,(unsigned long)merged,
+	           (unsigned long)flushes,(unsigned long)bytes);
+}
+}
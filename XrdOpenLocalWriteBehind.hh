@@ -0,0 +1,140 @@
+/********************************************************************************
+ *    Copyright (C) 2014 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *         GNU Lesser General Public Licence version 3 (LGPL) version 3,        *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef __XRDREDIRCT_TOLOCAL_WRITEBEHIND_HH___
+#define __XRDREDIRCT_TOLOCAL_WRITEBEHIND_HH___
+#include "XrdOpenLocalPool.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <sys/types.h>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Locfile {
+//----------------------------------------------------------------------------
+// Write-behind buffer of one local file
+//
+// Adjacent or overlapping writes are merged into one extent of up to the
+// buffer size. A full extent, or one a write does not continue, is queued
+// and written by a job on the write-behind pool; the extents of a file are
+// written one after the other in the order they were queued. Writes of at
+// least the buffer size go straight to the file once the queue is empty.
+// A failed flush is returned by the next write or barrier.
+//----------------------------------------------------------------------------
+class WriteBuffer {
+	public:
+		WriteBuffer(int fd,size_t capacity,unsigned depth);
+
+		//------------------------------------------------------------------------
+		// Destructor, flushes what is left
+		//------------------------------------------------------------------------
+		~WriteBuffer();
+
+		//------------------------------------------------------------------------
+		// Buffer size bytes at off, returns 0 or the errno of an earlier
+		// flush, in which case buf is not written
+		//------------------------------------------------------------------------
+		int write(const char* buf,size_t size,uint64_t off);
+
+		//------------------------------------------------------------------------
+		// Write everything buffered and wait for it, returns 0 or the errno of
+		// a failed flush
+		//------------------------------------------------------------------------
+		int barrier();
+
+		//------------------------------------------------------------------------
+		// Write to another descriptor from now on, after a barrier
+		//------------------------------------------------------------------------
+		void setFd(int newFd);
+
+	private:
+		struct Extent {
+			Extent():off(0) {}
+			uint64_t          off;
+			std::vector<char> data;
+		};
+		friend class FlushJob;
+		friend class WriteBehind;
+		void push();
+		void kick();
+		void drain();
+		void flush();
+
+		int                fd;
+		size_t             capacity;
+		unsigned           depth;    // queued extents before writers wait
+		Extent             fill;
+		std::deque<Extent> queued;
+		bool               running;  // a flush job works on the queue
+		int                err;
+		uint64_t           writes;
+		uint64_t           merged;
+		uint64_t           flushes;
+		uint64_t           bytes;
+		XrdSysCondVar      cond;
+};
+
+//----------------------------------------------------------------------------
+// Configuration, pool and statistics of the write-behind buffers
+//
+// With "writebehind = true" files opened for writing on a local root get a
+// WriteBuffer of "writebehindsize" KB, or the file's st_blksize (the stripe
+// size on Lustre) if that is larger. Before a fork all buffers are written
+// out, so the child never writes the parent's data again.
+//----------------------------------------------------------------------------
+class WriteBehind: public ForkAware {
+	public:
+		//------------------------------------------------------------------------
+		// The process wide instance
+		//------------------------------------------------------------------------
+		static WriteBehind& instance();
+
+		//------------------------------------------------------------------------
+		// Read the options from the plug-in config
+		//------------------------------------------------------------------------
+		void configure(const std::map<std::string,std::string>& config);
+
+		bool enabled() const {
+			return on;
+		}
+
+		//------------------------------------------------------------------------
+		// A buffer for the file open on fd, owned by the caller
+		//------------------------------------------------------------------------
+		WriteBuffer* create(int fd);
+
+		//------------------------------------------------------------------------
+		// ForkAware
+		//------------------------------------------------------------------------
+		virtual void prepareFork();
+		virtual void parentFork();
+		virtual void childFork();
+
+		void printStats();
+
+	private:
+		WriteBehind();
+		friend class WriteBuffer;
+		void retire(WriteBuffer* b);
+
+		bool       on;
+		size_t     bufSize;
+		unsigned   depth;
+		uint64_t   files;
+		uint64_t   writes;
+		uint64_t   merged;
+		uint64_t   flushes;
+		uint64_t   bytes;
+		std::set<WriteBuffer*> buffers;
+		WorkerPool pool;
+		XrdSysMutex mtx;
+};
+}
+#endif // __XRDREDIRCT_TOLOCAL_WRITEBEHIND_HH___
@@ -37,15 +37,208 @@
 #include <iostream>
 #include <queue>
 #include <algorithm>
+#include <vector>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
 
 namespace
 {
+  //----------------------------------------------------------------------------
+  //! Largest hole handed on as a single chunk
+  //----------------------------------------------------------------------------
+  const uint32_t MaxHoleChunk = 1073741824;
+
+  //----------------------------------------------------------------------------
+  //! Bytes spliced to stdout between two progress reports
+  //----------------------------------------------------------------------------
+  const uint64_t SpliceChunk = 16777216;
+
+  //----------------------------------------------------------------------------
+  //! A buffer of zeros for holes that have to be materialized
+  //----------------------------------------------------------------------------
+  const uint32_t ZeroBufferSize = 1048576;
+  const char *ZeroBuffer()
+  {
+    static const std::vector<char> zeros( ZeroBufferSize, 0 );
+    return &zeros[0];
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if a buffer holds only zeros
+  //----------------------------------------------------------------------------
+  bool IsZero( const char *buffer, uint32_t length )
+  {
+    const char *zeros = ZeroBuffer();
+    while( length )
+    {
+      uint32_t n = std::min( length, ZeroBufferSize );
+      if( memcmp( buffer, zeros, n ) != 0 )
+        return false;
+      buffer += n;
+      length -= n;
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Adaptive chunk size and number of chunks in flight
+  //!
+  //! Keeps a window of bytes in flight and measures the throughput of the
+  //! chunks completed in every epoch (a round of chunks, at least 100ms).
+  //! The window doubles while the throughput grows by 10% or more, then
+  //! grows by a quarter while that helps, halves when the throughput drops
+  //! by 30% and otherwise probes downwards while nothing is lost (faster
+  //! when the chunk latency is twice the lowest seen), so
+  //! copies settle at the bandwidth-delay product instead of the defaults.
+  //! The window is cut into chunks of the configured size, at most
+  //! maxParallel of them; beyond that the chunks grow up to maxChunk.
+  //----------------------------------------------------------------------------
+  class ChunkController
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //------------------------------------------------------------------------
+      ChunkController( uint32_t chunkSize, uint8_t parallel,
+                       uint32_t minChunk, uint32_t maxChunk,
+                       uint8_t  maxParallel ):
+        pBaseChunk( chunkSize ), pMinChunk( std::min( minChunk, chunkSize ) ),
+        pMaxChunk( std::max( maxChunk, chunkSize ) ),
+        pMaxParallel( std::max( maxParallel, parallel ) ),
+        pChunkSize( chunkSize ), pParallel( parallel ), pSlowStart( true ),
+        pProbeDown( false ), pBest( 0 ), pBestWindow( 0 ), pEpochBytes( 0 ),
+        pEpochChunks( 0 ), pEpochLatency( 0 ), pMinLatency( 0 )
+      {
+        pWindow = uint64_t( chunkSize ) * parallel;
+        gettimeofday( &pEpochStart, 0 );
+      }
+
+      //------------------------------------------------------------------------
+      //! Size of the next chunk
+      //------------------------------------------------------------------------
+      uint32_t ChunkSize() const
+      {
+        return pChunkSize;
+      }
+
+      //------------------------------------------------------------------------
+      //! Number of chunks to keep in flight
+      //------------------------------------------------------------------------
+      uint8_t Parallel() const
+      {
+        return pParallel;
+      }
+
+      //------------------------------------------------------------------------
+      //! A chunk of bytes completed after latency microseconds
+      //------------------------------------------------------------------------
+      void Done( uint32_t bytes, uint64_t latency )
+      {
+        pEpochBytes   += bytes;
+        pEpochLatency += latency;
+        ++pEpochChunks;
+
+        timeval now;
+        gettimeofday( &now, 0 );
+        uint64_t elapsed = XrdCl::Utils::GetElapsedMicroSecs( pEpochStart, now );
+        if( pEpochChunks < std::max<uint32_t>( pParallel, 2 ) ||
+            elapsed < 100000 )
+          return;
+
+        double throughput = pEpochBytes / ( elapsed / 1e6 );
+        uint64_t avgLatency = pEpochLatency / pEpochChunks;
+        if( !pMinLatency || avgLatency < pMinLatency )
+          pMinLatency = avgLatency;
+        Adjust( throughput, avgLatency );
+
+        XrdCl::Log *log = XrdCl::DefaultEnv::GetLog();
+        log->Debug( XrdCl::UtilityMsg, "Chunk controller: %.1f MB/s, %lu us "
+                    "per chunk, window %lu bytes: %u chunks of %u bytes",
+                    throughput / 1e6, (unsigned long)avgLatency,
+                    (unsigned long)pWindow, pParallel, pChunkSize );
+
+        pEpochStart   = now;
+        pEpochBytes   = 0;
+        pEpochChunks  = 0;
+        pEpochLatency = 0;
+      }
+
+    private:
+      //------------------------------------------------------------------------
+      //! Move the window after an epoch
+      //------------------------------------------------------------------------
+      void Adjust( double throughput, uint64_t latency )
+      {
+        if( throughput >= pBest * 1.1 )
+        {
+          pBest       = throughput;
+          pBestWindow = pWindow;
+          pProbeDown  = false;
+          pWindow    += pSlowStart ? pWindow : pWindow / 4;
+        }
+        else if( throughput < pBest * 0.7 )
+        {
+          pBest       = throughput;
+          pBestWindow = pWindow;
+          pSlowStart  = false;
+          pProbeDown  = false;
+          pWindow    /= 2;
+        }
+        else if( pProbeDown && throughput < pBest * 0.9 )
+        {
+          pProbeDown = false;
+          pWindow    = pBestWindow;
+        }
+        else
+        {
+          //--------------------------------------------------------------------
+          // No gain: go back to the window that did as well and see if less
+          // does too, faster if the chunks only queue up on the way
+          //--------------------------------------------------------------------
+          pSlowStart = false;
+          if( !pProbeDown )
+            pWindow = pBestWindow;
+          else
+            pBestWindow = pWindow;
+          pProbeDown = true;
+          pWindow   -= latency > 2 * pMinLatency ? pWindow / 4 : pWindow / 8;
+        }
+
+        uint64_t minWindow = pMinChunk;
+        uint64_t maxWindow = uint64_t( pMaxChunk ) * pMaxParallel;
+        pWindow = std::max( minWindow, std::min( maxWindow, pWindow ) );
+
+        uint64_t parallel = ( pWindow + pBaseChunk - 1 ) / pBaseChunk;
+        parallel   = std::max<uint64_t>( 1, std::min<uint64_t>( parallel,
+                                                                pMaxParallel ) );
+        pParallel  = parallel;
+        pChunkSize = std::max<uint64_t>( pMinChunk,
+                       std::min<uint64_t>( pMaxChunk, pWindow / parallel ) );
+      }
+
+      uint32_t pBaseChunk;
+      uint32_t pMinChunk;
+      uint32_t pMaxChunk;
+      uint8_t  pMaxParallel;
+      uint32_t pChunkSize;
+      uint8_t  pParallel;
+      uint64_t pWindow;
+      bool     pSlowStart;
+      bool     pProbeDown;
+      double   pBest;
+      uint64_t pBestWindow;
+      timeval  pEpochStart;
+      uint64_t pEpochBytes;
+      uint32_t pEpochChunks;
+      uint64_t pEpochLatency;
+      uint64_t pMinLatency;
+  };
+
   //----------------------------------------------------------------------------
   //! Check sum helper for stdio
   //----------------------------------------------------------------------------
@@ -108,6 +301,21 @@ namespace
           pCksCalcObj->Update( (const char *)buffer, size );
       }
 
+      //------------------------------------------------------------------------
+      // Update the checksum with a run of zeros (a hole)
+      //------------------------------------------------------------------------
+      void UpdateZeros( uint64_t size )
+      {
+        if( !pCksCalcObj )
+          return;
+        while( size )
+        {
+          uint32_t n = std::min<uint64_t>( size, ZeroBufferSize );
+          pCksCalcObj->Update( ZeroBuffer(), n );
+          size -= n;
+        }
+      }
+
       //------------------------------------------------------------------------
       // Get checksum
       //------------------------------------------------------------------------
@@ -182,9 +390,20 @@ namespace
       //------------------------------------------------------------------------
       virtual int64_t GetSize() = 0;
 
+      //------------------------------------------------------------------------
+      //! Check if the source hands on holes, which should stay unallocated
+      //------------------------------------------------------------------------
+      virtual bool IsSparse()
+      {
+        return false;
+      }
+
       //------------------------------------------------------------------------
       //! Get a data chunk from the source
       //!
+      //! A chunk with a null buffer is a hole: length bytes of zeros that
+      //! the destination may skip
+      //!
       //! @param  ci     chunk information
       //! @return        status of the operation
       //!                suContinue - there are some chunks left
@@ -209,7 +428,8 @@ namespace
       //! Constructor
       //------------------------------------------------------------------------
       Destination():
-        pPosc( false ), pForce( false ), pCoerce( false ), pMakeDir( false ) {}
+        pPosc( false ), pForce( false ), pCoerce( false ), pMakeDir( false ),
+        pSize( -1 ) {}
 
       //------------------------------------------------------------------------
       //! Destructor
@@ -277,11 +497,20 @@ namespace
         pMakeDir = makedir;
       }
 
+      //------------------------------------------------------------------------
+      //! Set the size the file will have, -1 if unknown
+      //------------------------------------------------------------------------
+      void SetSize( int64_t size )
+      {
+        pSize = size;
+      }
+
     protected:
-      bool pPosc;
-      bool pForce;
-      bool pCoerce;
-      bool pMakeDir;
+      bool    pPosc;
+      bool    pForce;
+      bool    pCoerce;
+      bool    pMakeDir;
+      int64_t pSize;
   };
 
   //----------------------------------------------------------------------------
@@ -294,10 +523,16 @@ namespace
       //! Constructor
       //------------------------------------------------------------------------
       LocalSource( const XrdCl::URL *url, const std::string &ckSumType,
-                   uint32_t chunkSize ):
+                   uint32_t chunkSize, bool sparse,
+                   ChunkController *ctrl ):
         pPath( url->GetPath() ), pFD( -1 ), pSize( -1 ), pCurrentOffset( 0 ),
-        pCkSumHelper(0), pChunkSize( chunkSize )
+        pCkSumHelper(0), pChunkSize( chunkSize ), pCtrl( ctrl ),
+        pSparse( sparse ),
+        pHasHoles( true ), pDataEnd( 0 )
       {
+#ifndef SEEK_DATA
+        pSparse = false;
+#endif
         if( !ckSumType.empty() )
           pCkSumHelper = new CheckSumHelper( url->GetPath(), ckSumType );
       }
@@ -350,6 +585,8 @@ namespace
         }
         pFD   = fd;
         pSize = st.st_size;
+        if( (uint64_t)st.st_blocks * 512 >= (uint64_t)st.st_size )
+          pHasHoles = false;
 
         return XRootDStatus();
       }
@@ -362,6 +599,14 @@ namespace
         return pSize;
       }
 
+      //------------------------------------------------------------------------
+      //! Check if the source hands on holes
+      //------------------------------------------------------------------------
+      virtual bool IsSparse()
+      {
+        return pSparse && pHasHoles;
+      }
+
       //------------------------------------------------------------------------
       //! Get a data chunk from the source
       //------------------------------------------------------------------------
@@ -373,10 +618,55 @@ namespace
         if( pFD == -1 )
           return XRootDStatus( stError, errUninitialized );
 
-        const uint32_t toRead = pChunkSize;
+        uint32_t toRead = pCtrl ? pCtrl->ChunkSize() : pChunkSize;
+        if( pSparse )
+        {
+          //--------------------------------------------------------------------
+          // Find the next data extent, a hole before it is handed on as
+          // a chunk without a buffer
+          //--------------------------------------------------------------------
+#ifdef SEEK_DATA
+          if( pCurrentOffset >= pDataEnd )
+          {
+            off_t data = lseek( pFD, pCurrentOffset, SEEK_DATA );
+            if( data == -1 && errno == ENXIO )
+              data = std::max<int64_t>( pSize, pCurrentOffset );
+            if( data == -1 )
+            {
+              log->Debug( UtilityMsg, "No extent information for %s, "
+                          "copying holes: %s", pPath.c_str(),
+                          strerror( errno ) );
+              pSparse = false;
+            }
+            else if( (uint64_t)data > pCurrentOffset )
+            {
+              uint64_t hole = std::min<uint64_t>( data - pCurrentOffset,
+                                                  MaxHoleChunk );
+              if( pCkSumHelper )
+                pCkSumHelper->UpdateZeros( hole );
+              ci.offset = pCurrentOffset;
+              ci.length = hole;
+              ci.buffer = 0;
+              pCurrentOffset += hole;
+              return XRootDStatus( stOK, suContinue );
+            }
+            else
+            {
+              off_t hole = lseek( pFD, data, SEEK_HOLE );
+              pDataEnd = hole == -1 ? (uint64_t)-1 : hole;
+            }
+          }
+#endif
+          if( pSparse && pDataEnd - pCurrentOffset < toRead )
+            toRead = pDataEnd - pCurrentOffset;
+        }
+
         char *buffer = new char[toRead];
 
-        int64_t bytesRead = read( pFD, buffer, toRead );
+        int64_t bytesRead;
+        do
+          bytesRead = pread( pFD, buffer, toRead, pCurrentOffset );
+        while( bytesRead == -1 && errno == EINTR );
         if( bytesRead == -1 )
         {
           log->Debug( UtilityMsg, "Unable to read from %s: %s",
@@ -424,6 +714,10 @@ namespace
       uint64_t        pCurrentOffset;
       CheckSumHelper *pCkSumHelper;
       uint32_t        pChunkSize;
+      ChunkController *pCtrl;
+      bool            pSparse;
+      bool            pHasHoles;
+      uint64_t        pDataEnd;
   };
 
   //----------------------------------------------------------------------------
@@ -546,12 +840,18 @@ namespace
       //------------------------------------------------------------------------
       //! Constructor
       //------------------------------------------------------------------------
+      //!
+      //! With a controller the chunk size and the number of chunks in flight
+      //! follow it, if measure is set the source also feeds it
+      //------------------------------------------------------------------------
       XRootDSource( const XrdCl::URL *url,
                     uint32_t          chunkSize,
-                    uint8_t           parallelChunks ):
+                    uint8_t           parallelChunks,
+                    ChunkController  *ctrl,
+                    bool              measure ):
         pUrl( url ), pFile( new XrdCl::File() ), pSize( -1 ),
         pCurrentOffset( 0 ), pChunkSize( chunkSize ),
-        pParallel( parallelChunks )
+        pParallel( parallelChunks ), pCtrl( ctrl ), pMeasure( measure )
       {
       }
 
@@ -625,9 +925,11 @@ namespace
         //----------------------------------------------------------------------
         // Fill the queue
         //----------------------------------------------------------------------
-        while( pChunks.size() < pParallel && pCurrentOffset < pSize )
+        uint8_t  parallel = pCtrl ? pCtrl->Parallel() : pParallel;
+        uint32_t size     = pCtrl ? pCtrl->ChunkSize() : pChunkSize;
+        while( pChunks.size() < parallel && pCurrentOffset < pSize )
         {
-          uint64_t chunkSize = pChunkSize;
+          uint64_t chunkSize = size;
           if( pCurrentOffset + chunkSize > (uint64_t)pSize )
             chunkSize = pSize - pCurrentOffset;
 
@@ -666,6 +968,9 @@ namespace
           return ch->status;
         }
 
+        if( pCtrl && pMeasure )
+          pCtrl->Done( ch->chunk.length,
+                       Utils::GetElapsedMicroSecs( ch->start, ch->end ) );
         ci = ch->chunk;
         return XRootDStatus( stOK, suContinue );
       }
@@ -706,11 +1011,16 @@ namespace
       class ChunkHandler: public XrdCl::ResponseHandler
       {
         public:
-          ChunkHandler(): sem( new XrdCl::Semaphore(0) ) {}
+          ChunkHandler(): sem( new XrdCl::Semaphore(0) )
+          {
+            gettimeofday( &start, 0 );
+            end = start;
+          }
           virtual ~ChunkHandler() { delete sem; }
           virtual void HandleResponse( XrdCl::XRootDStatus *statusval,
                                        XrdCl::AnyObject    *response )
           {
+            gettimeofday( &end, 0 );
             this->status = *statusval;
             delete statusval;
             if( response )
@@ -727,6 +1037,8 @@ namespace
         XrdCl::Semaphore    *sem;
         XrdCl::ChunkInfo     chunk;
         XrdCl::XRootDStatus  status;
+        timeval              start;
+        timeval              end;
       };
       const XrdCl::URL           *pUrl;
       XrdCl::File                *pFile;
@@ -734,6 +1046,8 @@ namespace
       int64_t                     pCurrentOffset;
       uint32_t                    pChunkSize;
       uint8_t                     pParallel;
+      ChunkController            *pCtrl;
+      bool                        pMeasure;
       std::queue<ChunkHandler *>  pChunks;
   };
 
@@ -877,7 +1191,8 @@ namespace
       //! Constructor
       //------------------------------------------------------------------------
       LocalDestination( const XrdCl::URL *url ):
-        pPath( url->GetPath() ), pFD( -1 )
+        pPath( url->GetPath() ), pFD( -1 ), pEnd( 0 ), pBlockSize( 4096 ),
+        pPreallocated( false ), pTailOffset( 0 )
       {
       }
 
@@ -927,6 +1242,29 @@ namespace
         }
 
         pFD   = fd;
+
+        //----------------------------------------------------------------------
+        // Writes go out in multiples of the preferred I/O size of the file
+        // system (the stripe size on Lustre)
+        //----------------------------------------------------------------------
+        struct stat st;
+        if( fstat( fd, &st ) == 0 && st.st_blksize > 0 )
+          pBlockSize = st.st_blksize;
+
+        //----------------------------------------------------------------------
+        // Allocate the whole file up front, so it is laid out contiguously.
+        // The size is kept, Finalize cuts what was not written.
+        //----------------------------------------------------------------------
+#ifdef FALLOC_FL_KEEP_SIZE
+        if( pSize > 0 )
+        {
+          if( fallocate( fd, FALLOC_FL_KEEP_SIZE, 0, pSize ) == 0 )
+            pPreallocated = true;
+          else
+            log->Debug( UtilityMsg, "Unable to preallocate %ld bytes for "
+                        "%s: %s", pSize, pPath.c_str(), strerror( errno ) );
+        }
+#endif
         return XRootDStatus();
       }
 
@@ -938,7 +1276,28 @@ namespace
         using namespace XrdCl;
         if( pFD != -1 )
         {
+          XRootDStatus st = FlushTail();
           int fd = pFD; pFD = -1;
+          if( !st.IsOK() )
+          {
+            Discard( fd );
+            return st;
+          }
+
+          //--------------------------------------------------------------------
+          // A hole at the end of the source was not written, extend the file;
+          // a preallocated one gives back the blocks of a short copy
+          //--------------------------------------------------------------------
+          struct stat sb;
+          if( ( pPreallocated ||
+                ( fstat( fd, &sb ) == 0 && (uint64_t)sb.st_size < pEnd ) ) &&
+              ftruncate( fd, pEnd ) != 0 )
+          {
+            int err = errno;
+            close( fd );
+            return XRootDStatus( stError, errOSError, err );
+          }
+
           if( close( fd ) != 0 )
             return XRootDStatus( stError, errOSError, errno );
         }
@@ -960,31 +1319,27 @@ namespace
         if( pFD == -1 )
           return XRootDStatus( stError, errUninitialized );
 
-        int64_t   wr     = 0;
-        uint64_t  offset = ci.offset;
-        uint32_t  length = ci.length;
-        char     *cursor = (char*)ci.buffer;
-        do
+        //----------------------------------------------------------------------
+        // The file was created empty, skipping a hole leaves one
+        //----------------------------------------------------------------------
+        XRootDStatus st;
+        if( !ci.buffer )
+          st = FlushTail();
+        else
+          st = WriteAligned( (char*)ci.buffer, ci.length, ci.offset );
+        delete [] (char*)ci.buffer; ci.buffer = 0;
+
+        if( !st.IsOK() )
         {
-          wr = pwrite( pFD, cursor, length, offset );
-          if( wr == -1 )
-          {
-            log->Debug( UtilityMsg, "Unable to write to %s: %s", pPath.c_str(),
-                        strerror( errno ) );
-            close( pFD );
-            pFD = -1;
-            if( pPosc )
-              unlink( pPath.c_str() );
-            delete [] (char*)ci.buffer; ci.buffer = 0;
-            return XRootDStatus( stError, errOSError, errno );
-          }
-          offset += wr;
-          cursor += wr;
-          length -= wr;
+          log->Debug( UtilityMsg, "Unable to write to %s: %s", pPath.c_str(),
+                      strerror( st.errNo ) );
+          int fd = pFD; pFD = -1;
+          Discard( fd );
+          return st;
         }
-        while( length );
 
-        delete [] (char*)ci.buffer; ci.buffer = 0;
+        if( ci.offset + ci.length > pEnd )
+          pEnd = ci.offset + ci.length;
         return XRootDStatus();
       }
 
@@ -1065,8 +1420,118 @@ namespace
       LocalDestination(const LocalDestination &other);
       LocalDestination &operator = (const LocalDestination &other);
 
-      std::string pPath;
-      int         pFD;
+      //------------------------------------------------------------------------
+      //! Write all of length bytes at offset
+      //------------------------------------------------------------------------
+      XrdCl::XRootDStatus WriteAll( const char *cursor, uint64_t length,
+                                    uint64_t offset )
+      {
+        using namespace XrdCl;
+        while( length )
+        {
+          int64_t wr = pwrite( pFD, cursor, length, offset );
+          if( wr == -1 && errno == EINTR )
+            continue;
+          if( wr == -1 )
+            return XRootDStatus( stError, errOSError, errno );
+          offset += wr;
+          cursor += wr;
+          length -= wr;
+        }
+        return XRootDStatus();
+      }
+
+      //------------------------------------------------------------------------
+      //! Write a chunk in whole blocks, a partial block at the end is kept
+      //! until the next chunk completes it or the file is finalized
+      //------------------------------------------------------------------------
+      XrdCl::XRootDStatus WriteAligned( const char *buffer, uint64_t length,
+                                        uint64_t offset )
+      {
+        using namespace XrdCl;
+        XRootDStatus st;
+        if( !pTail.empty() && pTailOffset + pTail.size() != offset )
+        {
+          st = FlushTail();
+          if( !st.IsOK() )
+            return st;
+        }
+
+        //----------------------------------------------------------------------
+        // Complete the kept block first
+        //----------------------------------------------------------------------
+        if( !pTail.empty() )
+        {
+          uint64_t n = std::min<uint64_t>( length, pBlockSize - pTail.size() );
+          pTail.insert( pTail.end(), buffer, buffer + n );
+          buffer += n; offset += n; length -= n;
+          if( pTail.size() < pBlockSize )
+            return st;
+          st = FlushTail();
+          if( !st.IsOK() )
+            return st;
+        }
+
+        //----------------------------------------------------------------------
+        // A chunk not starting on a block boundary is written up to the next
+        // one as it is
+        //----------------------------------------------------------------------
+        if( offset % pBlockSize )
+        {
+          uint64_t n = std::min<uint64_t>( length,
+                                           pBlockSize - offset % pBlockSize );
+          st = WriteAll( buffer, n, offset );
+          if( !st.IsOK() )
+            return st;
+          buffer += n; offset += n; length -= n;
+        }
+
+        uint64_t whole = length - length % pBlockSize;
+        st = WriteAll( buffer, whole, offset );
+        if( !st.IsOK() )
+          return st;
+        if( length > whole )
+        {
+          pTailOffset = offset + whole;
+          pTail.assign( buffer + whole, buffer + length );
+        }
+        return st;
+      }
+
+      //------------------------------------------------------------------------
+      //! Write the partial block kept by WriteAligned
+      //------------------------------------------------------------------------
+      XrdCl::XRootDStatus FlushTail()
+      {
+        if( pTail.empty() )
+          return XrdCl::XRootDStatus();
+        XrdCl::XRootDStatus st = WriteAll( &pTail[0], pTail.size(),
+                                           pTailOffset );
+        pTail.clear();
+        return st;
+      }
+
+      //------------------------------------------------------------------------
+      //! Close the file after a failure, giving back preallocated blocks
+      //------------------------------------------------------------------------
+      void Discard( int fd )
+      {
+        if( pPosc )
+          unlink( pPath.c_str() );
+        else if( pPreallocated && ftruncate( fd, pEnd ) != 0 )
+          XrdCl::DefaultEnv::GetLog()->Debug( XrdCl::UtilityMsg, "Unable to "
+                                  "truncate %s: %s", pPath.c_str(),
+                                  strerror( errno ) );
+        close( fd );
+      }
+
+      std::string       pPath;
+      int               pFD;
+      uint64_t          pEnd;
+      uint64_t          pBlockSize;
+      bool              pPreallocated;
+      std::vector<char> pTail;
+      uint64_t          pTailOffset;
   };
 
   //----------------------------------------------------------------------------
@@ -1124,6 +1589,26 @@ namespace
           return XRootDStatus( stError, errInternal );
         }
 
+        //----------------------------------------------------------------------
+        // A hole has to be written out as zeros
+        //----------------------------------------------------------------------
+        if( !ci.buffer )
+        {
+          uint32_t left = ci.length;
+          while( left )
+          {
+            uint32_t  n = std::min( left, ZeroBufferSize );
+            ChunkInfo zeros( ci.offset + ci.length - left, n,
+                             new char[n] );
+            memset( zeros.buffer, 0, n );
+            XRootDStatus st = PutChunk( zeros );
+            if( !st.IsOK() )
+              return st;
+            left -= n;
+          }
+          return XRootDStatus();
+        }
+
         int64_t   wr     = 0;
         uint32_t  length = ci.length;
         char     *cursor = (char*)ci.buffer;
@@ -1181,8 +1666,14 @@ namespace
       //------------------------------------------------------------------------
       //! Constructor
       //------------------------------------------------------------------------
-      XRootDDestination( const XrdCl::URL *url, uint8_t parallelChunks ):
-        pUrl( url ), pFile( new XrdCl::File() ), pParallel( parallelChunks )
+      //!
+      //! With a controller the number of chunks in flight follows it and the
+      //! completed writes feed it
+      //------------------------------------------------------------------------
+      XRootDDestination( const XrdCl::URL *url, uint8_t parallelChunks,
+                         bool sparse, ChunkController *ctrl ):
+        pUrl( url ), pFile( new XrdCl::File() ), pParallel( parallelChunks ),
+        pSparse( sparse ), pEnd( 0 ), pWrittenEnd( 0 ), pCtrl( ctrl )
       {
       }
 
@@ -1234,6 +1725,15 @@ namespace
       //------------------------------------------------------------------------
       virtual XrdCl::XRootDStatus Finalize()
       {
+        //----------------------------------------------------------------------
+        // Holes and zero runs at the end were not sent, set the size
+        //----------------------------------------------------------------------
+        if( pEnd > pWrittenEnd )
+        {
+          XrdCl::XRootDStatus st = pFile->Truncate( pEnd );
+          if( !st.IsOK() )
+            return st;
+        }
         return pFile->Close();
       }
 
@@ -1250,27 +1750,44 @@ namespace
           return XRootDStatus( stError, errUninitialized );
 
         //----------------------------------------------------------------------
-        // If there is still place for this chunk to be sent send it
+        // Holes and chunks of zeros are not sent, the file is new so the
+        // range reads back as zeros
         //----------------------------------------------------------------------
-        if( pChunks.size() < pParallel )
-          return QueueChunk( ci );
+        if( ci.offset + ci.length > pEnd )
+          pEnd = ci.offset + ci.length;
+        if( !ci.buffer || ( pSparse && IsZero( (char*)ci.buffer, ci.length ) ) )
+        {
+          delete [] (char*)ci.buffer; ci.buffer = 0;
+          return XRootDStatus();
+        }
+        if( ci.offset + ci.length > pWrittenEnd )
+          pWrittenEnd = ci.offset + ci.length;
 
         //----------------------------------------------------------------------
-        // We wait for a chunk to be sent so that we have space for the current
-        // one
+        // We wait for chunks to be sent until there is space for the current
+        // one, more than one if the controller lowered the depth
         //----------------------------------------------------------------------
-        XRDCL_SMART_PTR_T<ChunkHandler> ch( pChunks.front() );
-        pChunks.pop();
-        ch->sem->Wait();
-        delete [] (char*)ch->chunk.buffer;
-        if( !ch->status.IsOK() )
+        uint8_t parallel = pCtrl ? pCtrl->Parallel() : pParallel;
+        while( pChunks.size() >= parallel )
         {
-          Log *log = DefaultEnv::GetLog();
-          log->Debug( UtilityMsg, "Unable write %d bytes at %ld from %s: %s",
-                      ch->chunk.length, ch->chunk.offset,
-                      pUrl->GetURL().c_str(), ch->status.ToStr().c_str() );
-          CleanUpChunks();
-          return ch->status;
+          XRDCL_SMART_PTR_T<ChunkHandler> ch( pChunks.front() );
+          pChunks.pop();
+          ch->sem->Wait();
+          delete [] (char*)ch->chunk.buffer;
+          if( !ch->status.IsOK() )
+          {
+            Log *log = DefaultEnv::GetLog();
+            log->Debug( UtilityMsg, "Unable write %d bytes at %ld from %s: %s",
+                        ch->chunk.length, ch->chunk.offset,
+                        pUrl->GetURL().c_str(), ch->status.ToStr().c_str() );
+            CleanUpChunks();
+            delete [] (char*)ci.buffer;
+            ci.buffer = 0;
+            return ch->status;
+          }
+          if( pCtrl )
+            pCtrl->Done( ch->chunk.length,
+                         Utils::GetElapsedMicroSecs( ch->start, ch->end ) );
         }
         return QueueChunk( ci );
       }
@@ -1352,11 +1869,16 @@ namespace
         public:
           ChunkHandler( XrdCl::ChunkInfo ci ):
             sem( new XrdCl::Semaphore(0) ),
-            chunk(ci) {}
+            chunk(ci)
+          {
+            gettimeofday( &start, 0 );
+            end = start;
+          }
           virtual ~ChunkHandler() { delete sem; }
           virtual void HandleResponse( XrdCl::XRootDStatus *statusval,
                                        XrdCl::AnyObject    */*response*/ )
           {
+            gettimeofday( &end, 0 );
             this->status = *statusval;
             delete statusval;
             sem->Post();
@@ -1365,11 +1887,17 @@ namespace
           XrdCl::Semaphore       *sem;
           XrdCl::ChunkInfo        chunk;
           XrdCl::XRootDStatus     status;
+          timeval                 start;
+          timeval                 end;
       };
 
       const XrdCl::URL           *pUrl;
       XrdCl::File                *pFile;
       uint8_t                     pParallel;
+      bool                        pSparse;
+      uint64_t                    pEnd;
+      uint64_t                    pWrittenEnd;
+      ChunkController            *pCtrl;
       std::queue<ChunkHandler *>  pChunks;
   };
 }
@@ -1402,6 +1930,11 @@ namespace XrdCl
     uint16_t    parallelChunks;
     uint32_t    chunkSize;
     bool        posc, force, coerce, makeDir, dynamicSource;
+    int         sparse = DefaultCPSparse;
+    int         adaptive = DefaultCPAdaptive;
+    int         minChunk = DefaultCPMinChunkSize;
+    int         maxChunk = DefaultCPMaxChunkSize;
+    int         maxParallel = DefaultCPMaxParallelChunks;
 
     pProperties->Get( "checkSumMode",    checkSumMode );
     pProperties->Get( "checkSumType",    checkSumType );
@@ -1413,13 +1946,58 @@ namespace XrdCl
     pProperties->Get( "coerce",          coerce );
     pProperties->Get( "makeDir",         makeDir );
     pProperties->Get( "dynamicSource",   dynamicSource );
+    DefaultEnv::GetEnv()->GetInt( "CPSparse", sparse );
+    DefaultEnv::GetEnv()->GetInt( "CPAdaptive", adaptive );
+    DefaultEnv::GetEnv()->GetInt( "CPMinChunkSize", minChunk );
+    DefaultEnv::GetEnv()->GetInt( "CPMaxChunkSize", maxChunk );
+    DefaultEnv::GetEnv()->GetInt( "CPMaxParallelChunks", maxParallel );
+
+    //--------------------------------------------------------------------------
+    // Chunks to or from xrootd follow the measured throughput, the remote
+    // end feeds the controller, the destination if both are remote
+    //--------------------------------------------------------------------------
+    bool remoteSrc = GetSource().GetProtocol() != "file" &&
+                     GetSource().GetProtocol() != "stdio" && !dynamicSource;
+    bool remoteDst = GetTarget().GetProtocol() != "file" &&
+                     GetTarget().GetProtocol() != "stdio";
+    XRDCL_SMART_PTR_T<ChunkController> ctrl;
+    if( adaptive && ( remoteSrc || remoteDst ) )
+      ctrl.reset( new ChunkController( chunkSize, parallelChunks,
+                                       std::max( minChunk, 4096 ),
+                                       std::max( maxChunk, 4096 ),
+                                       std::min( std::max( maxParallel, 1 ),
+                                                 255 ) ) );
+
+    //--------------------------------------------------------------------------
+    // A file on a local mount, either a local source or one a file system
+    // plug-in maps, goes to stdout without passing through our buffers,
+    // unless the data is needed for a checksum
+    //--------------------------------------------------------------------------
+    if( GetTarget().GetProtocol() == "stdio" &&
+        GetSource().GetProtocol() != "stdio" && checkSumMode == "none" )
+    {
+      std::string localPath;
+      if( GetSource().GetProtocol() == "file" )
+        localPath = GetSource().GetPath();
+      else
+        Utils::GetLocalPath( GetSource(), localPath );
+
+      if( !localPath.empty() )
+      {
+        bool done = false;
+        XRootDStatus st = SpliceToStdOut( localPath, progress, done );
+        if( done )
+          return st;
+      }
+    }
 
     //--------------------------------------------------------------------------
     // Initialize the source and the destination
     //--------------------------------------------------------------------------
     XRDCL_SMART_PTR_T<Source> src;
     if( GetSource().GetProtocol() == "file" )
-      src.reset( new LocalSource( &GetSource(), checkSumType, chunkSize ) );
+      src.reset( new LocalSource( &GetSource(), checkSumType, chunkSize,
+                                  sparse, ctrl.get() ) );
     else if( GetSource().GetProtocol() == "stdio" )
       src.reset( new StdInSource( checkSumType, chunkSize ) );
     else
@@ -1427,7 +2005,8 @@ namespace XrdCl
       if( dynamicSource )
         src.reset( new XRootDSourceDynamic( &GetSource(), chunkSize ) );
       else
-        src.reset( new XRootDSource( &GetSource(), chunkSize, parallelChunks ) );
+        src.reset( new XRootDSource( &GetSource(), chunkSize, parallelChunks,
+                                     ctrl.get(), !remoteDst ) );
     }
 
     XRootDStatus st = src->Initialize();
@@ -1453,13 +2032,16 @@ namespace XrdCl
         newDestUrl.SetParams( params );
  //     makeDir = true; // Backward compatability for xroot destinations!!!
       }
-      dest.reset( new XRootDDestination( &newDestUrl, parallelChunks ) );
+      dest.reset( new XRootDDestination( &newDestUrl, parallelChunks,
+                                         sparse, ctrl.get() ) );
     }
 
     dest->SetForce( force );
     dest->SetPOSC(  posc );
     dest->SetCoerce( coerce );
     dest->SetMakeDir( makeDir );
+    if( !src->IsSparse() )
+      dest->SetSize( src->GetSize() );
     st = dest->Initialize();
     if( !st.IsOK() ) return st;
 
@@ -1590,4 +2172,63 @@ namespace XrdCl
     }
     return XRootDStatus();
   }
+
+  //----------------------------------------------------------------------------
+  // Send a file on a local mount to stdout in the kernel
+  //----------------------------------------------------------------------------
+  XRootDStatus ClassicCopyJob::SpliceToStdOut( const std::string   &path,
+                                               CopyProgressHandler *progress,
+                                               bool                &done )
+  {
+    Log *log = DefaultEnv::GetLog();
+    done = false;
+
+    int fd = open( path.c_str(), O_RDONLY );
+    if( fd == -1 )
+      return XRootDStatus( stError, errOSError, errno );
+    ScopedDescriptor fdGuard( fd );
+
+    struct stat st;
+    if( fstat( fd, &st ) == -1 || !S_ISREG( st.st_mode ) )
+      return XRootDStatus( stError, errOSError, errno );
+
+    log->Debug( UtilityMsg, "Splicing %s to stdout", path.c_str() );
+
+    uint64_t size   = st.st_size;
+    uint64_t offset = 0;
+    while( offset < size )
+    {
+      int64_t moved = Utils::SpliceFile( 1, fd, offset,
+                                         std::min<uint64_t>( size - offset,
+                                                             SpliceChunk ) );
+      if( moved == -1 )
+      {
+        XRootDStatus err( stError, errOSError, errno );
+        if( offset == 0 && ( errno == EINVAL || errno == ENOSYS ) )
+        {
+          log->Debug( UtilityMsg, "Cannot splice to stdout, copying: %s",
+                      strerror( errno ) );
+          return err;
+        }
+        done = true;
+        log->Debug( UtilityMsg, "Unable to splice %s to stdout: %s",
+                    path.c_str(), strerror( errno ) );
+        return err;
+      }
+
+      if( moved == 0 )
+        break;
+      if( progress ) progress->JobProgress( pJobId, offset, size );
+    }
+    done = true;
+
+    if( offset != size )
+    {
+      log->Error( UtilityMsg, "The declared source size is %ld bytes, but "
+                  "received %ld bytes.", size, offset );
+      return XRootDStatus( stError, errDataError );
+    }
+    pResults->Set( "size", offset );
+    return XRootDStatus();
+  }
 }
@@ -41,6 +41,17 @@ namespace XrdCl
       //! @return         status of the copy operation
       //------------------------------------------------------------------------
       virtual XRootDStatus Run( CopyProgressHandler *progress = 0 );
+
+    private:
+      //------------------------------------------------------------------------
+      //! Send a file on a local mount to stdout in the kernel
+      //!
+      //! @param done false if the descriptors cannot do it and nothing has
+      //!             been written, the chunks have to be copied then
+      //------------------------------------------------------------------------
+      XRootDStatus SpliceToStdOut( const std::string   &path,
+                                   CopyProgressHandler *progress,
+                                   bool                &done );
   };
 }
 
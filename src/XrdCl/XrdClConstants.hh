@@ -64,6 +64,11 @@ namespace XrdCl
   const int DefaultTCPKeepAliveProbes   = 9;
   const int DefaultMultiProtocol        = 0;
   const int DefaultParallelEvtLoop      = 1;
+  const int DefaultCPSparse             = 0;
+  const int DefaultCPAdaptive           = 0;
+  const int DefaultCPMinChunkSize       = 1048576;
+  const int DefaultCPMaxChunkSize       = 67108864;
+  const int DefaultCPMaxParallelChunks  = 16;
 
   const char * const DefaultPollerPreference   = "built-in";
   const char * const DefaultNetworkStack       = "IPAuto";
@@ -30,11 +30,20 @@
 #include "XrdCl/XrdClLog.hh"
 #include "XrdCl/XrdClFileSystem.hh"
 #include "XrdCl/XrdClUtils.hh"
+#include "XrdCl/XrdClUglyHacks.hh"
 #include "XrdSys/XrdSysPthread.hh"
 
 #include <iostream>
 #include <iomanip>
 #include <limits>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
 
 //------------------------------------------------------------------------------
 // Progress notifier
@@ -46,7 +55,8 @@ class ProgressDisplay: public XrdCl::CopyProgressHandler
     //! Constructor
     //--------------------------------------------------------------------------
     ProgressDisplay(): pPrevious(0), pPrintProgressBar(true),
-      pPrintSourceCheckSum(false), pPrintTargetCheckSum(false)
+      pPrintSourceCheckSum(false), pPrintTargetCheckSum(false),
+      pJobsDone(0), pJobsTotal(0), pBytesProcessed(0), pBytesTotal(0)
     {}
 
     //--------------------------------------------------------------------------
@@ -58,6 +68,7 @@ class ProgressDisplay: public XrdCl::CopyProgressHandler
                            const XrdCl::URL *destination )
     {
       XrdSysMutexHelper scopedLock( pMutex );
+      pJobsTotal = jobTotal;
       if( pPrintProgressBar )
       {
         if( jobTotal > 1 )
@@ -93,6 +104,7 @@ class ProgressDisplay: public XrdCl::CopyProgressHandler
       // the case when processing stdio since we throttle printing and don't
       // know the total size
       JobProgress( jobNum, d.bytesProcessed, d.bytesTotal );
+      ++pJobsDone;
 
       if( pPrintProgressBar )
       {
@@ -178,6 +190,10 @@ class ProgressDisplay: public XrdCl::CopyProgressHandler
       std::map<uint16_t, JobData>::iterator it;
       std::ostringstream o;
 
+      o << "[" << pJobsDone << "/" << pJobsTotal << " files, ";
+      o << XrdCl::Utils::BytesToString(pBytesProcessed) << "B/";
+      o << XrdCl::Utils::BytesToString(pBytesTotal) << "B] ";
+
       for( it = pOngoingJobs.begin(); it != pOngoingJobs.end(); ++it )
       {
         JobData  &d      = it->second;
@@ -210,6 +226,19 @@ class ProgressDisplay: public XrdCl::CopyProgressHandler
     {
       XrdSysMutexHelper scopedLock( pMutex );
 
+      std::map<uint16_t, JobData>::iterator it = pOngoingJobs.find( jobNum );
+      if( it == pOngoingJobs.end() )
+        return;
+
+      //------------------------------------------------------------------------
+      // The totals of all the jobs, shown in the summary bar
+      //------------------------------------------------------------------------
+      JobData &d = it->second;
+      pBytesProcessed += bytesProcessed - d.bytesProcessed;
+      pBytesTotal     += bytesTotal - d.bytesTotal;
+      d.bytesProcessed = bytesProcessed;
+      d.bytesTotal     = bytesTotal;
+
       if( pPrintProgressBar )
       {
         time_t now = time(0);
@@ -217,15 +246,6 @@ class ProgressDisplay: public XrdCl::CopyProgressHandler
           return;
         pPrevious = now;
 
-        std::map<uint16_t, JobData>::iterator it = pOngoingJobs.find( jobNum );
-        if( it == pOngoingJobs.end() )
-          return;
-
-        JobData &d = it->second;
-
-        d.bytesProcessed = bytesProcessed;
-        d.bytesTotal     = bytesTotal;
-
         std::string progress;
         if( pOngoingJobs.size() == 1 )
           progress = GetProgressBar( now );
@@ -284,6 +304,10 @@ class ProgressDisplay: public XrdCl::CopyProgressHandler
     bool                        pPrintProgressBar;
     bool                        pPrintSourceCheckSum;
     bool                        pPrintTargetCheckSum;
+    uint32_t                    pJobsDone;
+    uint32_t                    pJobsTotal;
+    uint64_t                    pBytesProcessed;
+    uint64_t                    pBytesTotal;
     std::map<uint16_t, JobData> pOngoingJobs;
     XrdSysRecMutex              pMutex;
 };
@@ -402,79 +426,193 @@ void AdjustFileInfo( XrdCpFile *file )
 };
 
 //------------------------------------------------------------------------------
-// Get a list of files and a list of directories inside a remote directory
+// Number of directory listings or target directories in flight during the
+// walk of a recursive copy
 //------------------------------------------------------------------------------
-XrdCl::XRootDStatus GetDirList( XrdCl::FileSystem        *fs,
-                                const XrdCl::URL         &url,
-                                std::vector<std::string> *&files,
-                                std::vector<std::string> *&directories )
+const uint16_t WalkWidth = 16;
+
+//------------------------------------------------------------------------------
+// Parallel walk of a remote directory tree
+//
+// Up to width directory listings are in flight at a time and the listing of
+// a directory queues its subdirectories as soon as it comes back, so the walk
+// is not gated by the latency of one listing after the other. On hosts the
+// client plug-in maps to a local mount the listings are read from the mount.
+//------------------------------------------------------------------------------
+class TreeWalk
 {
-  using namespace XrdCl;
-  DirectoryList *list;
-  XRootDStatus   status;
-  Log *log = DefaultEnv::GetLog();
+  public:
+    //--------------------------------------------------------------------------
+    //! A file or directory found, by URL
+    //--------------------------------------------------------------------------
+    struct Entry
+    {
+      Entry( const std::string &u, int64_t s ): url( u ), size( s ) {}
+      bool operator<( const Entry &other ) const { return url < other.url; }
+      std::string url;
+      int64_t     size;
+    };
 
-  status = fs->DirList( url.GetPath(), DirListFlags::Stat, list );
-  if( !status.IsOK() )
-  {
-    log->Error( AppMsg, "Error listing directory: %s",
-                        status.ToStr().c_str());
-    return status;
-  }
+    TreeWalk( XrdCl::FileSystem *fs, uint16_t width ):
+      pFs( fs ), pWidth( width ), pInFlight( 0 ), pCond( 0 ) {}
 
-  for ( DirectoryList::Iterator it = list->Begin(); it != list->End(); ++it )
-  {
-    if ( (*it)->GetStatInfo()->TestFlags( StatInfo::IsDir ) )
+    ~TreeWalk()
     {
-      std::string directory = (*it)->GetName();
-      directories->push_back( directory );
+      std::vector<ListHandler*>::iterator it;
+      for( it = pHandlers.begin(); it != pHandlers.end(); ++it )
+        delete *it;
     }
-    else
+
+    //--------------------------------------------------------------------------
+    //! Walk the tree below baseUrl, the files and directories found are
+    //! sorted by URL, parents before their children
+    //--------------------------------------------------------------------------
+    void Walk( const std::string &baseUrl )
+    {
+      XrdSysCondVarHelper scopedLock( pCond );
+      pPending.push_back( baseUrl );
+      while( !pPending.empty() || pInFlight )
+      {
+        while( !pPending.empty() && pInFlight < pWidth )
+        {
+          std::string dir = pPending.front();
+          pPending.pop_front();
+          ++pInFlight;
+          pCond.UnLock();
+          List( dir );
+          pCond.Lock();
+        }
+        if( pInFlight )
+          pCond.Wait();
+      }
+      std::sort( pFiles.begin(), pFiles.end() );
+      std::sort( pDirectories.begin(), pDirectories.end() );
+    }
+
+    const std::vector<Entry> &Files() const
     {
-      std::string file = (*it)->GetName();
-      files->push_back( file );
+      return pFiles;
     }
-  }
 
-  return XRootDStatus();
-}
+    const std::vector<Entry> &Directories() const
+    {
+      return pDirectories;
+    }
+
+  private:
+    //--------------------------------------------------------------------------
+    // Handler of one listing, kept by the walk since plug-ins may call it
+    // before they return an error
+    //--------------------------------------------------------------------------
+    class ListHandler: public XrdCl::ResponseHandler
+    {
+      public:
+        ListHandler( TreeWalk *walk, const std::string &dir ):
+          pWalk( walk ), pDir( dir ), pCalled( false ) {}
+
+        virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                     XrdCl::AnyObject    *response )
+        {
+          pCalled = true;
+          XrdCl::DirectoryList *list = 0;
+          if( status->IsOK() && response )
+            response->Get( list );
+          pWalk->Listed( pDir, *status, list );
+          delete status;
+          delete response;
+        }
+
+        bool Called() const
+        {
+          return pCalled;
+        }
+
+      private:
+        TreeWalk    *pWalk;
+        std::string  pDir;
+        bool         pCalled;
+    };
+
+    void List( const std::string &dir )
+    {
+      using namespace XrdCl;
+      Log *log = DefaultEnv::GetLog();
+      log->Debug( AppMsg, "Indexing %s", dir.c_str() );
+      ListHandler *handler = new ListHandler( this, dir );
+      {
+        XrdSysCondVarHelper scopedLock( pCond );
+        pHandlers.push_back( handler );
+      }
+      URL url( dir );
+      XRootDStatus st = pFs->DirList( url.GetPath(), DirListFlags::Stat,
+                                      handler );
+      if( !st.IsOK() && !handler->Called() )
+        Listed( dir, st, 0 );
+    }
+
+    void Listed( const std::string          &dir,
+                 const XrdCl::XRootDStatus  &status,
+                 XrdCl::DirectoryList       *list )
+    {
+      using namespace XrdCl;
+      Log *log = DefaultEnv::GetLog();
+      if( !status.IsOK() || !list )
+        log->Info( AppMsg, "Failed to get directory listing for %s: %s",
+                           dir.c_str(), status.GetErrorMessage().c_str() );
+
+      XrdSysCondVarHelper scopedLock( pCond );
+      if( list )
+      {
+        DirectoryList::Iterator it;
+        for( it = list->Begin(); it != list->End(); ++it )
+        {
+          std::string path = dir + "/" + (*it)->GetName();
+          StatInfo   *info = (*it)->GetStatInfo();
+          if( info && info->TestFlags( StatInfo::IsDir ) )
+          {
+            log->Dump( AppMsg, "Found directory %s", path.c_str() );
+            pDirectories.push_back( Entry( path, -1 ) );
+            pPending.push_back( path );
+          }
+          else
+          {
+            log->Dump( AppMsg, "Found file %s", path.c_str() );
+            pFiles.push_back( Entry( path, info ? (int64_t)info->GetSize()
+                                                : -1 ) );
+          }
+        }
+      }
+      --pInFlight;
+      pCond.Signal();
+    }
+
+    XrdCl::FileSystem       *pFs;
+    uint16_t                 pWidth;
+    uint16_t                 pInFlight;
+    std::deque<std::string>  pPending;
+    std::vector<Entry>       pFiles;
+    std::vector<Entry>       pDirectories;
+    std::vector<ListHandler*> pHandlers;
+    XrdSysCondVar            pCond;
+};
 
 //------------------------------------------------------------------------------
-// Recursively index all files and directories inside a remote directory
+// Turn the files found by a walk into a list of sources
 //------------------------------------------------------------------------------
-XrdCpFile *IndexRemote( XrdCl::FileSystem *fs,
-                        std::string        basePath,
-                        uint16_t           dirOffset )
+XrdCpFile *IndexRemote( const TreeWalk &walk, uint16_t dirOffset )
 {
   using namespace XrdCl;
 
   XrdCpFile   start;
   XrdCpFile  *end   = &start;
   XrdCpFile  *current;
-  URL         source( basePath );
   int         badUrl;
+  Log        *log = DefaultEnv::GetLog();
 
-  std::vector<std::string> *files       = new std::vector<std::string>();
-  std::vector<std::string> *directories = new std::vector<std::string>();
-
-  Log *log = DefaultEnv::GetLog();
-  log->Debug( AppMsg, "Indexing %s", basePath.c_str() );
-
-  XRootDStatus status = GetDirList( fs, source, files, directories );
-  if( !status.IsOK() )
+  std::vector<TreeWalk::Entry>::const_iterator it;
+  for( it = walk.Files().begin(); it != walk.Files().end(); ++it )
   {
-    log->Info( AppMsg, "Failed to get directory listing for %s: %s",
-                       source.GetURL().c_str(),
-                       status.GetErrorMessage().c_str() );
-  }
-
-  std::vector<std::string>::iterator it;
-  for( it = files->begin(); it != files->end(); ++it )
-  {
-    std::string file = basePath + "/" + (*it);
-    log->Dump( AppMsg, "Found file %s", file.c_str() );
-
-    current = new XrdCpFile( file.c_str(), badUrl );
+    current = new XrdCpFile( it->url.c_str(), badUrl );
     if( badUrl )
     {
       log->Error( AppMsg, "Bad URL: %s", current->Path );
@@ -485,19 +623,85 @@ XrdCpFile *IndexRemote( XrdCl::FileSystem *fs,
     end->Next     = current;
     end           = current;
   }
+  return start.Next;
+}
 
-  for( it = directories->begin(); it != directories->end(); ++it )
-  {
-    std::string directory = basePath + "/" + (*it);
-    log->Dump( AppMsg, "Found directory %s", directory.c_str() );
+//------------------------------------------------------------------------------
+// Handler of the directories created ahead of a recursive copy
+//------------------------------------------------------------------------------
+class MkDirHandler: public XrdCl::ResponseHandler
+{
+  public:
+    MkDirHandler( XrdCl::Semaphore *sem ): pSem( sem ) {}
+
+    virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                 XrdCl::AnyObject    *response )
+    {
+      if( !status->IsOK() )
+      {
+        XrdCl::Log *log = XrdCl::DefaultEnv::GetLog();
+        log->Info( XrdCl::AppMsg, "Unable to create a target directory: %s",
+                   status->ToStr().c_str() );
+      }
+      delete status;
+      delete response;
+      pSem->Post();
+      delete this;
+    }
+
+  private:
+    XrdCl::Semaphore *pSem;
+};
 
-    end->Next = IndexRemote( fs, directory, dirOffset );
-    while( end->Next ) end = end->Next;
+//------------------------------------------------------------------------------
+// Create the target directories of a recursive copy before the files are
+// copied, a failure is left to the copy jobs to report
+//------------------------------------------------------------------------------
+void MakeTargetDirs( const TreeWalk    &walk,
+                     uint16_t           dirOffset,
+                     const std::string &dest,
+                     bool               local,
+                     uint16_t           width )
+{
+  using namespace XrdCl;
+  std::vector<TreeWalk::Entry>::const_iterator it;
+  if( local )
+  {
+    for( it = walk.Directories().begin(); it != walk.Directories().end(); ++it )
+    {
+      std::string dir = dest + "/" + it->url.substr( dirOffset );
+      if( mkdir( dir.c_str(), 0755 ) < 0 && errno != EEXIST )
+      {
+        Log *log = DefaultEnv::GetLog();
+        log->Info( AppMsg, "Unable to create %s: %s", dir.c_str(),
+                   strerror( errno ) );
+      }
+    }
+    return;
   }
 
-  delete files;
-  delete directories;
-  return start.Next;
+  //----------------------------------------------------------------------------
+  // Every request creates the whole path, so they may run in any order
+  //----------------------------------------------------------------------------
+  URL        target( dest );
+  FileSystem fs( target );
+  Semaphore  sem( width );
+  Access::Mode mode = Access::UR|Access::UW|Access::UX|Access::GR|
+                      Access::GX|Access::OR|Access::OX;
+  for( it = walk.Directories().begin(); it != walk.Directories().end(); ++it )
+  {
+    std::string dir = target.GetPath() + "/" + it->url.substr( dirOffset );
+    sem.Wait();
+    XRootDStatus st = fs.MkDir( dir, MkDirFlags::MakePath, mode,
+                                new MkDirHandler( &sem ) );
+    if( !st.IsOK() )
+    {
+      sem.Post();
+      continue;
+    }
+  }
+  for( uint16_t i = 0; i < width; ++i )
+    sem.Wait();
 }
 
 //------------------------------------------------------------------------------
@@ -677,8 +881,9 @@ int main( int argc, char **argv )
 
   //----------------------------------------------------------------------------
   // If we're doing remote recursive copy, chain all the files (if it's a
-  // directory)
+  // directory) and create the target directories up front
   //----------------------------------------------------------------------------
+  std::map<std::string, int64_t> sourceSizes;
   if( config.Want( XrdCpConfig::DoRecurse ) &&
       config.srcFile->Protocol == XrdCpFile::isXroot )
   {
@@ -692,14 +897,26 @@ int main( int argc, char **argv )
       //------------------------------------------------------------------------
       // Recursively index the remote directory
       //------------------------------------------------------------------------
+      uint16_t dirOffset = source.GetURL().size();
+      TreeWalk walk( fs, WalkWidth );
+      walk.Walk( source.GetURL() );
       delete config.srcFile;
-      config.srcFile = IndexRemote( fs, source.GetURL(),
-                                    source.GetURL().size() );
+      config.srcFile = IndexRemote( walk, dirOffset );
       if ( !config.srcFile )
       {
         std::cerr << "Error indexing remote directory.";
         return 255;
       }
+
+      std::vector<TreeWalk::Entry>::const_iterator it;
+      for( it = walk.Files().begin(); it != walk.Files().end(); ++it )
+        sourceSizes[it->url] = it->size;
+
+      if( targetIsDir && config.dstFile->Protocol == XrdCpFile::isDir )
+        MakeTargetDirs( walk, dirOffset, config.dstFile->Path, true,
+                        WalkWidth );
+      else if( targetIsDir && config.dstFile->Protocol == XrdCpFile::isXroot )
+        MakeTargetDirs( walk, dirOffset, dest, false, WalkWidth );
     }
 
     delete fs;
@@ -755,6 +972,11 @@ int main( int argc, char **argv )
     properties.Set( "chunkSize",      chunkSize      );
     properties.Set( "parallelChunks", parallelChunks );
 
+    std::map<std::string, int64_t>::iterator itS;
+    itS = sourceSizes.find( sourceFile->Path );
+    if( itS != sourceSizes.end() )
+      properties.Set( "sourceSize", itS->second );
+
     XRootDStatus st = process.AddJob( properties, results );
     if( !st.IsOK() )
     {
@@ -36,21 +36,37 @@
 #include "XrdCl/XrdClUglyHacks.hh"
 
 #include <sys/time.h>
+#include <sys/stat.h>
 
 #include <iostream>
+#include <deque>
+#include <algorithm>
 
 namespace
 {
+  //----------------------------------------------------------------------------
+  //! A copy job with its progress reporting
+  //----------------------------------------------------------------------------
   class QueuedCopyJob: public XrdCl::Job
   {
     public:
       QueuedCopyJob( XrdCl::CopyJob             *job,
                      XrdCl::CopyProgressHandler *progress,
                      uint16_t                    currentJob,
-                     uint16_t                    totalJobs,
-                     XrdCl::Semaphore           *sem = 0 ):
+                     uint16_t                    totalJobs ):
         pJob(job), pProgress(progress), pCurrentJob(currentJob),
-        pTotalJobs(totalJobs), pSem(sem) {}
+        pTotalJobs(totalJobs), pSize(-1)
+      {
+        pJob->GetProperties()->Get( "sourceSize", pSize );
+      }
+
+      //------------------------------------------------------------------------
+      //! Size of the source, -1 if not known
+      //------------------------------------------------------------------------
+      int64_t GetSize() const
+      {
+        return pSize;
+      }
 
       //------------------------------------------------------------------------
       //! Run the job
@@ -103,9 +119,6 @@ namespace
 
         if( pProgress )
           pProgress->EndJob( pCurrentJob, pJob->GetResults() );
-
-        if( pSem )
-          pSem->Post();
       }
 
     private:
@@ -113,7 +126,69 @@ namespace
       XrdCl::CopyProgressHandler *pProgress;
       uint16_t                    pCurrentJob;
       uint16_t                    pTotalJobs;
-      XrdCl::Semaphore           *pSem;
+      int64_t                     pSize;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Order jobs by size, largest first, jobs of unknown size go first
+  //----------------------------------------------------------------------------
+  bool LargerJob( const QueuedCopyJob *a, const QueuedCopyJob *b )
+  {
+    int64_t sa = a->GetSize(), sb = b->GetSize();
+    if( sa < 0 || sb < 0 )
+      return sa < 0 && sb >= 0;
+    return sa > sb;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Copy jobs shared by the workers of a parallel copy process
+  //!
+  //! Every worker takes the next job as soon as its previous one is done,
+  //! so a slow or large file only keeps its own worker busy. The queue is
+  //! ordered largest first so that the large files do not end up alone at
+  //! the tail of the copy.
+  //----------------------------------------------------------------------------
+  class CopyQueue: public XrdCl::Job
+  {
+    public:
+      CopyQueue( const std::vector<QueuedCopyJob*> &jobs ):
+        pJobs( jobs.begin(), jobs.end() ), pSem( 0 )
+      {
+        std::stable_sort( pJobs.begin(), pJobs.end(), LargerJob );
+      }
+
+      //------------------------------------------------------------------------
+      //! Worker loop, run by every worker of the job manager
+      //------------------------------------------------------------------------
+      virtual void Run( void * )
+      {
+        while( QueuedCopyJob *job = Next() )
+          job->Run( 0 );
+        pSem.Post();
+      }
+
+      //------------------------------------------------------------------------
+      //! Wait for a worker to run out of jobs
+      //------------------------------------------------------------------------
+      void WaitForWorker()
+      {
+        pSem.Wait();
+      }
+
+    private:
+      QueuedCopyJob *Next()
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        if( pJobs.empty() )
+          return 0;
+        QueuedCopyJob *job = pJobs.front();
+        pJobs.pop_front();
+        return job;
+      }
+
+      std::deque<QueuedCopyJob*> pJobs;
+      XrdSysMutex                pMutex;
+      XrdCl::Semaphore           pSem;
   };
 };
 
@@ -218,6 +293,19 @@ namespace XrdCl
     if( !p.HasProperty( "dynamicSource" ) )
       p.Set( "dynamicSource", false );
 
+    //--------------------------------------------------------------------------
+    // The size of local sources is cheap to get and lets parallel copies
+    // start with the largest files
+    //--------------------------------------------------------------------------
+    if( !p.HasProperty( "sourceSize" ) )
+    {
+      URL source( p.Get<std::string>( "source" ) );
+      struct stat sb;
+      if( source.GetProtocol() == "file" &&
+          stat( source.GetPath().c_str(), &sb ) == 0 && S_ISREG( sb.st_mode ) )
+        p.Set( "sourceSize", (int64_t)sb.st_size );
+    }
+
     //--------------------------------------------------------------------------
     // Insert the properties
     //--------------------------------------------------------------------------
@@ -330,27 +418,19 @@ namespace XrdCl
     uint16_t currentJob = 1;
     uint16_t totalJobs  = pJobs.size();
 
+    std::vector<QueuedCopyJob*> queued;
+    for( it = pJobs.begin(); it != pJobs.end(); ++it, ++currentJob )
+      queued.push_back( new QueuedCopyJob( *it, progress, currentJob,
+                                           totalJobs ) );
+    std::vector<QueuedCopyJob*>::iterator itQ;
+
     //--------------------------------------------------------------------------
     // Single thread
     //--------------------------------------------------------------------------
     if( parallelThreads == 1 )
     {
-      XRootDStatus err;
-
-      for( it = pJobs.begin(); it != pJobs.end(); ++it )
-      {
-        QueuedCopyJob j( *it, progress, currentJob, totalJobs );
-        j.Run(0);
-
-        XRootDStatus st = (*it)->GetResults()->Get<XRootDStatus>( "status" );
-        if( err.IsOK() && !st.IsOK() )
-        {
-          err = st;
-        }
-        ++currentJob;
-      }
-
-      if( !err.IsOK() ) return err;
+      for( itQ = queued.begin(); itQ != queued.end(); ++itQ )
+        (*itQ)->Run(0);
     }
     //--------------------------------------------------------------------------
     // Multiple threads
@@ -358,43 +438,45 @@ namespace XrdCl
     else
     {
       uint16_t workers = std::min( (uint16_t)parallelThreads,
-                                   (uint16_t)pJobs.size() );
+                                   (uint16_t)std::max<size_t>( pJobs.size(),
+                                                               1 ) );
       JobManager jm( workers );
       jm.Initialize();
       if( !jm.Start() )
+      {
+        for( itQ = queued.begin(); itQ != queued.end(); ++itQ )
+          delete *itQ;
         return XRootDStatus( stError, errOSError, 0,
                              "Unable to start job manager" );
-
-      Semaphore *sem = new Semaphore(0);
-      std::vector<QueuedCopyJob*> queued;
-      for( it = pJobs.begin(); it != pJobs.end(); ++it )
-      {
-        QueuedCopyJob *j = new QueuedCopyJob( *it, progress, currentJob,
-                                              totalJobs, sem );
-
-        queued.push_back( j );
-        jm.QueueJob(j, 0);
-        ++currentJob;
       }
 
-      std::vector<QueuedCopyJob*>::iterator itQ;
-      for( itQ = queued.begin(); itQ != queued.end(); ++itQ )
-        sem->Wait();
-      delete sem;
+      CopyQueue copyQueue( queued );
+      for( uint16_t i = 0; i < workers; ++i )
+        jm.QueueJob( &copyQueue, 0 );
+      for( uint16_t i = 0; i < workers; ++i )
+        copyQueue.WaitForWorker();
 
       if( !jm.Stop() )
+      {
+        for( itQ = queued.begin(); itQ != queued.end(); ++itQ )
+          delete *itQ;
         return XRootDStatus( stError, errOSError, 0,
                              "Unable to stop job manager" );
+      }
       jm.Finalize();
-      for( itQ = queued.begin(); itQ != queued.end(); ++itQ )
-        delete *itQ;
+    }
 
-      for( it = pJobs.begin(); it != pJobs.end(); ++it )
-      {
-        XRootDStatus st = (*it)->GetResults()->Get<XRootDStatus>( "status" );
-        if( !st.IsOK() ) return st;
-      }
-    };
+    for( itQ = queued.begin(); itQ != queued.end(); ++itQ )
+      delete *itQ;
+
+    //--------------------------------------------------------------------------
+    // Return the first error
+    //--------------------------------------------------------------------------
+    for( it = pJobs.begin(); it != pJobs.end(); ++it )
+    {
+      XRootDStatus st = (*it)->GetResults()->Get<XRootDStatus>( "status" );
+      if( !st.IsOK() ) return st;
+    }
     return XRootDStatus();
   }
 
@@ -144,12 +144,17 @@ namespace XrdCl
       //! tpcTimeout     [uint16_t] - time limit for the actual copy to finish
       //! dynamicSource  [bool]     - support for the case where the size source
       //!                             file may change during reading process
+      //! sourceSize     [int64_t]  - size of the source if known, found out
+      //!                             for local files; parallel jobs start
+      //!                             with the largest sources
       //!
       //! Configuration job - this is a job that that is supposed to configure
       //! the copy process as a whole instead of adding a copy job:
       //!
       //! jobType        [string]   - "configuration" - for configuraion
-      //! parallel       [uint8_t]  - nomber of copy jobs to be run in parallel
+      //! parallel       [uint8_t]  - nomber of copy jobs to be run in parallel,
+      //!                             the workers take the next job as soon as
+      //!                             they are done with one
       //!
       //! Results:
       //! sourceCheckSum [string]   - checksum at source, if requested
@@ -201,6 +201,11 @@ namespace XrdCl
     REGISTER_VAR_INT( varsInt, "TCPKeepProbes",        DefaultTCPKeepAliveProbes   );
     REGISTER_VAR_INT( varsInt, "MultiProtocol",        DefaultMultiProtocol        );
     REGISTER_VAR_INT( varsInt, "ParallelEvtLoop",      DefaultParallelEvtLoop      );
+    REGISTER_VAR_INT( varsInt, "CPSparse",             DefaultCPSparse             );
+    REGISTER_VAR_INT( varsInt, "CPAdaptive",           DefaultCPAdaptive           );
+    REGISTER_VAR_INT( varsInt, "CPMinChunkSize",       DefaultCPMinChunkSize       );
+    REGISTER_VAR_INT( varsInt, "CPMaxChunkSize",       DefaultCPMaxChunkSize       );
+    REGISTER_VAR_INT( varsInt, "CPMaxParallelChunks",  DefaultCPMaxParallelChunks  );
 
     REGISTER_VAR_STR( varsStr, "PollerPreference",     DefaultPollerPreference     );
     REGISTER_VAR_STR( varsStr, "ClientMonitor",        DefaultClientMonitor        );
@@ -37,6 +37,16 @@
 #include <cstdio>
 #include <iostream>
 #include <iomanip>
+#include <vector>
+
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
 #ifdef HAVE_READLINE
 #include <readline/readline.h>
@@ -1269,6 +1279,133 @@ XRootDStatus DoCat( FileSystem                      *fs,
   return XRootDStatus();
 }
 
+//------------------------------------------------------------------------------
+// Tail a file on a local mount: the data is spliced to stdout and following
+// waits for inotify events on the file instead of polling it
+//------------------------------------------------------------------------------
+XRootDStatus DoTailLocal( const std::string &path,
+                          uint32_t           offset,
+                          bool               followMode )
+{
+  Log *log = DefaultEnv::GetLog();
+
+  int fd = open( path.c_str(), O_RDONLY );
+  if( fd == -1 )
+  {
+    log->Error( AppMsg, "Unable to open file %s: %s", path.c_str(),
+                strerror( errno ) );
+    return XRootDStatus( stError, errOSError, errno );
+  }
+  ScopedDescriptor fdGuard( fd );
+
+  struct stat st;
+  if( fstat( fd, &st ) == -1 )
+  {
+    log->Error( AppMsg, "Unable to stat file %s: %s", path.c_str(),
+                strerror( errno ) );
+    return XRootDStatus( stError, errOSError, errno );
+  }
+
+  uint64_t current = (uint64_t)st.st_size < offset ? 0 : st.st_size - offset;
+
+  //----------------------------------------------------------------------------
+  // Watch the file before reading it so no change after the last read is
+  // missed, sleep between reads if we cannot
+  //----------------------------------------------------------------------------
+  int notify = -1;
+#ifdef __linux__
+  if( followMode )
+  {
+    notify = inotify_init1( IN_CLOEXEC );
+    if( notify != -1 &&
+        inotify_add_watch( notify, path.c_str(), IN_MODIFY | IN_ATTRIB ) == -1 )
+    {
+      close( notify );
+      notify = -1;
+    }
+  }
+#endif
+  ScopedDescriptor notifyGuard( notify );
+
+  uint32_t          chunkSize = 1*1024*1024;
+  bool              splice    = true;
+  std::vector<char> buffer;
+  while( 1 )
+  {
+    int64_t moved;
+    if( splice )
+    {
+      moved = Utils::SpliceFile( 1, fd, current, chunkSize );
+      if( moved == -1 && ( errno == EINVAL || errno == ENOSYS ) )
+      {
+        splice = false;
+        buffer.resize( chunkSize );
+        continue;
+      }
+    }
+    else
+    {
+      moved = pread( fd, &buffer[0], chunkSize, current );
+      for( int64_t written = 0; written < moved; )
+      {
+        ssize_t ret = write( 1, &buffer[written], moved - written );
+        if( ret == -1 && errno == EINTR )
+          continue;
+        if( ret == -1 )
+        {
+          log->Error( AppMsg, "Unable to write to stdout: %s",
+                      strerror( errno ) );
+          return XRootDStatus( stError, errOSError, errno );
+        }
+        written += ret;
+      }
+      if( moved > 0 )
+        current += moved;
+    }
+
+    if( moved == -1 )
+    {
+      if( errno == EINTR )
+        continue;
+      log->Error( AppMsg, "Unable to read from %s: %s", path.c_str(),
+                  strerror( errno ) );
+      return XRootDStatus( stError, errOSError, errno );
+    }
+
+    if( moved > 0 )
+      continue;
+
+    if( !followMode )
+      break;
+
+    //--------------------------------------------------------------------------
+    // At the end of the file, start over if it has been truncated
+    //--------------------------------------------------------------------------
+    if( fstat( fd, &st ) == 0 && (uint64_t)st.st_size < current )
+    {
+      current = 0;
+      continue;
+    }
+
+    if( notify == -1 )
+    {
+      sleep(1);
+      continue;
+    }
+
+#ifdef __linux__
+    char events[4096];
+    if( read( notify, events, sizeof( events ) ) == -1 && errno != EINTR )
+    {
+      log->Error( AppMsg, "Unable to watch %s: %s", path.c_str(),
+                  strerror( errno ) );
+      return XRootDStatus( stError, errOSError, errno );
+    }
+#endif
+  }
+  return XRootDStatus();
+}
+
 //------------------------------------------------------------------------------
 // Tail a file
 //------------------------------------------------------------------------------
@@ -1338,6 +1475,13 @@ XRootDStatus DoTail( FileSystem                      *fs,
   URL remoteUrl( server );
   remoteUrl.SetPath( remoteFile );
 
+  //----------------------------------------------------------------------------
+  // The file is on a local mount
+  //----------------------------------------------------------------------------
+  std::string localPath;
+  if( Utils::GetLocalPath( remoteUrl, localPath ) )
+    return DoTailLocal( localPath, offset, followMode );
+
   //----------------------------------------------------------------------------
   // Fetch the data
   //----------------------------------------------------------------------------
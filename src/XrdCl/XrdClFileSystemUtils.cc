@@ -32,6 +32,50 @@
 #include <utility>
 #include <memory>
 
+namespace
+{
+  typedef std::vector<std::pair<std::string, uint64_t> > SpaceParams;
+
+  //----------------------------------------------------------------------------
+  //! Add up the space info answered by one server, the largest free chunk
+  //! is the largest of all
+  //----------------------------------------------------------------------------
+  XrdCl::XRootDStatus AddSpaceInfo( SpaceParams         &resp,
+                                    const XrdCl::Buffer &spaceInfo )
+  {
+    using namespace XrdCl;
+
+    //--------------------------------------------------------------------------
+    // Parse the cgi
+    //--------------------------------------------------------------------------
+    std::string fakeUrl = "root://fake/fake?" + spaceInfo.ToString();
+    URL url( fakeUrl );
+
+    if( !url.IsValid() )
+      return XRootDStatus( stError, errInvalidResponse );
+
+    URL::ParamsMap params = url.GetParams();
+
+    //--------------------------------------------------------------------------
+    // Convert and add up the params
+    //--------------------------------------------------------------------------
+    XRootDStatus st( stError, errInvalidResponse );
+    for( size_t i = 0; i < resp.size(); ++i )
+    {
+      URL::ParamsMap::iterator paramIt = params.find( resp[i].first );
+      if( paramIt == params.end() ) return st;
+      char *res;
+      uint64_t num = ::strtoll( paramIt->second.c_str(), &res, 0 );
+      if( *res != 0 ) return st;
+      if( resp[i].first == "oss.maxf" )
+        { if( num > resp[i].second ) resp[i].second = num; }
+      else
+        resp[i].second += num;
+    }
+    return XRootDStatus();
+  }
+}
+
 namespace XrdCl
 {
   //----------------------------------------------------------------------------
@@ -41,6 +85,35 @@ namespace XrdCl
                                               FileSystem         *fs,
                                               const std::string  &path )
   {
+    SpaceParams resp;
+    resp.push_back( std::make_pair( std::string("oss.space"), (uint64_t)0 ) );
+    resp.push_back( std::make_pair( std::string("oss.free"), (uint64_t)0 ) );
+    resp.push_back( std::make_pair( std::string("oss.used"), (uint64_t)0 ) );
+    resp.push_back( std::make_pair( std::string("oss.maxf"), (uint64_t)0 ) );
+    Buffer pathArg; pathArg.FromString( path );
+
+    //--------------------------------------------------------------------------
+    // A file system plug-in mapping the host to a local mount answers the
+    // space of the mount itself
+    //--------------------------------------------------------------------------
+    std::string localPath;
+    if( fs->GetProperty( "LocalPath", localPath ) && !localPath.empty() )
+    {
+      Buffer *spaceInfo = 0;
+      XRootDStatus st = fs->Query( QueryCode::Space, pathArg, spaceInfo );
+      if( !st.IsOK() )
+        return st;
+
+      XRDCL_SMART_PTR_T<Buffer> spaceInfoPtr( spaceInfo );
+      st = AddSpaceInfo( resp, *spaceInfo );
+      if( !st.IsOK() )
+        return st;
+
+      result = new SpaceInfo( resp[0].second, resp[1].second, resp[2].second,
+                              resp[3].second );
+      return XRootDStatus();
+    }
+
     //--------------------------------------------------------------------------
     // Locate all the disk servers containing the space
     //--------------------------------------------------------------------------
@@ -53,17 +126,10 @@ namespace XrdCl
 
     bool partial = st.code == suPartial ? true : false;
 
-    std::vector<std::pair<std::string, uint64_t> > resp;
-    resp.push_back( std::make_pair( std::string("oss.space"), (uint64_t)0 ) );
-    resp.push_back( std::make_pair( std::string("oss.free"), (uint64_t)0 ) );
-    resp.push_back( std::make_pair( std::string("oss.used"), (uint64_t)0 ) );
-    resp.push_back( std::make_pair( std::string("oss.maxf"), (uint64_t)0 ) );
-
     //--------------------------------------------------------------------------
     // Loop over the file servers and get the space info from each of them
     //--------------------------------------------------------------------------
     LocationInfo::Iterator it;
-    Buffer pathArg; pathArg.FromString( path );
     for( it = locationInfo->Begin(); it != locationInfo->End(); ++it )
     {
       //------------------------------------------------------------------------
@@ -76,34 +142,9 @@ namespace XrdCl
         return st;
 
       XRDCL_SMART_PTR_T<Buffer> spaceInfoPtr( spaceInfo );
-
-      //------------------------------------------------------------------------
-      // Parse the cgi
-      //------------------------------------------------------------------------
-      std::string fakeUrl = "root://fake/fake?" + spaceInfo->ToString();
-      URL url( fakeUrl );
-
-      if( !url.IsValid() )
-        return XRootDStatus( stError, errInvalidResponse );
-
-      URL::ParamsMap params = url.GetParams();
-
-      //------------------------------------------------------------------------
-      // Convert and add up the params
-      //------------------------------------------------------------------------
-      st = XRootDStatus( stError, errInvalidResponse );
-      for( size_t i = 0; i < resp.size(); ++i )
-      {
-        URL::ParamsMap::iterator paramIt = params.find( resp[i].first );
-        if( paramIt == params.end() ) return st;
-        char *res;
-        uint64_t num = ::strtoll( paramIt->second.c_str(), &res, 0 );
-        if( *res != 0 ) return st;
-        if( resp[i].first == "oss.maxf" )
-          { if( num > resp[i].second ) resp[i].second = num; }
-        else
-          resp[i].second += num;
-      }
+      st = AddSpaceInfo( resp, *spaceInfo );
+      if( !st.IsOK() )
+        return st;
     }
 
     result = new SpaceInfo( resp[0].second, resp[1].second, resp[2].second,
@@ -24,6 +24,7 @@
 
 #include "XrdCl/XrdClThirdPartyCopyJob.hh"
 #include "XrdCl/XrdClFile.hh"
+#include "XrdCl/XrdClFileSystem.hh"
 #include "XrdCl/XrdClConstants.hh"
 #include "XrdCl/XrdClLog.hh"
 #include "XrdCl/XrdClDefaultEnv.hh"
@@ -38,9 +39,20 @@
 #include <sstream>
 #include <cstdlib>
 #include <cstdio>
+#include <vector>
+#include <algorithm>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
 
 namespace
 {
@@ -102,6 +114,48 @@ namespace
       XrdCl::XRootDStatus *pStatus;
   };
 
+  //----------------------------------------------------------------------------
+  //! Copy up to length bytes from one descriptor to the other in the kernel,
+  //! returns the number of bytes copied, -1 with errno set on failure
+  //----------------------------------------------------------------------------
+  ssize_t CopyRange( int src, int dst, uint64_t offset, size_t length )
+  {
+#ifdef SYS_copy_file_range
+    loff_t inOff  = offset;
+    loff_t outOff = offset;
+    return syscall( SYS_copy_file_range, src, &inOff, dst, &outOff, length,
+                    0 );
+#else
+    (void)src; (void)dst; (void)offset; (void)length;
+    errno = ENOSYS;
+    return -1;
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  //! Copy up to length bytes through a buffer, same result as CopyRange
+  //----------------------------------------------------------------------------
+  ssize_t CopyBuffer( int src, int dst, uint64_t offset, size_t length,
+                      std::vector<char> &buffer )
+  {
+    if( buffer.empty() )
+      buffer.resize( 4*1024*1024 );
+    ssize_t r = pread( src, &buffer[0], std::min( length, buffer.size() ),
+                       offset );
+    if( r <= 0 )
+      return r;
+    ssize_t done = 0;
+    while( done < r )
+    {
+      ssize_t w = pwrite( dst, &buffer[done], r-done, offset+done );
+      if( w < 0 && errno == EINTR )
+        continue;
+      if( w < 0 )
+        return -1;
+      done += w;
+    }
+    return r;
+  }
 }
 
 namespace XrdCl
@@ -127,19 +181,18 @@ namespace XrdCl
     //--------------------------------------------------------------------------
     // Decode the parameters
     //--------------------------------------------------------------------------
-    std::string checkSumMode;
-    std::string checkSumType;
-    std::string checkSumPreset;
     uint64_t    sourceSize;
     bool        force, coerce;
 
-    pProperties->Get( "checkSumMode",    checkSumMode );
-    pProperties->Get( "checkSumType",    checkSumType );
-    pProperties->Get( "checkSumPreset",  checkSumPreset );
     pProperties->Get( "sourceSize",      sourceSize );
     pProperties->Get( "force",           force );
     pProperties->Get( "coerce",          coerce );
 
+    std::string localSource, localTarget;
+    if( pProperties->Get( "tpcLocalSource", localSource ) &&
+        pProperties->Get( "tpcLocalTarget", localTarget ) )
+      return RunLocal( localSource, localTarget, progress );
+
     //--------------------------------------------------------------------------
     // Generate the destination CGI
     //--------------------------------------------------------------------------
@@ -387,9 +440,23 @@ namespace XrdCl
 
     pResults->Set( "size", sourceSize );
 
-    //--------------------------------------------------------------------------
-    // Verify the checksums if needed
-    //--------------------------------------------------------------------------
+    return VerifyCheckSum( "", "" );
+  }
+
+  //----------------------------------------------------------------------------
+  // Verify the checksums if needed
+  //----------------------------------------------------------------------------
+  XRootDStatus ThirdPartyCopyJob::VerifyCheckSum( const std::string &localSource,
+                                                  const std::string &localTarget )
+  {
+    std::string checkSumMode;
+    std::string checkSumType;
+    std::string checkSumPreset;
+    pProperties->Get( "checkSumMode",    checkSumMode );
+    pProperties->Get( "checkSumType",    checkSumType );
+    pProperties->Get( "checkSumPreset",  checkSumPreset );
+
+    Log *log = DefaultEnv::GetLog();
     if( checkSumMode != "none" )
     {
       log->Debug( UtilityMsg, "Attempting checksum calculation." );
@@ -409,6 +476,9 @@ namespace XrdCl
           sourceCheckSum  = checkSumType + ":";
           sourceCheckSum += checkSumPreset;
         }
+        else if( !localSource.empty() )
+          st = Utils::GetLocalCheckSum( sourceCheckSum, checkSumType,
+                                        localSource );
         else
         {
           st = Utils::GetRemoteCheckSum( sourceCheckSum, checkSumType,
@@ -430,9 +500,13 @@ namespace XrdCl
       if( checkSumMode == "end2end" || checkSumMode == "target" )
       {
         gettimeofday( &tStart, 0 );
-        st = Utils::GetRemoteCheckSum( targetCheckSum, checkSumType,
-                                       GetTarget().GetHostId(),
-                                       GetTarget().GetPath() );
+        if( !localTarget.empty() )
+          st = Utils::GetLocalCheckSum( targetCheckSum, checkSumType,
+                                        localTarget );
+        else
+          st = Utils::GetRemoteCheckSum( targetCheckSum, checkSumType,
+                                         GetTarget().GetHostId(),
+                                         GetTarget().GetPath() );
 
         gettimeofday( &tEnd, 0 );
         if( !st.IsOK() )
@@ -469,6 +543,134 @@ namespace XrdCl
     return XRootDStatus();
   }
 
+  //----------------------------------------------------------------------------
+  // Copy between two paths on local mounts
+  //----------------------------------------------------------------------------
+  XRootDStatus ThirdPartyCopyJob::RunLocal( const std::string   &source,
+                                            const std::string   &target,
+                                            CopyProgressHandler *progress )
+  {
+    bool force = false, posc = false, makeDir = false;
+    pProperties->Get( "force",   force );
+    pProperties->Get( "posc",    posc );
+    pProperties->Get( "makeDir", makeDir );
+
+    Log *log = DefaultEnv::GetLog();
+    log->Debug( UtilityMsg, "Copying %s to %s on the client",
+                source.c_str(), target.c_str() );
+
+    int src = open( source.c_str(), O_RDONLY | O_CLOEXEC );
+    struct stat sb;
+    if( src < 0 || fstat( src, &sb ) != 0 )
+    {
+      XRootDStatus st( stError, errOSError, errno );
+      log->Error( UtilityMsg, "Unable to open source %s: %s",
+                  source.c_str(), strerror( errno ) );
+      if( src >= 0 ) close( src );
+      return st;
+    }
+
+    //--------------------------------------------------------------------------
+    // Failures to create the path show when the target is opened
+    //--------------------------------------------------------------------------
+    if( makeDir )
+    {
+      std::string::size_type slash = target.find( '/', 1 );
+      while( slash != std::string::npos )
+      {
+        mkdir( target.substr( 0, slash ).c_str(), 0755 );
+        slash = target.find( '/', slash + 1 );
+      }
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+    flags |= force ? O_TRUNC : O_EXCL;
+    int dst = open( target.c_str(), flags, 0644 );
+    if( dst < 0 )
+    {
+      XRootDStatus st( stError, errOSError, errno );
+      log->Error( UtilityMsg, "Unable to open target %s: %s",
+                  target.c_str(), strerror( errno ) );
+      close( src );
+      return st;
+    }
+
+    //--------------------------------------------------------------------------
+    // A reflink shares the blocks of the source if both are on one file
+    // system that supports it, otherwise the kernel copies the data with
+    // copy_file_range (server-side on Lustre and NFS) or through a buffer
+    //--------------------------------------------------------------------------
+    uint64_t          size     = sb.st_size;
+    uint64_t          done     = 0;
+    bool              kernel   = true;
+    bool              canceled = false;
+    std::vector<char> buffer;
+    XRootDStatus      st;
+#ifdef FICLONE
+    if( ioctl( dst, FICLONE, src ) == 0 )
+    {
+      log->Debug( UtilityMsg, "Cloned %s to %s", source.c_str(),
+                  target.c_str() );
+      done = size;
+    }
+#endif
+    while( done < size )
+    {
+      size_t  length = std::min<uint64_t>( size - done, 64*1024*1024 );
+      ssize_t r = kernel ? CopyRange( src, dst, done, length )
+                         : CopyBuffer( src, dst, done, length, buffer );
+      if( r < 0 && errno == EINTR )
+        continue;
+      if( r < 0 && kernel && ( errno == EXDEV || errno == ENOSYS ||
+                               errno == EINVAL || errno == EOPNOTSUPP ) )
+      {
+        kernel = false;
+        continue;
+      }
+      if( r < 0 )
+      {
+        st = XRootDStatus( stError, errOSError, errno );
+        log->Error( UtilityMsg, "Copy from %s to %s failed: %s",
+                    source.c_str(), target.c_str(), strerror( errno ) );
+        break;
+      }
+      if( r == 0 )
+        break;
+      done += r;
+
+      if( progress )
+      {
+        progress->JobProgress( pJobId, done, size );
+        if( progress->ShouldCancel( pJobId ) )
+        {
+          log->Debug( UtilityMsg, "Cancelation requested by progress handler" );
+          st = XRootDStatus( stError, errOSError, ECANCELED );
+          canceled = true;
+          break;
+        }
+      }
+    }
+
+    if( st.IsOK() && done < size )
+      st = XRootDStatus( stError, errDataError, 0, "source file shrank" );
+    if( progress && st.IsOK() && size == 0 )
+      progress->JobProgress( pJobId, 0, 0 );
+
+    close( src );
+    if( close( dst ) != 0 && st.IsOK() )
+      st = XRootDStatus( stError, errOSError, errno );
+
+    if( !st.IsOK() )
+    {
+      if( posc || canceled )
+        unlink( target.c_str() );
+      return st;
+    }
+
+    pResults->Set( "size", size );
+    return VerifyCheckSum( source, target );
+  }
+
   //----------------------------------------------------------------------------
   // Check whether doing a third party copy is feasible for given
   // job descriptor
@@ -494,6 +696,28 @@ namespace XrdCl
         target.GetProtocol() != "xroot" )
       return XRootDStatus( stError, errNotSupported );
 
+    //--------------------------------------------------------------------------
+    // Both ends on local mounts, the client copies the file itself
+    //--------------------------------------------------------------------------
+    std::string localSource, localTarget;
+    if( Utils::GetLocalPath( source, localSource ) &&
+        Utils::GetLocalPath( target, localTarget ) )
+    {
+      struct stat sb;
+      if( stat( localSource.c_str(), &sb ) != 0 )
+      {
+        log->Error( UtilityMsg, "Cannot open source file %s: %s",
+                    source.GetURL().c_str(), strerror( errno ) );
+        return XRootDStatus( stFatal, errOSError, errno );
+      }
+      log->Debug( UtilityMsg, "Copying %s to %s on the local mounts",
+                  localSource.c_str(), localTarget.c_str() );
+      properties->Set( "sourceSize",       (uint64_t)sb.st_size );
+      properties->Set( "tpcLocalSource",   localSource );
+      properties->Set( "tpcLocalTarget",   localTarget );
+      return XRootDStatus();
+    }
+
     uint16_t timeLeft       = 0;
     properties->Get( "initTimeout", timeLeft );
 
@@ -55,6 +55,21 @@ namespace XrdCl
 
     private:
       static std::string GenerateKey();
+
+      //------------------------------------------------------------------------
+      //! Get and compare the checksums the job asks for, locally for the
+      //! ends with a local path
+      //------------------------------------------------------------------------
+      XRootDStatus VerifyCheckSum( const std::string &localSource,
+                                   const std::string &localTarget );
+
+      //------------------------------------------------------------------------
+      //! Copy between two paths on local mounts, with a reflink if the
+      //! file system can, with copy_file_range otherwise
+      //------------------------------------------------------------------------
+      XRootDStatus RunLocal( const std::string   &source,
+                             const std::string   &target,
+                             CopyProgressHandler *progress );
   };
 }
 
@@ -34,7 +34,14 @@
 #include <string>
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <dirent.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#endif
 
 namespace
 {
@@ -484,4 +491,50 @@ namespace XrdCl
     }
     return checksum;
   }
+
+  //----------------------------------------------------------------------------
+  // Get the path of a URL on a local mount
+  //----------------------------------------------------------------------------
+  bool Utils::GetLocalPath( const URL &url, std::string &path )
+  {
+    FileSystem fs( url );
+    return fs.GetProperty( "LocalPath", path ) && !path.empty();
+  }
+
+  //----------------------------------------------------------------------------
+  // Move file data to another descriptor in the kernel
+  //----------------------------------------------------------------------------
+  int64_t Utils::SpliceFile( int       out,
+                             int       in,
+                             uint64_t &offset,
+                             size_t    length )
+  {
+#ifdef __linux__
+    struct stat st;
+    ssize_t     moved;
+    if( fstat( out, &st ) == 0 && S_ISFIFO( st.st_mode ) )
+    {
+      loff_t off = offset;
+      do
+        moved = splice( in, &off, out, 0, length,
+                        SPLICE_F_MOVE | SPLICE_F_MORE );
+      while( moved == -1 && errno == EINTR );
+      if( moved > 0 )
+        offset = off;
+      return moved;
+    }
+
+    off_t off = offset;
+    do
+      moved = sendfile( out, in, &off, length );
+    while( moved == -1 && errno == EINTR );
+    if( moved > 0 )
+      offset = off;
+    return moved;
+#else
+    (void)out; (void)in; (void)offset; (void)length;
+    errno = ENOSYS;
+    return -1;
+#endif
+  }
 }
@@ -189,6 +189,27 @@ namespace XrdCl
       //------------------------------------------------------------------------
       static std::string NormalizeChecksum( const std::string &name,
                                             const std::string &checksum );
+
+      //------------------------------------------------------------------------
+      //! Get the path of a URL on a local mount, if a file system plug-in
+      //! maps its host to one
+      //------------------------------------------------------------------------
+      static bool GetLocalPath( const URL &url, std::string &path );
+
+      //------------------------------------------------------------------------
+      //! Move up to length bytes of the file open on in, starting at offset,
+      //! to out without copying them through user space: splice if out is
+      //! a pipe, sendfile otherwise. The offset is advanced by the bytes
+      //! moved.
+      //!
+      //! @return bytes moved, 0 at the end of the file, -1 with errno set
+      //!         on failure; EINVAL or ENOSYS mean the descriptors cannot
+      //!         do it and the data has to be read and written
+      //------------------------------------------------------------------------
+      static int64_t SpliceFile( int       out,
+                                 int       in,
+                                 uint64_t &offset,
+                                 size_t    length );
   };
 
   //----------------------------------------------------------------------------
@@ -0,0 +1,52 @@
+#!/bin/bash
+if
+[ "$1" == "debug" ]; then
+    export XRD_LOGLEVEL=Dump
+fi
+
+### the disk cache only keeps remote reads, a local xrootd server is needed
+echo -e "\e[93m xrdcp a remote file twice through the disk cache \e[0m"
+if ! command -v xrootd > /dev/null; then
+    echo -e "\e[93m SKIPPED, no xrootd server to read from \e[0m"
+    exit 0
+fi
+
+###Setup the test
+### localhost is not in redirectlocal, its reads go to the server
+cat > test/XrdOpenLocal.conf << EOF2
+url = root://localhost:10950
+lib = $PWD/XrdOpenLocal.so
+redirectlocal = test.test|/tmp/xrdcpdisk/local
+diskcache = /tmp/xrdcpdisk/cache
+diskcachesize = 64
+diskcacheblock = 64
+enable = true
+EOF2
+export XRD_PLUGINCONFDIR=$PWD/test
+### the cache statistics are printed at the Debug level
+export XRD_LOGLEVEL=${XRD_LOGLEVEL:-Debug}
+mkdir -p /tmp/xrdcpdisk/data /tmp/xrdcpdisk/local /tmp/xrdcpdisk/cache
+head -c 5000000 /dev/urandom > /tmp/xrdcpdisk/data/testfile
+cp /tmp/xrdcpdisk/data/testfile testfile
+xrootd -p 10950 -l /tmp/xrdcpdisk/xrootd.log /tmp/xrdcpdisk/data &
+SERVER=$!
+sleep 2
+
+
+##Run the test
+XRD_LOGFILE=xrdcp1.log timeout 60 xrdcp -f root://localhost:10950//tmp/xrdcpdisk/data/testfile ./testfile2
+XRD_LOGFILE=xrdcp2.log timeout 60 xrdcp -f root://localhost:10950//tmp/xrdcpdisk/data/testfile ./testfile3
+if  cmp -s testfile testfile2 && cmp -s testfile testfile3 && grep -q "DiskCache: [1-9][0-9]* hits" xrdcp2.log; then
+    echo -e "\e[92m SUCCESS \e[0m"
+
+else
+
+    echo -e "\e[91m FAILED \e[0m"
+fi
+if [ "$1" == "debug" ]; then
+    cat xrdcp*.log
+fi
+###Cleanup the test
+kill $SERVER
+wait $SERVER 2> /dev/null
+rm -rf testfile testfile2 testfile3 xrdcp*.log /tmp/xrdcpdisk test/XrdOpenLocal.conf
@@ -0,0 +1,46 @@
+#!/bin/bash
+if
+[ "$1" == "debug" ]; then
+    export XRD_LOGLEVEL=Dump
+fi
+
+###Setup the test
+### the first root is broken: the file is a directory there, reads fail with EISDIR
+cat > test/XrdOpenLocal.conf << EOF2
+url = root://test.test
+lib = $PWD/XrdOpenLocal.so
+redirectlocal = test.test|/tmp/xrdcpfail_a,100|/tmp/xrdcpfail_b
+replicabalance = read
+enable = true
+EOF2
+export XRD_PLUGINCONFDIR=$PWD/test
+mkdir -p /tmp/xrdcpfail_a/xrdcptest/testfile /tmp/xrdcpfail_b/xrdcptest
+echo "test_FAILOVER" > /tmp/xrdcpfail_b/xrdcptest/testfile
+echo "test_FAILOVER" > testfile
+
+
+##Run the test
+echo -e "\e[93m xrdcp a file whose first local root is broken \e[0m"
+timeout 60 xrdcp -f root://test.test//xrdcptest/testfile ./testfile2
+DIFF=$(diff testfile testfile2)
+if  [ $? -eq 0 ] && [ "$DIFF" == "" ]; then
+    echo -e "\e[92m SUCCESS \e[0m"
+
+else
+
+    echo -e "\e[91m FAILED \e[0m"
+fi
+echo -e "\e[93m xrdcp a file that is broken on every local root \e[0m"
+rm -r /tmp/xrdcpfail_b/xrdcptest/testfile
+mkdir /tmp/xrdcpfail_b/xrdcptest/testfile
+timeout 60 xrdcp -f root://test.test//xrdcptest/testfile ./testfile3
+RC=$?
+if  [ $RC -ne 0 ] && [ $RC -ne 124 ]; then
+    echo -e "\e[92m SUCCESS \e[0m"
+
+else
+
+    echo -e "\e[91m FAILED \e[0m"
+fi
+###Cleanup the test
+rm -rf testfile testfile2 testfile3 /tmp/xrdcpfail_a /tmp/xrdcpfail_b test/XrdOpenLocal.conf
@@ -0,0 +1,43 @@
+#!/bin/bash
+if
+[ "$1" == "debug" ]; then
+    export XRD_LOGLEVEL=Dump
+fi
+
+###Setup the test
+cat > test/XrdOpenLocal.conf << EOF2
+url = root://test.test
+lib = $PWD/XrdOpenLocal.so
+redirectlocal = test.test|/tmp/xrdcplazy
+lazyopen = true
+enable = true
+EOF2
+export XRD_PLUGINCONFDIR=$PWD/test
+mkdir -p /tmp/xrdcplazy/xrdcptest
+echo "test_LAZYOPEN" > /tmp/xrdcplazy/xrdcptest/testfile
+echo "test_LAZYOPEN" > testfile
+
+
+##Run the test
+echo -e "\e[93m xrdcp a file opened lazily \e[0m"
+timeout 60 xrdcp -f root://test.test//xrdcptest/testfile ./testfile2
+DIFF=$(diff testfile testfile2)
+if  [ $? -eq 0 ] && [ "$DIFF" == "" ]; then
+    echo -e "\e[92m SUCCESS \e[0m"
+
+else
+
+    echo -e "\e[91m FAILED \e[0m"
+fi
+echo -e "\e[93m xrdcp a missing file opened lazily \e[0m"
+timeout 60 xrdcp -f root://test.test//xrdcptest/missingfile ./testfile3
+RC=$?
+if  [ $RC -ne 0 ] && [ $RC -ne 124 ] && [ ! -e testfile3 ]; then
+    echo -e "\e[92m SUCCESS \e[0m"
+
+else
+
+    echo -e "\e[91m FAILED \e[0m"
+fi
+###Cleanup the test
+rm -rf testfile testfile2 testfile3 /tmp/xrdcplazy test/XrdOpenLocal.conf
@@ -0,0 +1,77 @@
+#!/bin/bash
+if
+[ "$1" == "debug" ]; then
+    export XRD_LOGLEVEL=Dump
+fi
+
+###Setup the test
+### a segment of its own, blocks of other jobs or runs are not served
+SHM=xrdopenlocal.test.$$
+cat > test/XrdOpenLocal.conf << EOF2
+url = root://test.test
+lib = $PWD/XrdOpenLocal.so
+redirectlocal = test.test|/tmp/xrdcpshm
+shmcache = true
+shmcachesize = 64
+shmcacheblock = 64
+shmcachename = /$SHM
+enable = true
+EOF2
+export XRD_PLUGINCONFDIR=$PWD/test
+### the cache statistics are printed at the Debug level
+export XRD_LOGLEVEL=${XRD_LOGLEVEL:-Debug}
+mkdir -p /tmp/xrdcpshm/xrdcptest
+head -c 5000000 /dev/urandom > /tmp/xrdcpshm/xrdcptest/testfile
+cp /tmp/xrdcpshm/xrdcptest/testfile testfile
+
+
+##Run the test
+echo -e "\e[93m xrdcp a file twice through the shared memory cache \e[0m"
+XRD_LOGFILE=xrdcp1.log timeout 60 xrdcp -f root://test.test//xrdcptest/testfile ./testfile2
+XRD_LOGFILE=xrdcp2.log timeout 60 xrdcp -f root://test.test//xrdcptest/testfile ./testfile3
+if  cmp -s testfile testfile2 && cmp -s testfile testfile3 && grep -q "ShmCache: [1-9][0-9]* hits" xrdcp2.log; then
+    echo -e "\e[92m SUCCESS \e[0m"
+
+else
+
+    echo -e "\e[91m FAILED \e[0m"
+fi
+
+echo -e "\e[93m xrdcp a file whose cached blocks were being written by a process that died \e[0m"
+if ! command -v python3 > /dev/null; then
+    echo -e "\e[93m SKIPPED, python3 is needed to mark the slots \e[0m"
+else
+    ### a pid that is gone
+    true &
+    DEAD=$!
+    wait $DEAD
+    ### mark every filled slot as owned by it, the layout is the one of
+    ### ShmCache::Header (32 bytes) and ShmCache::Slot (64 bytes)
+    python3 - /dev/shm/$SHM $DEAD << EOF2
+import struct,sys
+f=open(sys.argv[1],'r+b')
+magic,version,block,slots,data=struct.unpack('QIIQQ',f.read(32))
+for i in range(slots):
+    off=32+i*64
+    f.seek(off)
+    seq,dev,ino=struct.unpack('QQQ',f.read(24))
+    if ino and not seq&1:
+        f.seek(off)
+        f.write(struct.pack('Q',seq+1))
+        f.seek(off+56)
+        f.write(struct.pack('i',int(sys.argv[2])))
+EOF2
+    XRD_LOGFILE=xrdcp3.log timeout 60 xrdcp -f root://test.test//xrdcptest/testfile ./testfile4
+    if  cmp -s testfile testfile4 && grep -q "ShmCache: reclaimed [1-9][0-9]* slots" xrdcp3.log; then
+        echo -e "\e[92m SUCCESS \e[0m"
+
+    else
+
+        echo -e "\e[91m FAILED \e[0m"
+    fi
+fi
+if [ "$1" == "debug" ]; then
+    cat xrdcp*.log
+fi
+###Cleanup the test
+rm -rf testfile testfile2 testfile3 testfile4 xrdcp*.log /tmp/xrdcpshm /dev/shm/$SHM test/XrdOpenLocal.conf
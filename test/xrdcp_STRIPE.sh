@@ -0,0 +1,35 @@
+#!/bin/bash
+if
+[ "$1" == "debug" ]; then
+    export XRD_LOGLEVEL=Dump
+fi
+
+###Setup the test
+### every file is striped in 64KB units over 4 OSTs, reads are split over them
+cat > test/XrdOpenLocal.conf << EOF2
+url = root://test.test
+lib = $PWD/XrdOpenLocal.so
+redirectlocal = test.test|/tmp/xrdcpstripe
+stripeaware = true
+stripelayout = fake:64:4
+stripedepth = 2
+enable = true
+EOF2
+export XRD_PLUGINCONFDIR=$PWD/test
+mkdir -p /tmp/xrdcpstripe/xrdcptest
+head -c 5000000 /dev/urandom > /tmp/xrdcpstripe/xrdcptest/testfile
+cp /tmp/xrdcpstripe/xrdcptest/testfile testfile
+
+
+##Run the test
+echo -e "\e[93m xrdcp a file read in stripe units \e[0m"
+timeout 60 xrdcp -f root://test.test//xrdcptest/testfile ./testfile2
+if  cmp -s testfile testfile2; then
+    echo -e "\e[92m SUCCESS \e[0m"
+
+else
+
+    echo -e "\e[91m FAILED \e[0m"
+fi
+###Cleanup the test
+rm -rf testfile testfile2 /tmp/xrdcpstripe test/XrdOpenLocal.conf
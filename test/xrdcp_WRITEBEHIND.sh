@@ -0,0 +1,44 @@
+#!/bin/bash
+if
+[ "$1" == "debug" ]; then
+    export XRD_LOGLEVEL=Dump
+fi
+
+###Setup the test
+### chunks of 100000 bytes are smaller than the 256KB buffers and not aligned to them
+cat > test/XrdOpenLocal.conf << EOF2
+url = root://test.test
+lib = $PWD/XrdOpenLocal.so
+redirectlocal = test.test|/tmp/xrdcpwb
+writebehind = true
+writebehindsize = 256
+writebehinddepth = 2
+enable = true
+EOF2
+export XRD_PLUGINCONFDIR=$PWD/test
+export XRD_CPCHUNKSIZE=100000
+mkdir -p /tmp/xrdcpwb/xrdcptest
+head -c 5000000 /dev/urandom > testfile
+
+
+##Run the test
+echo -e "\e[93m xrdcp a file to a redirected host through the write-behind buffer \e[0m"
+timeout 60 xrdcp -f ./testfile root://test.test//xrdcptest/testfile
+if  cmp -s testfile /tmp/xrdcpwb/xrdcptest/testfile; then
+    echo -e "\e[92m SUCCESS \e[0m"
+
+else
+
+    echo -e "\e[91m FAILED \e[0m"
+fi
+echo -e "\e[93m xrdcp it back and compare \e[0m"
+timeout 60 xrdcp -f root://test.test//xrdcptest/testfile ./testfile2
+if  cmp -s testfile testfile2; then
+    echo -e "\e[92m SUCCESS \e[0m"
+
+else
+
+    echo -e "\e[91m FAILED \e[0m"
+fi
+###Cleanup the test
+rm -rf testfile testfile2 /tmp/xrdcpwb test/XrdOpenLocal.conf
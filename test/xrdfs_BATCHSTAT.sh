@@ -0,0 +1,37 @@
+#!/bin/bash
+if
+[ "$1" == "debug" ]; then
+    export XRD_LOGLEVEL=Dump
+fi
+
+###Setup the test
+cat > test/XrdOpenLocal.conf << EOF2
+url = root://test.test
+lib = $PWD/XrdOpenLocal.so
+redirectlocal = test.test|/tmp/xrdfsbatch
+enable = true
+EOF2
+export XRD_PLUGINCONFDIR=$PWD/test
+mkdir -p /tmp/xrdfsbatch/xrdcptest
+head -c 123456 /dev/urandom > /tmp/xrdfsbatch/xrdcptest/testfile
+MTIME=$(stat -c %Y /tmp/xrdfsbatch/xrdcptest/testfile)
+
+
+##Run the test
+### one line per path: "0 id size flags mtime", or the errno
+echo -e "\e[93m stat a file, a missing file and a directory with one opaque query \e[0m"
+OUT=$(timeout 60 xrdfs test.test query opaque $'xrdopenlocal.stat\n/xrdcptest/testfile\n/xrdcptest/missing\n/xrdcptest')
+mapfile -t LINES <<< "$OUT"
+read RC1 ID1 SIZE1 FLAGS1 MTIME1 <<< "${LINES[0]}"
+read RC3 ID3 SIZE3 FLAGS3 MTIME3 <<< "${LINES[2]}"
+### 2 is ENOENT and StatInfo::IsDir
+if  [ "$RC1" == "0" ] && [ "$SIZE1" == "123456" ] && [ "$MTIME1" == "$MTIME" ] &&
+    [ "${LINES[1]}" == "2" ] && [ "$RC3" == "0" ] && (( FLAGS3 & 2 )); then
+    echo -e "\e[92m SUCCESS \e[0m"
+
+else
+
+    echo -e "\e[91m FAILED \e[0m"
+fi
+###Cleanup the test
+rm -rf /tmp/xrdfsbatch test/XrdOpenLocal.conf